@@ -0,0 +1,154 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+/**
+ * Counts heap allocations made through the global operator new.
+ *
+ * The counting operators are only compiled into a binary when exactly one translation unit
+ * defines FLOWBUILDER_COUNT_ALLOCATIONS before including this header, so regular builds keep
+ * the default allocator untouched. Counts are kept per thread, which lets a test measure the
+ * allocations of one execution while other threads keep running.
+ *
+ * Usage :
+ *     AllocationCounter counter;
+ *     context.run(sink);
+ *     assert(counter.count() == 0);
+ */
+class AllocationCounter {
+public:
+	AllocationCounter() noexcept : m_start(threadAllocations()) {}
+
+	// Allocations made by the calling thread since this counter was created
+	size_t count() const noexcept {
+		return threadAllocations() - m_start;
+	}
+
+	void reset() noexcept {
+		m_start = threadAllocations();
+	}
+
+	static size_t threadAllocations() noexcept {
+		return threadCounter();
+	}
+
+	static size_t totalAllocations() noexcept {
+		return totalCounter().load(std::memory_order_relaxed);
+	}
+
+	// False when no translation unit installed the counting operators; counts then stay at 0
+	static bool isInstalled() noexcept {
+		return installedFlag();
+	}
+
+	static void recordAllocation() noexcept {
+		++threadCounter();
+		totalCounter().fetch_add(1, std::memory_order_relaxed);
+	}
+
+	static bool markInstalled() noexcept {
+		installedFlag() = true;
+		return true;
+	}
+
+private:
+	size_t m_start;
+
+	static size_t& threadCounter() noexcept {
+		thread_local size_t counter = 0;
+		return counter;
+	}
+	static std::atomic<size_t>& totalCounter() noexcept {
+		static std::atomic<size_t> counter{ 0 };
+		return counter;
+	}
+	static bool& installedFlag() noexcept {
+		static bool installed = false;
+		return installed;
+	}
+};
+
+#ifdef FLOWBUILDER_COUNT_ALLOCATIONS
+
+static const bool allocationCounterInstalled = AllocationCounter::markInstalled();
+
+inline void* countedAllocate(std::size_t size) {
+	AllocationCounter::recordAllocation();
+	if (void* memory = std::malloc(size == 0 ? 1 : size)) {
+		return memory;
+	}
+	throw std::bad_alloc();
+}
+
+inline void* countedAlignedAllocate(std::size_t size, std::align_val_t alignment) {
+	AllocationCounter::recordAllocation();
+	auto bytes = static_cast<std::size_t>(alignment);
+	size = (size + bytes - 1) / bytes * bytes;
+#ifdef _MSC_VER
+	void* memory = _aligned_malloc(size == 0 ? bytes : size, bytes);
+#else
+	void* memory = std::aligned_alloc(bytes, size == 0 ? bytes : size);
+#endif
+	if (memory == nullptr) {
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+inline void countedAlignedFree(void* memory) noexcept {
+#ifdef _MSC_VER
+	_aligned_free(memory);
+#else
+	std::free(memory);
+#endif
+}
+
+void* operator new(std::size_t size) {
+	return countedAllocate(size);
+}
+void* operator new[](std::size_t size) {
+	return countedAllocate(size);
+}
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+	try { return countedAllocate(size); }
+	catch (...) { return nullptr; }
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+	try { return countedAllocate(size); }
+	catch (...) { return nullptr; }
+}
+void* operator new(std::size_t size, std::align_val_t alignment) {
+	return countedAlignedAllocate(size, alignment);
+}
+void* operator new[](std::size_t size, std::align_val_t alignment) {
+	return countedAlignedAllocate(size, alignment);
+}
+
+void operator delete(void* memory) noexcept {
+	std::free(memory);
+}
+void operator delete[](void* memory) noexcept {
+	std::free(memory);
+}
+void operator delete(void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+void operator delete[](void* memory, std::size_t) noexcept {
+	std::free(memory);
+}
+void operator delete(void* memory, std::align_val_t) noexcept {
+	countedAlignedFree(memory);
+}
+void operator delete[](void* memory, std::align_val_t) noexcept {
+	countedAlignedFree(memory);
+}
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept {
+	countedAlignedFree(memory);
+}
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept {
+	countedAlignedFree(memory);
+}
+
+#endif
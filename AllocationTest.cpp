@@ -0,0 +1,85 @@
+#define FLOWBUILDER_COUNT_ALLOCATIONS
+#include "AllocationCounter.h"
+#include "ExecutionPlan.h"
+#include <iostream>
+
+// Checks that a warmed ExecutionContext runs its plan without touching the heap.
+// Returns a non zero exit code when a run allocated. Inputs cycle through a few values, so the
+// texts a run builds never outgrow the buffers sized by the first runs.
+
+namespace {
+
+constexpr NodeUid FirstNumber = 100;
+// above Calculation<float>::ParallelThreshold, so the sum is folded on the ThreadPool
+constexpr size_t WideSumOperands = (size_t(1) << 16) + 1000;
+
+Flow buildFlow() {
+    Flow flow;
+    flow.addToFlow(new NumberInputNode(1, "a"));
+    flow.addToFlow(new NumberInputNode(2, "b"));
+    flow.addToFlow(new TextInputNode(3, "t"));
+    flow.addToFlow(new FloatCalculusNode(4, OperationType::Add, { 1, 2 }));
+    flow.addToFlow(new FloatCalculusNode(5, OperationType::Add, { 1, 2, 4 }, SummationMode::Compensated));
+    flow.addToFlow(new StringCalculusNode(6, OperationType::Add, { 3, 4 }));
+    flow.addToFlow(new StringCalculusNode(7, OperationType::Mul, { 3, 3 }));
+    flow.addToFlow(new WindowAggregateNode(8, WindowStatistic::Mean, 8, 0.0, { 4, 5 }));
+
+    std::vector<NodeUid> wide;
+    for (size_t index = 0; index < WideSumOperands; index++) {
+        NodeUid uid = FirstNumber + NodeUid(index);
+        flow.addToFlow(new NumberInputNode(uid, "n"));
+        wide.push_back(uid);
+    }
+    std::vector<NodeUid> compensated = wide;
+    flow.addToFlow(new FloatCalculusNode(9, OperationType::Add, std::move(wide)));
+    flow.addToFlow(new FloatCalculusNode(10, OperationType::Add, std::move(compensated), SummationMode::Compensated));
+
+    flow.addToFlow(new DisplayNode(11, { 6, 7, 8, 9, 10 }));
+    flow.addToFlow(new OutputNode(12, ".csv", "result", "Title", "Description", { 6, 9 }));
+    return flow;
+}
+
+void bindInputs(ExecutionContext& context, int run) {
+    context.bindNumber(1, float(run % 10));
+    context.bindNumber(2, 0.5f);
+    context.bindText(3, run % 2 ? "ab" : "ba");
+}
+
+}
+
+int main() {
+    if (!AllocationCounter::isInstalled()) {
+        std::cout << "The counting allocator is not installed\n";
+        return 1;
+    }
+
+    Flow flow = buildFlow();
+    ExecutionPlan plan(flow);
+    ExecutionContext context(plan);
+    for (size_t index = 0; index < WideSumOperands; index++) {
+        context.bindNumber(FirstNumber + NodeUid(index), 1.0f / float(index + 1));
+    }
+    bindInputs(context, 0);
+    context.prepare();
+
+    // the first runs size every buffer and fill the window
+    NullResultSink sink;
+    for (int run = 0; run < 16; run++) {
+        bindInputs(context, run);
+        context.run(sink);
+    }
+
+    constexpr int Runs = 100;
+    size_t totalBefore = AllocationCounter::totalAllocations();
+    AllocationCounter counter;
+    for (int run = 0; run < Runs; run++) {
+        bindInputs(context, run);
+        context.run(sink);
+    }
+    size_t threadAllocations = counter.count();
+    size_t totalAllocations = AllocationCounter::totalAllocations() - totalBefore;
+
+    std::cout << Runs << " warmed runs : " << threadAllocations << " allocations on the calling thread, "
+        << totalAllocations << " in total\n";
+    return threadAllocations == 0 && totalAllocations == 0 ? 0 : 1;
+}
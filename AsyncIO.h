@@ -0,0 +1,484 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <iterator>
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+
+#include "Parallel.h"
+
+// io_uring is driven through its system calls, so only the kernel header is needed
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#define FLOWBUILDER_IO_URING 1
+#endif
+#endif
+
+/**
+ * Batched whole file reads and writes.
+ *
+ * Requests are queued, started together by submit and finished by wait, which runs the
+ * completion of every request on the calling thread. An instance is used by one thread at a time.
+ */
+class AsyncIO {
+public:
+	// Called with whether the whole file was read or written
+	typedef std::function<void(bool succeeded)> Completion;
+
+	static constexpr size_t DefaultQueueDepth = 32;
+
+	virtual ~AsyncIO() = default;
+
+	// Queues the read of a whole file into destination, which must stay alive until the completion ran
+	virtual void readFile(const std::string& path, std::string& destination, Completion&& onComplete) = 0;
+	// Queues the write of content over the file, content staying alive until the completion ran
+	virtual void writeFile(const std::string& path, std::string_view content, Completion&& onComplete) = 0;
+	// Starts the queued requests
+	virtual void submit() = 0;
+	// Blocks until every submitted request completed, running their completions
+	virtual void wait() = 0;
+	virtual const char* getBackendName() const noexcept = 0;
+
+	// io_uring where the system has it, threads doing blocking I/O otherwise
+	static std::unique_ptr<AsyncIO> create(size_t queueDepth = DefaultQueueDepth);
+};
+
+// Fallback backend : every request is a blocking read or write on a small pool of threads
+class PooledAsyncIO : public AsyncIO {
+public:
+	explicit PooledAsyncIO(size_t threadCount) : m_pool(std::make_unique<ThreadPool>(std::max<size_t>(1, threadCount))) {}
+
+	~PooledAsyncIO() override {
+		// the requests in flight finish into their own buffers, the destinations may already be gone
+		m_pool.reset();
+	}
+
+	void readFile(const std::string& path, std::string& destination, Completion&& onComplete) override {
+		m_queued.push_back(std::make_shared<Request>(Request{ path, &destination, std::string_view(), std::move(onComplete), std::string(), false }));
+	}
+	void writeFile(const std::string& path, std::string_view content, Completion&& onComplete) override {
+		m_queued.push_back(std::make_shared<Request>(Request{ path, nullptr, content, std::move(onComplete), std::string(), false }));
+	}
+
+	void submit() override {
+		for (auto& request : m_queued) {
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_outstanding++;
+			}
+			m_pool->submit([this, request]() {
+				request->succeeded = perform(*request);
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_finished.push_back(request);
+				m_condition.notify_one();
+			});
+		}
+		m_queued.clear();
+	}
+
+	void wait() override {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (m_outstanding != 0) {
+			m_condition.wait(lock, [this]() { return !m_finished.empty(); });
+			auto finished = std::move(m_finished);
+			m_finished.clear();
+			m_outstanding -= finished.size();
+			lock.unlock();
+			for (auto& request : finished) {
+				if (request->destination != nullptr) {
+					*request->destination = std::move(request->data);
+				}
+				if (request->onComplete) request->onComplete(request->succeeded);
+			}
+			lock.lock();
+		}
+	}
+
+	const char* getBackendName() const noexcept override {
+		return "thread pool";
+	}
+
+private:
+	struct Request {
+		std::string path;
+		// null for writes
+		std::string* destination;
+		std::string_view content;
+		Completion onComplete;
+		// what a read got, moved to the destination by wait
+		std::string data;
+		bool succeeded = false;
+	};
+
+	std::vector<std::shared_ptr<Request>> m_queued;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::vector<std::shared_ptr<Request>> m_finished;
+	size_t m_outstanding = 0;
+	std::unique_ptr<ThreadPool> m_pool;
+
+	static bool perform(Request& request) {
+		if (request.destination != nullptr) {
+			std::ifstream file(request.path, std::ios::binary);
+			if (!file.is_open()) return false;
+			request.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+			return !file.bad();
+		}
+		std::ofstream file(request.path, std::ios::binary | std::ios::trunc);
+		if (!file.is_open()) return false;
+		file.write(request.content.data(), static_cast<std::streamsize>(request.content.size()));
+		file.close();
+		return !file.fail();
+	}
+};
+
+#ifdef FLOWBUILDER_IO_URING
+/**
+ * io_uring backend. Files are cut into chunks of ChunkSize, each operation using one of the
+ * buffers registered with the ring, so the kernel does not map the pages of every request anew;
+ * operations of all the submitted files are in flight together, and every submit or wait is a
+ * single io_uring_enter for the whole batch.
+ */
+class UringAsyncIO : public AsyncIO {
+public:
+	static constexpr size_t ChunkSize = size_t(256) << 10;
+
+	// Null when the kernel refuses io_uring, for example under a seccomp profile
+	static std::unique_ptr<UringAsyncIO> tryCreate(size_t queueDepth) {
+		std::unique_ptr<UringAsyncIO> io(new UringAsyncIO());
+		if (!io->setup(unsigned(std::max<size_t>(2, queueDepth)))) {
+			return nullptr;
+		}
+		return io;
+	}
+
+	~UringAsyncIO() override {
+		// the kernel uses the buffers until the operations in flight complete, whose results are
+		// dropped since the destinations may already be gone
+		while (m_operationsInFlight != 0 && enter(0, 1) >= 0) {
+			const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+			m_operationsInFlight -= std::min<size_t>(m_operationsInFlight, tail - *m_cqHead);
+			__atomic_store_n(m_cqHead, tail, __ATOMIC_RELEASE);
+		}
+		for (auto& request : m_active) {
+			if (request->fd >= 0) close(request->fd);
+		}
+		if (m_sqes != nullptr) munmap(m_sqes, m_sqesSize);
+		if (m_cqRing != nullptr && m_cqRing != m_sqRing) munmap(m_cqRing, m_cqRingSize);
+		if (m_sqRing != nullptr) munmap(m_sqRing, m_sqRingSize);
+		if (m_ring >= 0) close(m_ring);
+		std::free(m_buffers);
+	}
+
+	void readFile(const std::string& path, std::string& destination, Completion&& onComplete) override {
+		auto request = std::make_unique<Request>();
+		request->path = path;
+		request->destination = &destination;
+		request->onComplete = std::move(onComplete);
+		m_queued.push_back(std::move(request));
+	}
+	void writeFile(const std::string& path, std::string_view content, Completion&& onComplete) override {
+		auto request = std::make_unique<Request>();
+		request->path = path;
+		request->content = content;
+		request->onComplete = std::move(onComplete);
+		m_queued.push_back(std::move(request));
+	}
+
+	void submit() override {
+		for (auto& request : m_queued) {
+			open(*request);
+			m_active.push_back(std::move(request));
+		}
+		m_queued.clear();
+		fill();
+		flushSubmissions();
+	}
+
+	void wait() override {
+		while (true) {
+			completeFinished();
+			if (m_active.empty()) return;
+			fill();
+			m_unsubmitted -= std::min<unsigned>(m_unsubmitted, unsigned(std::max(0, enter(m_unsubmitted, m_operationsInFlight != 0 ? 1 : 0))));
+			reap();
+		}
+	}
+
+	const char* getBackendName() const noexcept override {
+		return "io_uring";
+	}
+
+private:
+	struct Request {
+		std::string path;
+		// null for writes
+		std::string* destination = nullptr;
+		std::string_view content;
+		Completion onComplete;
+		int fd = -1;
+		uint64_t size = 0;
+		// bytes handed to operations so far
+		uint64_t issued = 0;
+		size_t inFlight = 0;
+		bool failed = false;
+	};
+
+	// Operation using one registered buffer
+	struct Slot {
+		Request* request;
+		uint64_t offset;
+		uint32_t length;
+		// bytes of the chunk already transferred, after a short read or write
+		uint32_t done;
+	};
+
+	int m_ring = -1;
+	void* m_sqRing = nullptr;
+	void* m_cqRing = nullptr;
+	size_t m_sqRingSize = 0;
+	size_t m_cqRingSize = 0;
+	io_uring_sqe* m_sqes = nullptr;
+	size_t m_sqesSize = 0;
+	unsigned m_sqEntries = 0;
+	unsigned* m_sqHead = nullptr;
+	unsigned* m_sqTail = nullptr;
+	unsigned m_sqMask = 0;
+	unsigned* m_sqArray = nullptr;
+	unsigned* m_cqHead = nullptr;
+	unsigned* m_cqTail = nullptr;
+	unsigned m_cqMask = 0;
+	io_uring_cqe* m_cqes = nullptr;
+	unsigned m_unsubmitted = 0;
+
+	char* m_buffers = nullptr;
+	bool m_registered = false;
+	std::vector<Slot> m_slots;
+	std::vector<uint32_t> m_freeSlots;
+	// slots whose chunk was cut short and must be issued again
+	std::vector<uint32_t> m_retries;
+	size_t m_operationsInFlight = 0;
+
+	std::vector<std::unique_ptr<Request>> m_queued;
+	std::vector<std::unique_ptr<Request>> m_active;
+
+	UringAsyncIO() = default;
+
+	bool setup(unsigned entries) {
+		io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+		m_ring = int(syscall(__NR_io_uring_setup, entries, &params));
+		if (m_ring < 0) return false;
+
+		m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (single) {
+			m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+		}
+		m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQ_RING);
+		if (m_sqRing == MAP_FAILED) {
+			m_sqRing = nullptr;
+			return false;
+		}
+		m_cqRing = single ? m_sqRing : mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_CQ_RING);
+		if (m_cqRing == MAP_FAILED) {
+			m_cqRing = nullptr;
+			return false;
+		}
+		m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+		void* sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ring, IORING_OFF_SQES);
+		if (sqes == MAP_FAILED) return false;
+		m_sqes = static_cast<io_uring_sqe*>(sqes);
+
+		char* sq = static_cast<char*>(m_sqRing);
+		char* cq = static_cast<char*>(m_cqRing);
+		m_sqEntries = params.sq_entries;
+		m_sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		m_sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		m_cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		m_cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+		// one buffer per submission entry, registered when the memory lock limit allows it
+		m_buffers = static_cast<char*>(std::aligned_alloc(4096, m_sqEntries * ChunkSize));
+		if (m_buffers == nullptr) return false;
+		std::vector<iovec> vectors(m_sqEntries);
+		m_slots.resize(m_sqEntries);
+		for (unsigned slot = 0; slot < m_sqEntries; slot++) {
+			vectors[slot].iov_base = m_buffers + slot * ChunkSize;
+			vectors[slot].iov_len = ChunkSize;
+			m_freeSlots.push_back(m_sqEntries - 1 - slot);
+		}
+		m_registered = syscall(__NR_io_uring_register, m_ring, IORING_REGISTER_BUFFERS, vectors.data(), m_sqEntries) == 0;
+		return true;
+	}
+
+	int enter(unsigned toSubmit, unsigned minComplete) {
+		while (true) {
+			int result = int(syscall(__NR_io_uring_enter, m_ring, toSubmit, minComplete, minComplete != 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0));
+			if (result >= 0 || errno != EINTR) return result;
+		}
+	}
+
+	void flushSubmissions() {
+		if (m_unsubmitted == 0) return;
+		int submitted = enter(m_unsubmitted, 0);
+		if (submitted > 0) m_unsubmitted -= std::min<unsigned>(m_unsubmitted, unsigned(submitted));
+	}
+
+	void open(Request& request) {
+		if (request.destination != nullptr) {
+			request.fd = ::open(request.path.c_str(), O_RDONLY | O_CLOEXEC);
+			struct stat status;
+			if (request.fd < 0 || fstat(request.fd, &status) != 0) {
+				request.failed = true;
+				return;
+			}
+			request.size = uint64_t(status.st_size);
+			request.destination->resize(size_t(request.size));
+		}
+		else {
+			request.fd = ::open(request.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+			request.failed = request.fd < 0;
+			request.size = request.content.size();
+		}
+	}
+
+	// Prepares operations for the retried chunks, then for the next chunks of the active requests
+	void fill() {
+		while (!m_retries.empty() && hasSubmissionSpace()) {
+			prepare(m_retries.back());
+			m_retries.pop_back();
+		}
+		for (auto& request : m_active) {
+			while (!request->failed && request->issued < request->size && !m_freeSlots.empty() && hasSubmissionSpace()) {
+				uint32_t slot = m_freeSlots.back();
+				m_freeSlots.pop_back();
+				const uint32_t length = uint32_t(std::min<uint64_t>(ChunkSize, request->size - request->issued));
+				m_slots[slot] = Slot{ request.get(), request->issued, length, 0 };
+				if (request->destination == nullptr) {
+					std::memcpy(m_buffers + slot * ChunkSize, request->content.data() + request->issued, length);
+				}
+				request->issued += length;
+				request->inFlight++;
+				prepare(slot);
+			}
+		}
+	}
+
+	bool hasSubmissionSpace() const noexcept {
+		const unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+		return *m_sqTail - head < m_sqEntries;
+	}
+
+	void prepare(uint32_t slotIndex) {
+		const Slot& slot = m_slots[slotIndex];
+		const bool write = slot.request->destination == nullptr;
+		const unsigned tail = *m_sqTail;
+		io_uring_sqe& sqe = m_sqes[tail & m_sqMask];
+		std::memset(&sqe, 0, sizeof(sqe));
+		if (m_registered) {
+			sqe.opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+			sqe.buf_index = uint16_t(slotIndex);
+		}
+		else {
+			sqe.opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+		}
+		sqe.fd = slot.request->fd;
+		sqe.addr = uint64_t(uintptr_t(m_buffers + slotIndex * ChunkSize + slot.done));
+		sqe.len = slot.length - slot.done;
+		sqe.off = slot.offset + slot.done;
+		sqe.user_data = slotIndex;
+		m_sqArray[tail & m_sqMask] = tail & m_sqMask;
+		__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+		m_unsubmitted++;
+		m_operationsInFlight++;
+	}
+
+	void reap() {
+		unsigned head = *m_cqHead;
+		const unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+		for (; head != tail; head++) {
+			const io_uring_cqe& cqe = m_cqes[head & m_cqMask];
+			complete(uint32_t(cqe.user_data), cqe.res);
+		}
+		__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+	}
+
+	void complete(uint32_t slotIndex, int result) {
+		m_operationsInFlight--;
+		Slot& slot = m_slots[slotIndex];
+		Request& request = *slot.request;
+		if (result == -EAGAIN || result == -EINTR) {
+			m_retries.push_back(slotIndex);
+			return;
+		}
+		if (result <= 0) {
+			// an error, or a file that shrank while it was read
+			request.failed = true;
+		}
+		else {
+			if (request.destination != nullptr) {
+				std::memcpy(&(*request.destination)[size_t(slot.offset + slot.done)], m_buffers + slotIndex * ChunkSize + slot.done, size_t(result));
+			}
+			slot.done += uint32_t(result);
+			if (slot.done < slot.length) {
+				m_retries.push_back(slotIndex);
+				return;
+			}
+		}
+		request.inFlight--;
+		m_freeSlots.push_back(slotIndex);
+	}
+
+	// Runs the completions of the requests with nothing left to do
+	void completeFinished() {
+		std::vector<std::unique_ptr<Request>> finished;
+		for (size_t index = 0; index < m_active.size();) {
+			auto& request = *m_active[index];
+			if (request.inFlight == 0 && (request.failed || request.issued == request.size)) {
+				if (request.fd >= 0) close(request.fd);
+				request.fd = -1;
+				finished.push_back(std::move(m_active[index]));
+				m_active[index] = std::move(m_active.back());
+				m_active.pop_back();
+			}
+			else {
+				index++;
+			}
+		}
+		for (auto& request : finished) {
+			if (request->onComplete) request->onComplete(!request->failed);
+		}
+	}
+};
+#endif
+
+inline std::unique_ptr<AsyncIO> AsyncIO::create(size_t queueDepth) {
+#ifdef FLOWBUILDER_IO_URING
+	if (auto io = UringAsyncIO::tryCreate(queueDepth)) {
+		return io;
+	}
+#endif
+	return std::make_unique<PooledAsyncIO>(std::min<size_t>(queueDepth, 8));
+}
@@ -0,0 +1,195 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <utility>
+#include <algorithm>
+
+#include "ExecutionPlan.h"
+#include "Parallel.h"
+
+// Values bound to the input nodes of a flow for one run of a batch
+struct BatchRecord {
+	std::vector<std::pair<NodeUid, std::string>> texts;
+	std::vector<std::pair<NodeUid, double>> numbers;
+};
+
+/**
+ * Runs the same ExecutionPlan over many independent records on the shared ThreadPool.
+ *
+ * The records are split into chunks that workers claim one at a time; each worker owns an
+ * ExecutionContext, so values never cross threads and the plan is only read. The contexts are
+ * prepared, their input files read, on the calling thread before any worker starts. The results of a
+ * chunk are buffered and handed to the sink once every earlier chunk was, so the sink sees them in
+ * record order, one call at a time, exactly as a serial loop over the records would produce them.
+ *
+ * Nodes that keep state from one run to the next, like time windows, only see the records of
+ * their own worker.
+ */
+class BatchRunner {
+public:
+	/**
+	 * @param workerCount Contexts running at once, the pool size plus the caller when 0.
+	 * @param chunkSize Records per chunk, picked from the batch size when 0.
+	 */
+	explicit BatchRunner(const ExecutionPlan& plan, size_t workerCount = 0, size_t chunkSize = 0)
+		: m_plan(plan), m_chunkSize(chunkSize) {
+		if (workerCount == 0) {
+			workerCount = ThreadPool::getInstance().getThreadCount() + 1;
+		}
+		m_contexts.resize(workerCount);
+	}
+
+	size_t getWorkerCount() const noexcept {
+		return m_contexts.size();
+	}
+
+	void run(const std::vector<BatchRecord>& records, ResultSink& sink) {
+		run(records.size(), [&records](ExecutionContext& context, size_t index) {
+			const auto& record = records[index];
+			for (const auto& text : record.texts) {
+				context.bindText(text.first, text.second);
+			}
+			for (const auto& number : record.numbers) {
+				context.bindDouble(number.first, number.second);
+			}
+		}, sink);
+	}
+
+	/**
+	 * Runs the plan recordCount times, bind(context, index) binding the inputs of record index
+	 * before its run. bind is called concurrently from several workers; the TextInput and
+	 * NumberInput nodes it leaves unbound read as empty and 0, whatever record the worker ran before.
+	 *
+	 * The first exception thrown by a record stops the batch and is rethrown here; the sink has
+	 * then received the results of some prefix of the records.
+	 */
+	template <typename Binder>
+	void run(size_t recordCount, Binder&& bind, ResultSink& sink) {
+		if (recordCount == 0) return;
+		const size_t chunkSize = m_chunkSize != 0 ? m_chunkSize : pickChunkSize(recordCount);
+		Batch batch(recordCount, chunkSize, sink);
+		for (auto& context : m_contexts) {
+			if (context == nullptr) {
+				context = std::make_unique<ExecutionContext>(m_plan);
+				context->prepare();
+			}
+		}
+		ThreadPool::getInstance().parallelFor(m_contexts.size(), [&](size_t worker) {
+			auto& context = m_contexts[worker];
+			ChunkBuffer buffer;
+			for (;;) {
+				const size_t chunk = batch.nextChunk.fetch_add(1, std::memory_order_relaxed);
+				if (chunk >= batch.chunks.size() || batch.failed.load(std::memory_order_relaxed)) return;
+				const size_t end = std::min(recordCount, (chunk + 1) * chunkSize);
+				try {
+					for (size_t index = chunk * chunkSize; index < end; index++) {
+						context->resetInputs();
+						bind(*context, index);
+						context->run(buffer);
+					}
+				}
+				catch (...) {
+					batch.failed.store(true, std::memory_order_relaxed);
+					throw;
+				}
+				batch.complete(chunk, buffer);
+			}
+		});
+	}
+
+private:
+	// Results of one chunk, their contents packed in a single string
+	class ChunkBuffer : public ResultSink {
+	public:
+		void onDisplay(const DisplayNode& node, std::string_view content) override {
+			add(&node, nullptr, content);
+		}
+		void onOutput(const OutputNode& node, std::string_view content) override {
+			add(nullptr, &node, content);
+		}
+
+		void replay(ResultSink& sink) const {
+			for (const auto& result : m_results) {
+				std::string_view content(m_contents.data() + result.offset, result.size);
+				if (result.display != nullptr) {
+					sink.onDisplay(*result.display, content);
+				}
+				else {
+					sink.onOutput(*result.output, content);
+				}
+			}
+		}
+		bool empty() const noexcept {
+			return m_results.empty();
+		}
+		// Keeps the capacity for the next chunk of the same worker
+		void clear() noexcept {
+			m_results.clear();
+			m_contents.clear();
+		}
+		void swap(ChunkBuffer& other) noexcept {
+			m_results.swap(other.m_results);
+			m_contents.swap(other.m_contents);
+		}
+
+	private:
+		struct Result {
+			const DisplayNode* display;
+			const OutputNode* output;
+			size_t offset;
+			size_t size;
+		};
+		std::vector<Result> m_results;
+		std::string m_contents;
+
+		void add(const DisplayNode* display, const OutputNode* output, std::string_view content) {
+			m_results.push_back({ display, output, m_contents.size(), content.size() });
+			m_contents.append(content.data(), content.size());
+		}
+	};
+
+	struct Batch {
+		std::vector<ChunkBuffer> chunks;
+		std::vector<bool> done;
+		std::atomic<size_t> nextChunk{ 0 };
+		std::atomic<bool> failed{ false };
+		std::mutex mutex;
+		size_t nextToEmit = 0;
+		ResultSink& sink;
+
+		Batch(size_t recordCount, size_t chunkSize, ResultSink& sink)
+			: chunks((recordCount + chunkSize - 1) / chunkSize), done(chunks.size(), false), sink(sink) {}
+
+		// Emits the chunk, and the ones it was holding back, once every earlier chunk was emitted
+		void complete(size_t chunk, ChunkBuffer& buffer) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (chunk == nextToEmit) {
+				buffer.replay(sink);
+				nextToEmit++;
+				while (nextToEmit < chunks.size() && done[nextToEmit]) {
+					chunks[nextToEmit].replay(sink);
+					ChunkBuffer().swap(chunks[nextToEmit]);
+					nextToEmit++;
+				}
+			}
+			else {
+				chunks[chunk].swap(buffer);
+				done[chunk] = true;
+			}
+			buffer.clear();
+		}
+	};
+
+	const ExecutionPlan& m_plan;
+	size_t m_chunkSize;
+	std::vector<std::unique_ptr<ExecutionContext>> m_contexts;
+
+	// Enough chunks per worker to balance uneven records, few enough to keep the claims cheap
+	size_t pickChunkSize(size_t recordCount) const noexcept {
+		return std::max<size_t>(1, recordCount / (m_contexts.size() * 16));
+	}
+};
@@ -0,0 +1,208 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <sstream>
+#include <unordered_map>
+
+#include "Flow.h"
+
+/**
+ * Non interactive way of building a Flow, meant for tooling that generates large flows.
+ *
+ * Nodes are appended in execution order and may only depend on nodes added before them, which
+ * keeps every flow acyclic. Nothing is checked while adding; build() validates all the nodes in a
+ * single pass and hands them to the Flow, so building n nodes with m dependencies is O(n + m).
+ *
+ * Usage :
+ *     BulkFlowBuilder builder("Totals");
+ *     auto a = builder.addNumberInput("First number : ");
+ *     auto b = builder.addNumberInput("Second number : ");
+ *     auto sum = builder.addFloatCalculus(OperationType::Add, { a, b });
+ *     builder.addDisplay({ sum });
+ *     controller.addNewFlow(builder.build());
+ */
+class BulkFlowBuilder {
+public:
+    BulkFlowBuilder() : m_name("Default Flow") {}
+    explicit BulkFlowBuilder(std::string&& name) : m_name(std::move(name)) {}
+    BulkFlowBuilder(const BulkFlowBuilder&) = delete;
+    BulkFlowBuilder& operator=(const BulkFlowBuilder&) = delete;
+
+    // Nodes that were never handed to a Flow are owned by the builder
+    ~BulkFlowBuilder() {
+        for (auto node : m_nodes) {
+            delete node;
+        }
+    }
+
+    BulkFlowBuilder& reserve(size_t nodeCount) {
+        m_nodes.reserve(nodeCount);
+        return *this;
+    }
+
+    // Takes ownership of a node created by the caller, its uid must not be used by another node
+    NodeUid add(Node* node) {
+        if (node == nullptr) {
+            throw InvalidInput("Cannot add a null node to a flow");
+        }
+        m_nodes.push_back(node);
+        m_nextUid = std::max(m_nextUid, node->getUid() + 1);
+        return node->getUid();
+    }
+    void addAll(std::vector<Node*>&& nodes) {
+        m_nodes.reserve(m_nodes.size() + nodes.size());
+        for (auto node : nodes) {
+            add(node);
+        }
+        nodes.clear();
+    }
+
+    NodeUid addTitle(std::string&& title, std::string&& description) {
+        return add(new TitleNode(m_nextUid, { std::move(title), std::move(description) }));
+    }
+    NodeUid addText(std::string&& title, std::string&& body) {
+        return add(new TextNode(m_nextUid, { std::move(title), std::move(body) }));
+    }
+    NodeUid addTextInput(std::string&& prompt) {
+        return add(new TextInputNode(m_nextUid, std::move(prompt)));
+    }
+    NodeUid addNumberInput(std::string&& prompt) {
+        return add(new NumberInputNode(m_nextUid, std::move(prompt)));
+    }
+    NodeUid addFileInput(std::string&& fileName, std::string&& extension) {
+        return add(new FileInputNode(std::move(fileName), std::move(extension), m_nextUid));
+    }
+    NodeUid addFloatCalculus(OperationType operation, std::vector<NodeUid>&& dependencies, SummationMode summation = SummationMode::Plain) {
+        return add(new FloatCalculusNode(m_nextUid, operation, std::move(dependencies), summation));
+    }
+    NodeUid addStringCalculus(OperationType operation, std::vector<NodeUid>&& dependencies) {
+        return add(new StringCalculusNode(m_nextUid, operation, std::move(dependencies)));
+    }
+    NodeUid addDisplay(std::vector<NodeUid>&& dependencies) {
+        return add(new DisplayNode(m_nextUid, std::move(dependencies)));
+    }
+    NodeUid addOutput(std::string&& extension, std::string&& fileName, std::string&& title, std::string&& description, std::vector<NodeUid>&& dependencies) {
+        return add(new OutputNode(m_nextUid, std::move(extension), std::move(fileName), std::move(title), std::move(description), std::move(dependencies)));
+    }
+    NodeUid addWindowAggregate(WindowStatistic statistic, size_t windowSize, double windowSeconds, std::vector<NodeUid>&& dependencies) {
+        return add(new WindowAggregateNode(m_nextUid, statistic, windowSize, windowSeconds, std::move(dependencies)));
+    }
+    NodeUid addGroupBy(std::string&& keyColumn, std::vector<std::string>&& valueColumns, NodeUid source) {
+        return add(new GroupByNode(m_nextUid, std::move(keyColumn), std::move(valueColumns), { source }));
+    }
+    NodeUid addHashJoin(JoinKind kind, std::string&& leftKey, std::string&& rightKey, NodeUid left, NodeUid right) {
+        return add(new HashJoinNode(m_nextUid, kind, std::move(leftKey), std::move(rightKey), { left, right }));
+    }
+    NodeUid addFilter(std::string&& column, FilterComparison comparison, std::string&& operand, NodeUid source) {
+        return add(new FilterNode(m_nextUid, std::move(column), comparison, std::move(operand), { source }));
+    }
+    NodeUid addSort(std::vector<SortKey>&& keys, NodeUid source, size_t memoryBudget = ExternalSorter::DefaultMemoryBudget) {
+        return add(new SortNode(m_nextUid, std::move(keys), memoryBudget, { source }));
+    }
+    NodeUid addSearch(std::vector<std::string>&& patterns, SearchOutput output, NodeUid source) {
+        return add(new SearchNode(m_nextUid, std::move(patterns), output, { source }));
+    }
+    NodeUid addTokenize(std::string&& delimiters, TokenOutput output, NodeUid source) {
+        return add(new TokenizeNode(m_nextUid, std::move(delimiters), output, { source }));
+    }
+    NodeUid addSketch(SketchKind kind, std::string&& column, size_t k, NodeUid source) {
+        return add(new SketchNode(m_nextUid, kind, std::move(column), k, { source }));
+    }
+    NodeUid addVector(std::string&& column, NodeUid source) {
+        return add(new VectorNode(m_nextUid, std::move(column), { source }));
+    }
+    NodeUid addVectorCalculus(OperationType operation, std::vector<NodeUid>&& dependencies) {
+        return add(new VectorCalculusNode(m_nextUid, operation, std::move(dependencies)));
+    }
+    NodeUid addVectorReduce(VectorReduction reduction, std::vector<NodeUid>&& dependencies) {
+        return add(new VectorReduceNode(m_nextUid, reduction, std::move(dependencies)));
+    }
+    NodeUid addEnd() {
+        return add(new EndNode(m_nextUid));
+    }
+
+    /**
+     * Validates every node and moves them into a new Flow.
+     *
+     * @throws InvalidInput on a duplicated uid, a dependency that is unknown or declared later,
+     * or a dependency whose type the consumer cannot read. The builder keeps its nodes in that case.
+     */
+    Flow build() {
+        std::unordered_map<NodeUid, NodeType> seen;
+        seen.reserve(m_nodes.size());
+
+        for (const auto node : m_nodes) {
+            for (auto dependency : node->getDependencies()) {
+                auto iterator = seen.find(dependency);
+                if (iterator == seen.end()) {
+                    std::stringstream ss;
+                    ss << "Node with uid = " << node->getUid() << " depends on uid = " << dependency << " which is not declared before it";
+                    throw InvalidInput(ss.str().c_str());
+                }
+                if (!acceptsDependency(node->getType(), iterator->second)) {
+                    std::stringstream ss;
+                    ss << nodeTypeToString(node->getType()) << " node with uid = " << node->getUid()
+                        << " cannot depend on " << nodeTypeToString(iterator->second) << " node with uid = " << dependency;
+                    throw InvalidInput(ss.str().c_str());
+                }
+            }
+            if (requiresDependencies(node->getType()) && node->getDependencies().empty()) {
+                std::stringstream ss;
+                ss << nodeTypeToString(node->getType()) << " node with uid = " << node->getUid() << " has no dependencies";
+                throw InvalidInput(ss.str().c_str());
+            }
+            if (!seen.emplace(node->getUid(), node->getType()).second) {
+                std::stringstream ss;
+                ss << "Uid = " << node->getUid() << " is used by more than one node";
+                throw InvalidInput(ss.str().c_str());
+            }
+        }
+
+        Flow flow;
+        flow.setName(std::move(m_name));
+        flow.reserve(m_nodes.size());
+        for (auto node : m_nodes) {
+            flow.addToFlow(node);
+        }
+        m_nodes.clear();
+        return flow;
+    }
+
+private:
+    std::vector<Node*> m_nodes;
+    std::string m_name;
+    NodeUid m_nextUid = 1;
+
+    static bool requiresDependencies(NodeType type) noexcept {
+        return type == NodeType::FloatCalculus || type == NodeType::StringCalculus || type == NodeType::Output || type == NodeType::WindowAggregate || type == NodeType::GroupBy || type == NodeType::HashJoin || type == NodeType::Filter || type == NodeType::Sort || type == NodeType::Search || type == NodeType::Tokenize || type == NodeType::Sketch || type == NodeType::Vector || type == NodeType::VectorCalculus || type == NodeType::VectorReduce;
+    }
+
+    // Same rules the interactive builder offers when picking dependencies
+    static bool acceptsDependency(NodeType consumer, NodeType dependency) noexcept {
+        switch (consumer) {
+        case NodeType::FloatCalculus:
+            return isNumericNodeType(dependency);
+        case NodeType::WindowAggregate:
+            return isNumericNodeType(dependency) || dependency == NodeType::TextInput || dependency == NodeType::FileInput || dependency == NodeType::StringCalculus;
+        case NodeType::GroupBy:
+        case NodeType::HashJoin:
+        case NodeType::Filter:
+        case NodeType::Sort:
+        case NodeType::Search:
+        case NodeType::Tokenize:
+        case NodeType::Sketch:
+        case NodeType::Vector:
+            return isTextNodeType(dependency);
+        case NodeType::VectorCalculus:
+            return isVectorNodeType(dependency) || isNumericNodeType(dependency);
+        case NodeType::VectorReduce:
+            return isVectorNodeType(dependency);
+        case NodeType::StringCalculus:
+        case NodeType::Display:
+        case NodeType::Output:
+            return dependency != NodeType::Display && dependency != NodeType::Output && dependency != NodeType::End;
+        default:
+            return false;
+        }
+    }
+};
@@ -0,0 +1,200 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <sstream>
+#include <algorithm>
+#include <cstdint>
+
+#include "InputHandler.h"
+
+inline uint64_t hashKey(std::string_view key) noexcept {
+	// FNV-1a, 64 bit
+	uint64_t hash = 14695981039346656037ull;
+	for (unsigned char ch : key) {
+		hash ^= ch;
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+/**
+ * Zero copy helpers over CSV text.
+ *
+ * Lines and fields are returned as string_views into the source buffer, which must outlive them.
+ * Fields may be wrapped in double quotes to contain commas; the quotes are stripped but doubled
+ * quotes inside a field are left as they are.
+ */
+struct Csv {
+
+	static std::string_view trimLineEnd(std::string_view line) noexcept {
+		if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+		return line;
+	}
+
+	// First line of text, without its line break
+	static std::string_view firstLine(std::string_view text) noexcept {
+		return trimLineEnd(text.substr(0, text.find('\n')));
+	}
+
+	// What follows the first line of text, empty when there is a single line
+	static std::string_view withoutFirstLine(std::string_view text) noexcept {
+		size_t lineEnd = text.find('\n');
+		return lineEnd == std::string_view::npos ? std::string_view() : text.substr(lineEnd + 1);
+	}
+
+	// Drops the last line break of a text ending with a blank line, or being one, like an output after its rows
+	static std::string_view withoutBlankEnd(std::string_view text) noexcept {
+		if (text == "\n" || (text.size() >= 2 && text[text.size() - 1] == '\n' && text[text.size() - 2] == '\n')) {
+			text.remove_suffix(1);
+		}
+		return text;
+	}
+
+	// Calls onLine for every non empty line of text
+	template <typename Callback>
+	static void forEachLine(std::string_view text, Callback&& onLine) {
+		size_t position = 0;
+		while (position < text.size()) {
+			size_t end = text.find('\n', position);
+			if (end == std::string_view::npos) end = text.size();
+			auto line = trimLineEnd(text.substr(position, end - position));
+			position = end + 1;
+			if (!line.empty()) onLine(line);
+		}
+	}
+
+	// Splits one line into fields, reusing the capacity of the fields vector
+	static void splitFields(std::string_view line, std::vector<std::string_view>& fields, char delimiter = ',') {
+		fields.clear();
+		size_t position = 0;
+		while (true) {
+			if (position < line.size() && line[position] == '"') {
+				size_t close = position + 1;
+				while (close < line.size()) {
+					if (line[close] == '"' && (close + 1 >= line.size() || line[close + 1] != '"')) break;
+					close += line[close] == '"' ? 2 : 1;
+				}
+				fields.push_back(line.substr(position + 1, std::min(close, line.size()) - position - 1));
+				size_t next = line.find(delimiter, close);
+				if (next == std::string_view::npos) return;
+				position = next + 1;
+				continue;
+			}
+			size_t next = line.find(delimiter, position);
+			if (next == std::string_view::npos) {
+				fields.push_back(line.substr(position));
+				return;
+			}
+			fields.push_back(line.substr(position, next - position));
+			position = next + 1;
+		}
+	}
+
+	// Returns the field at column or an empty view when the row is too short
+	static std::string_view fieldAt(const std::vector<std::string_view>& fields, size_t column) noexcept {
+		return column < fields.size() ? fields[column] : std::string_view();
+	}
+
+	// Widens a field returned by splitFields back to its text in the line, quotes included
+	static std::string_view rawField(std::string_view line, std::string_view field) noexcept {
+		if (field.data() > line.data() && field.data()[-1] == '"') {
+			size_t start = field.data() - 1 - line.data();
+			size_t end = std::min(line.size(), start + field.size() + 2);
+			return line.substr(start, end - start);
+		}
+		return field;
+	}
+
+	static bool parseNumber(std::string_view field, double& value) noexcept {
+		while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+		while (!field.empty() && (field.back() == ' ' || field.back() == '\t')) field.remove_suffix(1);
+		if (!field.empty() && field.front() == '+') field.remove_prefix(1);
+		if (field.empty()) return false;
+		auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+		return result.ec == std::errc() && result.ptr == field.data() + field.size();
+	}
+
+	// Shortest text that reads back as the same double
+	static void appendNumber(std::string& out, double value) {
+		char buffer[32];
+		auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+		out.append(buffer, result.ptr - buffer);
+	}
+
+	// Writes a field, quoting it when it contains the delimiter, a quote or a line break
+	static void appendField(std::string& out, std::string_view field, char delimiter = ',') {
+		bool plain = true;
+		for (char ch : field) {
+			if (ch == delimiter || ch == '"' || ch == '\n' || ch == '\r') {
+				plain = false;
+				break;
+			}
+		}
+		if (plain) {
+			out.append(field.data(), field.size());
+			return;
+		}
+		out += '"';
+		for (char ch : field) {
+			if (ch == '"') out += '"';
+			out += ch;
+		}
+		out += '"';
+	}
+
+	/**
+	 * Resolves a column by header name, or by its 0 based position when the name is a number
+	 * that no header uses.
+	 * @throws InvalidInput if the column does not exist.
+	 */
+	static size_t findColumn(const std::vector<std::string_view>& header, std::string_view column) {
+		for (size_t index = 0; index < header.size(); index++) {
+			if (header[index] == column) return index;
+		}
+		size_t position = 0;
+		auto result = std::from_chars(column.data(), column.data() + column.size(), position);
+		if (!column.empty() && result.ec == std::errc() && result.ptr == column.data() + column.size() && position < header.size()) {
+			return position;
+		}
+		std::stringstream ss;
+		ss << "Column " << column << " was not found in the CSV header";
+		throw InvalidInput(ss.str().c_str());
+	}
+
+	// Splits the text into its header line and the rows after it
+	static std::string_view splitHeader(std::string_view text, std::string_view& body) noexcept {
+		size_t end = text.find('\n');
+		if (end == std::string_view::npos) {
+			body = std::string_view();
+			return trimLineEnd(text);
+		}
+		body = text.substr(end + 1);
+		return trimLineEnd(text.substr(0, end));
+	}
+
+	// Cuts text into at most count ranges that end on line boundaries, for parallel scans
+	static std::vector<std::string_view> splitIntoChunks(std::string_view text, size_t count) {
+		std::vector<std::string_view> chunks;
+		if (count <= 1 || text.size() < count) {
+			chunks.push_back(text);
+			return chunks;
+		}
+		size_t target = text.size() / count;
+		size_t start = 0;
+		while (start < text.size()) {
+			size_t end = start + target;
+			if (end >= text.size() || chunks.size() + 1 == count) {
+				end = text.size();
+			}
+			else {
+				end = text.find('\n', end);
+				end = end == std::string_view::npos ? text.size() : end + 1;
+			}
+			chunks.push_back(text.substr(start, end - start));
+			start = end;
+		}
+		return chunks;
+	}
+};
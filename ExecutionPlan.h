@@ -0,0 +1,1071 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <cstdio>
+#include <chrono>
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <deque>
+#include <algorithm>
+
+#include "Flow.h"
+#include "Value.h"
+
+// Receives the content of an Output node piece by piece, see ResultSink::openOutput
+struct OutputStream {
+    virtual ~OutputStream() = default;
+    virtual void append(std::string_view content) = 0;
+    // Called once every piece was appended
+    virtual void close() = 0;
+};
+
+// Receives the results of a prepared run
+struct ResultSink {
+    virtual void onDisplay(const DisplayNode& node, std::string_view content) = 0;
+    virtual void onOutput(const OutputNode& node, std::string_view content) = 0;
+    // For content produced while it streams; by default buffered and passed whole to onOutput on close
+    virtual std::unique_ptr<OutputStream> openOutput(const OutputNode& node);
+    // Content to add at the end of what the node's output already holds; by default passed to onOutput alone
+    virtual void appendOutput(const OutputNode& node, std::string_view content) {
+        onOutput(node, content);
+    }
+};
+
+class BufferedOutputStream : public OutputStream {
+public:
+    BufferedOutputStream(ResultSink& sink, const OutputNode& node) : m_sink(sink), m_node(node) {}
+
+    void append(std::string_view content) override {
+        m_content.append(content.data(), content.size());
+    }
+    void close() override {
+        m_sink.onOutput(m_node, m_content);
+    }
+private:
+    ResultSink& m_sink;
+    const OutputNode& m_node;
+    std::string m_content;
+};
+
+inline std::unique_ptr<OutputStream> ResultSink::openOutput(const OutputNode& node) {
+    return std::make_unique<BufferedOutputStream>(*this, node);
+}
+
+class FileOutputStream : public OutputStream {
+public:
+    explicit FileOutputStream(std::unique_ptr<std::ofstream> file) : m_file(std::move(file)) {}
+
+    void append(std::string_view content) override {
+        m_file->write(content.data(), static_cast<std::streamsize>(content.size()));
+    }
+    void close() override {
+        m_file->close();
+    }
+private:
+    std::unique_ptr<std::ofstream> m_file;
+};
+
+struct NullResultSink : public ResultSink {
+    void onDisplay(const DisplayNode& node, std::string_view content) override {}
+    void onOutput(const OutputNode& node, std::string_view content) override {}
+    void appendOutput(const OutputNode& node, std::string_view content) override {}
+    // Drops the pieces instead of gathering them for onOutput
+    std::unique_ptr<OutputStream> openOutput(const OutputNode& node) override {
+        struct Discard : public OutputStream {
+            void append(std::string_view content) override {}
+            void close() override {}
+        };
+        return std::make_unique<Discard>();
+    }
+};
+
+// Same destinations as Flow::executeFlow : the console for displays and the FileSystem for outputs
+class ConsoleResultSink : public ResultSink {
+public:
+    void onDisplay(const DisplayNode& node, std::string_view content) override {
+        std::cout.write(content.data(), content.size());
+        std::cout << "\n";
+    }
+    ConsoleResultSink() = default;
+    ConsoleResultSink(const ConsoleResultSink&) = delete;
+    ConsoleResultSink& operator=(const ConsoleResultSink&) = delete;
+    ~ConsoleResultSink() {
+        flush();
+    }
+
+    // The file is written asynchronously, together with the other outputs of the run, see flush
+    void onOutput(const OutputNode& node, std::string_view content) override {
+        auto handle = getHandle(node);
+        fileSystem->clearFile(handle);
+        if (!fileSystem->writeToFile(handle, std::string(content))) {
+            return;
+        }
+        std::string path = fileSystem->getOutputFilePath(handle);
+        if (std::find(m_pendingPaths.begin(), m_pendingPaths.end(), path) != m_pendingPaths.end()) {
+            // the earlier content of the same file must land first
+            flush();
+        }
+        if (m_io == nullptr) {
+            m_io = AsyncIO::create();
+        }
+        m_pending.emplace_back(content);
+        m_pendingPaths.push_back(path);
+        m_io->writeFile(path, m_pending.back(), [path](bool succeeded) {
+            if (!succeeded) {
+                std::cerr << "Failed to open file stream for file " << path;
+            }
+        });
+        m_io->submit();
+    }
+
+    // Waits until every output file was written
+    void flush() {
+        if (m_io != nullptr) {
+            m_io->wait();
+        }
+        m_pending.clear();
+        m_pendingPaths.clear();
+    }
+    // Written at once, after the pending writes of the same file. Only the file grows : the in memory
+    // handle keeps what onOutput gave, so a long follow does not hold the whole output
+    void appendOutput(const OutputNode& node, std::string_view content) override {
+        auto handle = getHandle(node);
+        std::string path = fileSystem->getOutputFilePath(handle);
+        if (std::find(m_pendingPaths.begin(), m_pendingPaths.end(), path) != m_pendingPaths.end()) {
+            flush();
+        }
+        auto file = fileSystem->openOutputFile(handle, true);
+        if (file != nullptr) {
+            file->write(content.data(), static_cast<std::streamsize>(content.size()));
+        }
+    }
+    // Writes straight to the file instead of building the content in memory first
+    std::unique_ptr<OutputStream> openOutput(const OutputNode& node) override {
+        auto file = fileSystem->openOutputFile(getHandle(node));
+        if (file == nullptr) {
+            throw InvalidHandle("Failed to open the output file");
+        }
+        return std::make_unique<FileOutputStream>(std::move(file));
+    }
+private:
+    FileSystem* fileSystem = FileSystem::getInstance();
+    std::unordered_map<NodeUid, std::shared_ptr<FileHandle>> m_handles;
+    std::unique_ptr<AsyncIO> m_io;
+    // contents being written, kept alive until flush
+    std::deque<std::string> m_pending;
+    std::vector<std::string> m_pendingPaths;
+
+    FileHandle* getHandle(const OutputNode& node) {
+        auto iterator = m_handles.find(node.getUid());
+        if (iterator == m_handles.end()) {
+            auto handle = fileSystem->getFileHandle(node.getFileName(), FileHandle::parseExtension(node.getExtension()));
+            if (handle == nullptr) {
+                throw InvalidHandle("Failed to get a valid handle");
+            }
+            iterator = m_handles.emplace(node.getUid(), handle).first;
+        }
+        return iterator->second.get();
+    }
+};
+
+// Forwards to another sink one call at a time, for runs on several threads sharing a destination
+class SerializedResultSink : public ResultSink {
+public:
+    SerializedResultSink(ResultSink& target, std::mutex& mutex) : m_target(target), m_mutex(mutex) {}
+
+    void onDisplay(const DisplayNode& node, std::string_view content) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_target.onDisplay(node, content);
+    }
+    void onOutput(const OutputNode& node, std::string_view content) override {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_target.onOutput(node, content);
+    }
+private:
+    ResultSink& m_target;
+    std::mutex& m_mutex;
+};
+
+/**
+ * Immutable, non interactive form of a Flow.
+ *
+ * The flow is finalized into a FlowGraph, every node is resolved once into a step indexed like the
+ * graph and the operation of each calculus node is bound to a shared instance, so executing the
+ * plan needs neither hash lookups nor dynamic_casts. A plan can be shared by any number of
+ * ExecutionContexts, one per thread. The nodes are borrowed from the Flow, which must outlive the plan.
+ */
+class ExecutionPlan : private NodeVisitor {
+public:
+    typedef FlowGraph::Index Index;
+
+    struct Step {
+        // declared type of the node value, Unknown for nodes that produce none
+        PrimitiveType valueType;
+        const Operation<float>* numberOperation;
+        const Operation<std::string>* stringOperation;
+        // how a FloatCalculus node folds its operands, resolved against its operation
+        SummationMode summation;
+        // index of the per context state of stateful nodes, such as the window of a WindowAggregate node or the joiner of a HashJoin node
+        uint32_t stateIndex;
+    };
+
+    explicit ExecutionPlan(const Flow& flow) : m_graph(flow.finalize()) {
+        m_steps.reserve(m_graph.getNodeCount());
+        m_needsText.assign(m_graph.getNodeCount(), false);
+        for (Index index = 0; index < m_graph.getNodeCount(); index++) {
+            m_graph.getNode(index)->acceptVisitor(*this);
+            m_maxOperandCount = std::max(m_maxOperandCount, m_graph.getDependencies(index).size());
+        }
+        m_streamed.assign(m_graph.getNodeCount(), false);
+        for (auto slot : m_graph.getNodesOfType(NodeType::FileInput)) {
+            auto dependents = m_graph.getDependents(slot);
+            m_streamed[slot] = !dependents.empty() && std::all_of(dependents.begin(), dependents.end(), [this](Index dependent) {
+                return scansFileInputs(m_graph.getType(dependent));
+                });
+        }
+        m_mergedByOutput.assign(m_graph.getNodeCount(), false);
+        for (auto slot : m_graph.getNodesOfType(NodeType::Sort)) {
+            auto dependents = m_graph.getDependents(slot);
+            if (dependents.size() != 1 || m_graph.getType(dependents[0]) != NodeType::Output) continue;
+            auto operands = m_graph.getDependencies(dependents[0]);
+            m_mergedByOutput[slot] = std::count(operands.begin(), operands.end(), slot) == 1;
+        }
+    }
+
+    const FlowGraph& getGraph() const noexcept {
+        return m_graph;
+    }
+    const std::vector<Step>& getSteps() const noexcept {
+        return m_steps;
+    }
+    size_t getSlotCount() const noexcept {
+        return m_steps.size();
+    }
+    size_t getMaxOperandCount() const noexcept {
+        return m_maxOperandCount;
+    }
+    // True when a string consumer reads this numeric slot and it has to be formatted
+    bool needsText(Index slot) const noexcept {
+        return m_needsText[slot];
+    }
+    Index getSlot(NodeUid uid) const {
+        return m_graph.getIndex(uid);
+    }
+    size_t getWindowCount() const noexcept {
+        return m_graph.getNodesOfType(NodeType::WindowAggregate).size();
+    }
+    size_t getJoinCount() const noexcept {
+        return m_graph.getNodesOfType(NodeType::HashJoin).size();
+    }
+    size_t getSortCount() const noexcept {
+        return m_graph.getNodesOfType(NodeType::Sort).size();
+    }
+    size_t getSearchCount() const noexcept {
+        return m_graph.getNodesOfType(NodeType::Search).size();
+    }
+    size_t getSketchCount() const noexcept {
+        return m_graph.getNodesOfType(NodeType::Sketch).size();
+    }
+    size_t getGroupByCount() const noexcept {
+        return m_graph.getNodesOfType(NodeType::GroupBy).size();
+    }
+    /**
+     * True for file inputs read only by nodes that scan the file themselves instead of loading it.
+     * A filter then drops the rejected rows while scanning, so they are never copied in memory.
+     */
+    bool isStreamed(Index slot) const noexcept {
+        return m_streamed[slot];
+    }
+    /**
+     * True for sorts read only by one Output node. When such a sort spills, its runs are merged
+     * straight into the output stream and the sorted rows are never held in memory.
+     */
+    bool isMergedByOutput(Index slot) const noexcept {
+        return m_mergedByOutput[slot];
+    }
+    static bool scansFileInputs(NodeType type) noexcept {
+        return type == NodeType::HashJoin || type == NodeType::Filter || type == NodeType::Sort || type == NodeType::Search || type == NodeType::Sketch;
+    }
+
+private:
+    FlowGraph m_graph;
+    std::vector<Step> m_steps;
+    std::vector<bool> m_needsText;
+    std::vector<bool> m_streamed;
+    std::vector<bool> m_mergedByOutput;
+    size_t m_maxOperandCount = 0;
+    uint32_t m_windowCount = 0;
+    uint32_t m_joinCount = 0;
+    uint32_t m_sortCount = 0;
+    uint32_t m_searchCount = 0;
+    uint32_t m_sketchCount = 0;
+    uint32_t m_groupByCount = 0;
+
+    Index currentSlot() const noexcept {
+        return Index(m_steps.size() - 1);
+    }
+
+    void addStep(PrimitiveType valueType) {
+        m_steps.push_back(Step{ valueType, nullptr, nullptr, SummationMode::Plain, 0 });
+    }
+
+    // marks the numeric dependencies of the current step that have to be formatted as text
+    void readsText() {
+        for (auto dependency : m_graph.getDependencies(currentSlot())) {
+            auto valueType = m_steps[dependency].valueType;
+            if (valueType != PrimitiveType::String && valueType != PrimitiveType::Unknown) {
+                m_needsText[dependency] = true;
+            }
+        }
+    }
+
+    void visit(NumberInputNode& node) override {
+        addStep(PrimitiveType::Float);
+    }
+    void visit(TextInputNode& node) override {
+        addStep(PrimitiveType::String);
+    }
+    void visit(FileInputNode& node) override {
+        addStep(PrimitiveType::String);
+    }
+    void visit(TextNode& node) override {
+        addStep(PrimitiveType::String);
+    }
+    void visit(TitleNode& node) override {
+        addStep(PrimitiveType::String);
+    }
+    void visit(FloatCalculusNode& node) override {
+        addStep(PrimitiveType::Float);
+        for (auto dependency : m_graph.getDependencies(currentSlot())) {
+            auto type = m_graph.getType(dependency);
+            if (!isNumericNodeType(type)) {
+                std::stringstream ss;
+                ss << "Operation cannot be performed! The nodes must be either of type NumberInput, FloatCalculus and / or WindowAggregate" << "\n";
+                ss << "Provided type is : " << nodeTypeToString(type);
+                throw InvalidInput(ss.str().c_str());
+            }
+        }
+        m_steps.back().numberOperation = &OperationFactory<float>::getInstance().getSharedOperation(node.getOperationType());
+        m_steps.back().summation = Calculation<float>::summationFor(node.getOperationType(), node.getSummation());
+    }
+    void visit(StringCalculusNode& node) override {
+        addStep(PrimitiveType::String);
+        readsText();
+        if (m_graph.getDependencies(currentSlot()).empty()) {
+            throw InvalidInput("String Calculus node has no operands");
+        }
+        m_steps.back().stringOperation = &OperationFactory<std::string>::getInstance().getSharedOperation(node.getOperationType());
+    }
+    void visit(DisplayNode& node) override {
+        addStep(PrimitiveType::Unknown);
+        readsText();
+    }
+    void visit(OutputNode& node) override {
+        addStep(PrimitiveType::Unknown);
+        readsText();
+    }
+    void visit(WindowAggregateNode& node) override {
+        addStep(PrimitiveType::Double);
+        if (m_graph.getDependencies(currentSlot()).empty()) {
+            throw InvalidInput("Window Aggregate node has no input");
+        }
+        m_steps.back().stateIndex = m_windowCount++;
+    }
+    void visit(GroupByNode& node) override {
+        addStep(PrimitiveType::String);
+        requireInputs("Group By", 1);
+        m_steps.back().stateIndex = m_groupByCount++;
+    }
+    void visit(HashJoinNode& node) override {
+        addStep(PrimitiveType::String);
+        requireInputs("Hash Join", 2);
+        m_steps.back().stateIndex = m_joinCount++;
+    }
+    void visit(FilterNode& node) override {
+        addStep(PrimitiveType::String);
+        requireInputs("Filter", 1);
+    }
+    void visit(SortNode& node) override {
+        addStep(PrimitiveType::String);
+        requireInputs("Sort", 1);
+        if (node.getKeys().empty()) {
+            throw InvalidInput("Sort node has no key columns");
+        }
+        m_steps.back().stateIndex = m_sortCount++;
+    }
+    void visit(SearchNode& node) override {
+        addStep(PrimitiveType::String);
+        requireInputs("Search", 1);
+        m_steps.back().stateIndex = m_searchCount++;
+    }
+    void visit(TokenizeNode& node) override {
+        addStep(PrimitiveType::String);
+        requireInputs("Tokenize", 1);
+    }
+    void visit(SketchNode& node) override {
+        addStep(PrimitiveType::String);
+        requireInputs("Sketch", 1);
+        m_steps.back().stateIndex = m_sketchCount++;
+    }
+    void visit(VectorNode& node) override {
+        addStep(PrimitiveType::Vector);
+        requireInputs("Vector", 1);
+    }
+    void visit(VectorCalculusNode& node) override {
+        addStep(PrimitiveType::Vector);
+        if (m_graph.getDependencies(currentSlot()).empty()) {
+            throw InvalidInput("Vector Calculus node has no operands");
+        }
+        requireVectorOperands(true);
+    }
+    void visit(VectorReduceNode& node) override {
+        addStep(PrimitiveType::Double);
+        requireInputs("Vector Reduce", node.getReduction() == VectorReduction::Dot ? 2 : 1);
+        requireVectorOperands(false);
+    }
+    void visit(EndNode& node) override {
+        addStep(PrimitiveType::Unknown);
+    }
+
+    void requireVectorOperands(bool acceptsNumbers) const {
+        for (auto dependency : m_graph.getDependencies(currentSlot())) {
+            auto type = m_graph.getType(dependency);
+            if (!isVectorNodeType(type) && !(acceptsNumbers && isNumericNodeType(type))) {
+                std::stringstream ss;
+                ss << "Operation cannot be performed! The nodes must be of type Vector or VectorCalculus" << (acceptsNumbers ? " or numbers" : "") << "\n";
+                ss << "Provided type is : " << nodeTypeToString(type);
+                throw InvalidInput(ss.str().c_str());
+            }
+        }
+    }
+
+    void requireInputs(const char* nodeName, size_t count) const {
+        if (m_graph.getDependencies(currentSlot()).size() != count) {
+            std::stringstream ss;
+            ss << nodeName << " node with uid = " << m_graph.getUid(currentSlot()) << " needs exactly " << count << (count == 1 ? " input" : " inputs");
+            throw InvalidInput(ss.str().c_str());
+        }
+    }
+};
+
+/**
+ * Per thread state of a prepared flow : a ValueTable indexed like the graph plus the scratch buffers used while running.
+ *
+ * Inputs are bound instead of prompted. prepare() loads the file inputs that were not bound and
+ * performs a sizing pass, after which run() does not allocate as long as the bound inputs do not
+ * outgrow the capacity reached so far. Values are converted only when a consumer needs another type.
+ */
+class ExecutionContext {
+public:
+    typedef ExecutionPlan::Index Index;
+
+    explicit ExecutionContext(const ExecutionPlan& plan)
+        : m_plan(plan), m_graph(plan.getGraph()), m_values(plan.getSlotCount()), m_marks(plan.getSlotCount(), 0) {
+        m_pending.reserve(plan.getSlotCount());
+        m_numberOperands.reserve(plan.getMaxOperandCount());
+        m_textOperands.reserve(plan.getMaxOperandCount());
+        m_vectorOperands.reserve(plan.getMaxOperandCount());
+        m_windows.reserve(plan.getWindowCount());
+        for (auto slot : m_graph.getNodesOfType(NodeType::WindowAggregate)) {
+            auto& node = static_cast<WindowAggregateNode&>(*m_graph.getNode(slot));
+            m_windows.emplace_back(node.getWindowSize(), node.getWindowSeconds());
+        }
+        m_joiners.reserve(plan.getJoinCount());
+        for (auto slot : m_graph.getNodesOfType(NodeType::HashJoin)) {
+            m_joiners.push_back(static_cast<const HashJoinNode&>(*m_graph.getNode(slot)).createJoiner());
+        }
+        m_searches.resize(plan.getSearchCount());
+        m_sketches.reserve(plan.getSketchCount());
+        for (auto slot : m_graph.getNodesOfType(NodeType::Sketch)) {
+            m_sketches.push_back(static_cast<const SketchNode&>(*m_graph.getNode(slot)).getCounter().createState());
+        }
+        m_groupBys.reserve(plan.getGroupByCount());
+        for (auto slot : m_graph.getNodesOfType(NodeType::GroupBy)) {
+            m_groupBys.push_back(static_cast<const GroupByNode&>(*m_graph.getNode(slot)).getAggregator().createState());
+        }
+        m_sorters.reserve(plan.getSortCount());
+        for (auto slot : m_graph.getNodesOfType(NodeType::Sort)) {
+            m_sorters.push_back(static_cast<const SortNode&>(*m_graph.getNode(slot)).createSorter());
+        }
+        for (Index slot = 0; slot < plan.getSlotCount(); slot++) {
+            auto type = m_graph.getType(slot);
+            if (type == NodeType::Text || type == NodeType::Title) {
+                m_values[slot].setString(asDisplayable(m_graph.getNode(slot))->getContent());
+            }
+            else if (isVectorNodeType(type)) {
+                m_values[slot].editVector();
+            }
+            else if (isNumericNodeType(type)) {
+                m_values[slot].setFloat(0.0f);
+                if (plan.needsText(slot)) {
+                    m_values[slot].reserveText(Value::NumberTextCapacity);
+                }
+            }
+        }
+    }
+
+    void bindNumber(NodeUid uid, float value) {
+        m_values[slotOfType(uid, NodeType::NumberInput)].setFloat(value);
+    }
+    void bindInteger(NodeUid uid, int64_t value) {
+        m_values[slotOfType(uid, NodeType::NumberInput)].setInteger(value);
+    }
+    void bindDouble(NodeUid uid, double value) {
+        m_values[slotOfType(uid, NodeType::NumberInput)].setDouble(value);
+    }
+    // Binds the content of a TextInput or FileInput node, reusing the capacity of the previous binding
+    void bindText(NodeUid uid, std::string_view text) {
+        auto slot = m_plan.getSlot(uid);
+        auto type = m_graph.getType(slot);
+        if (type != NodeType::TextInput && type != NodeType::FileInput) {
+            throw InvalidInput(cannotHold(uid, type).c_str());
+        }
+        m_values[slot].setString(text);
+    }
+
+    /**
+     * Tells whether the texts bound to the inputs are only what was appended to their streams since
+     * the previous run, each starting with the header line when the stream has one. Windows over
+     * texts then keep their samples from one run to the next, and Group By and Sketch nodes over
+     * texts held in memory add every run to the aggregates of the runs before. By default a text is
+     * the whole stream and all of them start over on every run. Set it before the first run.
+     */
+    void setAppendedTexts(bool appended) noexcept {
+        m_appendedTexts = appended;
+    }
+
+    // Puts the TextInput and NumberInput nodes back to what an unbound run sees : empty text and 0
+    void resetInputs() {
+        for (auto slot : m_graph.getNodesOfType(NodeType::TextInput)) {
+            m_values[slot].setString(std::string_view());
+        }
+        for (auto slot : m_graph.getNodesOfType(NodeType::NumberInput)) {
+            m_values[slot].setFloat(0.0f);
+        }
+    }
+    // Forgets what was bound to a FileInput node, so its file is read again
+    void unbindFile(NodeUid uid) {
+        m_values[slotOfType(uid, NodeType::FileInput)].clear();
+    }
+
+    // Reads the unbound file inputs, except the ones joins stream
+    void loadInputs() {
+        std::vector<Index> slots;
+        for (auto slot : m_graph.getNodesOfType(NodeType::FileInput)) {
+            if (!m_values[slot].isSet() && !m_plan.isStreamed(slot)) {
+                slots.push_back(slot);
+            }
+        }
+        loadFileInputs(slots);
+    }
+
+    /**
+     * Re-reads the given FileInput nodes and recomputes only the nodes depending on them, directly
+     * or through other nodes, in execution order; every other node keeps its value. Streamed inputs
+     * are read again by the nodes scanning them.
+     */
+    void rerunFrom(const std::vector<NodeUid>& changed, ResultSink& sink) {
+        if (++m_epoch == 0) {
+            std::fill(m_marks.begin(), m_marks.end(), 0);
+            m_epoch = 1;
+        }
+
+        std::vector<Index> reloaded;
+        Index first = m_plan.getSlotCount();
+        m_pending.clear();
+        for (auto uid : changed) {
+            const Index slot = slotOfType(uid, NodeType::FileInput);
+            if (m_marks[slot] == m_epoch) continue;
+            m_marks[slot] = m_epoch;
+            m_pending.push_back(slot);
+            if (!m_plan.isStreamed(slot)) {
+                reloaded.push_back(slot);
+            }
+        }
+        while (!m_pending.empty()) {
+            Index slot = m_pending.back();
+            m_pending.pop_back();
+            first = std::min(first, slot);
+            for (auto dependent : m_graph.getDependents(slot)) {
+                if (m_marks[dependent] != m_epoch) {
+                    m_marks[dependent] = m_epoch;
+                    m_pending.push_back(dependent);
+                }
+            }
+        }
+
+        loadFileInputs(reloaded);
+        for (Index slot = first; slot < m_plan.getSlotCount(); slot++) {
+            if (m_marks[slot] == m_epoch) {
+                runStep(slot, sink);
+            }
+        }
+    }
+
+    // Loads the inputs and sizes every scratch buffer with a dry run, which leaves the windows empty
+    void prepare() {
+        loadInputs();
+        NullResultSink sink;
+        run(sink);
+        for (auto& window : m_windows) {
+            window.clear();
+        }
+    }
+
+    void run(ResultSink& sink) {
+        for (Index slot = 0; slot < m_plan.getSlotCount(); slot++) {
+            runStep(slot, sink);
+        }
+    }
+
+    /**
+     * Computes a single node, pulling only its transitive dependencies.
+     *
+     * Every needed node runs once, in execution order; unrelated nodes keep their values and
+     * unbound file inputs outside the dependency closure are never read.
+     *
+     * @return The value of the requested node.
+     */
+    const Value& evaluate(NodeUid uid, ResultSink& sink) {
+        const Index target = m_plan.getSlot(uid);
+        if (++m_epoch == 0) {
+            std::fill(m_marks.begin(), m_marks.end(), 0);
+            m_epoch = 1;
+        }
+
+        Index first = target;
+        m_pending.clear();
+        m_pending.push_back(target);
+        m_marks[target] = m_epoch;
+        while (!m_pending.empty()) {
+            Index slot = m_pending.back();
+            m_pending.pop_back();
+            first = std::min(first, slot);
+            for (auto dependency : m_graph.getDependencies(slot)) {
+                if (m_marks[dependency] != m_epoch) {
+                    m_marks[dependency] = m_epoch;
+                    m_pending.push_back(dependency);
+                }
+            }
+        }
+
+        for (Index slot = first; slot <= target; slot++) {
+            if (m_marks[slot] != m_epoch) continue;
+            if (m_graph.getType(slot) == NodeType::FileInput && !m_values[slot].isSet() && !m_plan.isStreamed(slot)) {
+                loadFileInput(slot);
+            }
+            runStep(slot, sink);
+        }
+        if (auto sorter = pendingSorter(target)) {
+            // asked for the sort itself, the rows its Output node would have merged are needed here
+            while (sorter->next(m_values[target].editString(), size_t(-1))) {}
+        }
+        return m_values[target];
+    }
+
+    const Value& getValue(NodeUid uid) const {
+        return m_values[m_plan.getSlot(uid)];
+    }
+    float getNumber(NodeUid uid) const {
+        return getValue(uid).asFloat();
+    }
+    const std::string& getText(NodeUid uid) const {
+        return getValue(uid).asText();
+    }
+
+private:
+    const ExecutionPlan& m_plan;
+    const FlowGraph& m_graph;
+    ValueTable m_values;
+    // evaluate() marks the nodes of the current call with m_epoch, so no clearing is needed between calls
+    std::vector<uint32_t> m_marks;
+    std::vector<Index> m_pending;
+    uint32_t m_epoch = 0;
+    bool m_appendedTexts = false;
+    std::vector<float> m_numberOperands;
+    std::vector<const std::string*> m_textOperands;
+    std::vector<VectorOperand> m_vectorOperands;
+    std::vector<SlidingWindow> m_windows;
+    std::vector<HashJoiner> m_joiners;
+    std::vector<ExternalSorter> m_sorters;
+    std::vector<SearchScan> m_searches;
+    std::vector<SketchState> m_sketches;
+    std::vector<GroupByState> m_groupBys;
+    std::string m_scanBuffer;
+    std::vector<std::string_view> m_fields;
+    const std::string m_empty;
+
+    // Streamed files are read in blocks of this size
+    static constexpr size_t ScanBlockSize = 1 << 20;
+
+    std::shared_ptr<FileHandle> getInputHandle(Index slot) const {
+        auto& node = static_cast<const FileInputNode&>(*m_graph.getNode(slot));
+        auto handle = FileSystem::getInstance()->getFileHandle(node.getFileName(), FileHandle::parseExtension(node.getExtension()));
+        if (handle == nullptr) {
+            throw InvalidHandle((std::string("Failed to get a file handle for file ") + std::string(node.getFileName()) + std::string(node.getExtension())).c_str());
+        }
+        return handle;
+    }
+
+    // Reads the files in one batch, so a flow with many inputs waits on them together
+    void loadFileInputs(const std::vector<Index>& slots) {
+        std::vector<std::shared_ptr<FileHandle>> handles;
+        std::vector<FileHandle*> files;
+        for (auto slot : slots) {
+            handles.push_back(getInputHandle(slot));
+            files.push_back(handles.back().get());
+        }
+        auto contents = FileSystem::getInstance()->readInputFiles(files);
+        for (size_t index = 0; index < slots.size(); index++) {
+            m_values[slots[index]].setString(std::move(contents[index]));
+        }
+    }
+
+    void loadFileInput(Index slot) {
+        m_values[slot].setString(FileSystem::getInstance()->readFromInputFile(getInputHandle(slot).get()));
+    }
+
+    // A streamed file input that nothing bound or loaded is read straight from its file
+    bool isOnDisk(Index slot) const noexcept {
+        return m_plan.isStreamed(slot) && !m_values[slot].isSet();
+    }
+
+    void runStep(Index slot, ResultSink& sink) {
+        const auto& step = m_plan.getSteps()[slot];
+        switch (m_graph.getType(slot)) {
+        case NodeType::FloatCalculus:
+            computeNumber(slot, *step.numberOperation, step.summation);
+            break;
+        case NodeType::StringCalculus:
+            computeText(slot, *step.stringOperation);
+            break;
+        case NodeType::WindowAggregate:
+            computeWindow(slot, m_windows[step.stateIndex]);
+            break;
+        case NodeType::HashJoin:
+            computeJoin(slot, m_joiners[step.stateIndex]);
+            break;
+        case NodeType::Filter:
+            computeFilter(slot, static_cast<const FilterNode&>(*m_graph.getNode(slot)).getFilter());
+            break;
+        case NodeType::Sort:
+            computeSort(slot, m_sorters[step.stateIndex]);
+            break;
+        case NodeType::Search:
+            computeSearch(slot, static_cast<const SearchNode&>(*m_graph.getNode(slot)).getSearcher(), m_searches[step.stateIndex]);
+            break;
+        case NodeType::Tokenize: {
+            auto& text = m_values[slot].editString();
+            text.clear();
+            static_cast<const TokenizeNode&>(*m_graph.getNode(slot)).getCounter().count(textOf(m_graph.getDependencies(slot)[0]), text);
+            break;
+        }
+        case NodeType::Sketch:
+            computeSketch(slot, static_cast<const SketchNode&>(*m_graph.getNode(slot)).getCounter(), m_sketches[step.stateIndex]);
+            break;
+        case NodeType::Vector:
+            parseNumbers(textOf(m_graph.getDependencies(slot)[0]), static_cast<const VectorNode&>(*m_graph.getNode(slot)).getColumn(), m_values[slot].editVector());
+            break;
+        case NodeType::VectorCalculus:
+            gatherVectorOperands(slot);
+            VectorCalculation().executeInto(m_vectorOperands.data(), m_vectorOperands.size(),
+                static_cast<const VectorCalculusNode&>(*m_graph.getNode(slot)).getOperationType(), m_values[slot].editVector());
+            break;
+        case NodeType::VectorReduce:
+            gatherVectorOperands(slot);
+            m_values[slot].setDouble(VectorCalculation().reduce(m_vectorOperands.data(), m_vectorOperands.size(),
+                static_cast<const VectorReduceNode&>(*m_graph.getNode(slot)).getReduction()));
+            break;
+        case NodeType::GroupBy: {
+            auto& aggregator = static_cast<const GroupByNode&>(*m_graph.getNode(slot)).getAggregator();
+            if (m_appendedTexts) {
+                aggregator.accumulate(textOf(m_graph.getDependencies(slot)[0]), m_groupBys[step.stateIndex], m_values[slot].editString());
+            }
+            else {
+                aggregator.aggregate(textOf(m_graph.getDependencies(slot)[0]), m_values[slot].editString());
+            }
+            break;
+        }
+        case NodeType::Display: {
+            auto& text = m_values[slot].editString();
+            text.clear();
+            joinOperands(slot, ' ', false, text);
+            sink.onDisplay(static_cast<const DisplayNode&>(*m_graph.getNode(slot)), text);
+            break;
+        }
+        case NodeType::Output: {
+            auto& text = m_values[slot].editString();
+            if (hasPendingSort(slot)) {
+                writeOutput(slot, sink, text);
+                break;
+            }
+            renderOutput(slot, text);
+            sink.onOutput(static_cast<const OutputNode&>(*m_graph.getNode(slot)), text);
+            break;
+        }
+        default:
+            break;
+        }
+    }
+
+    static std::string cannotHold(NodeUid uid, NodeType type) {
+        std::stringstream ss;
+        ss << "Node with uid = " << uid << " of type " << nodeTypeToString(type) << " cannot hold this value";
+        return ss.str();
+    }
+
+    Index slotOfType(NodeUid uid, NodeType expected) const {
+        auto slot = m_plan.getSlot(uid);
+        if (m_graph.getType(slot) != expected) {
+            throw InvalidInput(cannotHold(uid, m_graph.getType(slot)).c_str());
+        }
+        return slot;
+    }
+
+    // Display, Output and End nodes are not Displayable and read as empty
+    const std::string& textOf(Index slot) const noexcept {
+        return m_plan.getSteps()[slot].valueType == PrimitiveType::Unknown ? m_empty : m_values[slot].asText();
+    }
+
+    void computeNumber(Index slot, const Operation<float>& operation, SummationMode summation) {
+        auto operands = m_graph.getDependencies(slot);
+        if (operands.empty()) return;
+        m_numberOperands.clear();
+        for (auto operand : operands) {
+            m_numberOperands.push_back(m_values[operand].asFloat());
+        }
+        float result = 0.0f;
+        Calculation<float>(summation).executeInto(m_numberOperands.data(), m_numberOperands.size(), operation, result);
+        m_values[slot].setFloat(result);
+    }
+
+    void computeText(Index slot, const Operation<std::string>& operation) {
+        m_textOperands.clear();
+        for (auto operand : m_graph.getDependencies(slot)) {
+            m_textOperands.push_back(&textOf(operand));
+        }
+        Calculation<std::string>().executeInto(m_textOperands.data(), m_textOperands.size(), operation, m_values[slot].editString());
+    }
+
+    // Vector values are read in place, numbers are broadcast
+    void gatherVectorOperands(Index slot) {
+        m_vectorOperands.clear();
+        for (auto operand : m_graph.getDependencies(slot)) {
+            const auto& value = m_values[operand];
+            m_vectorOperands.push_back(value.getType() == PrimitiveType::Vector ? VectorOperand::ofVector(value.asVector()) : VectorOperand::ofScalar(value.asFloat()));
+        }
+    }
+
+    // A text operand holds its whole stream, so the window starts over unless the texts are appended ones
+    void computeWindow(Index slot, SlidingWindow& window) {
+        auto& node = static_cast<const WindowAggregateNode&>(*m_graph.getNode(slot));
+        double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+        auto operands = m_graph.getDependencies(slot);
+        if (!m_appendedTexts && std::any_of(operands.begin(), operands.end(), [this](Index operand) { return m_values[operand].getType() == PrimitiveType::String; })) {
+            window.clear();
+        }
+        for (auto operand : operands) {
+            const auto& value = m_values[operand];
+            if (value.isNumeric()) {
+                window.push(value.asDouble(), now);
+            }
+            else if (value.getType() == PrimitiveType::String) {
+                window.pushText(value.asText(), now);
+            }
+        }
+        m_values[slot].setDouble(window.get(node.getStatistic()));
+    }
+
+    // Builds on the smaller input and streams the other one through the table
+    void computeJoin(Index slot, HashJoiner& joiner) {
+        auto& result = m_values[slot].editString();
+        result.clear();
+        const auto inputs = m_graph.getDependencies(slot);
+        const Index left = inputs[0], right = inputs[1];
+        bool buildIsLeft = inputSize(left) < inputSize(right);
+        const Index build = buildIsLeft ? left : right;
+        const Index probe = buildIsLeft ? right : left;
+
+        if (isOnDisk(build)) {
+            joiner.getBuildBuffer() = FileSystem::getInstance()->readFromInputFile(getInputHandle(build).get());
+            joiner.build(joiner.getBuildBuffer(), buildIsLeft);
+        }
+        else {
+            joiner.build(textOf(build), buildIsLeft);
+        }
+
+        if (isOnDisk(probe)) {
+            bool header = true;
+            FileSystem::getInstance()->scanInputFile(getInputHandle(probe).get(), m_scanBuffer, ScanBlockSize, [&](std::string_view lines) {
+                if (header) {
+                    size_t end = lines.find('\n');
+                    joiner.beginProbe(lines.substr(0, end), result);
+                    header = false;
+                    if (end == std::string_view::npos) return;
+                    lines.remove_prefix(end + 1);
+                }
+                joiner.probe(lines, result);
+                });
+        }
+        else {
+            joiner.probeAll(textOf(probe), result);
+        }
+        joiner.finish(result);
+    }
+
+    void computeFilter(Index slot, const RowFilter& filter) {
+        auto& result = m_values[slot].editString();
+        result.clear();
+        const Index source = m_graph.getDependencies(slot)[0];
+        if (!isOnDisk(source)) {
+            filter.apply(textOf(source), m_fields, result);
+            return;
+        }
+        bool header = true;
+        size_t column = 0;
+        FileSystem::getInstance()->scanInputFile(getInputHandle(source).get(), m_scanBuffer, ScanBlockSize, [&](std::string_view lines) {
+            if (header) {
+                size_t end = lines.find('\n');
+                column = filter.begin(lines.substr(0, end), m_fields, result);
+                header = false;
+                if (end == std::string_view::npos) return;
+                lines.remove_prefix(end + 1);
+            }
+            filter.appendMatches(lines, column, m_fields, result);
+            });
+    }
+
+    void computeSort(Index slot, ExternalSorter& sorter) {
+        auto& result = m_values[slot].editString();
+        result.clear();
+        const Index source = m_graph.getDependencies(slot)[0];
+        if (!isOnDisk(source)) {
+            sorter.sort(textOf(source), result);
+            return;
+        }
+        bool header = true;
+        FileSystem::getInstance()->scanInputFile(getInputHandle(source).get(), m_scanBuffer, ScanBlockSize, [&](std::string_view lines) {
+            if (header) {
+                size_t end = lines.find('\n');
+                sorter.begin(lines.substr(0, end), result);
+                header = false;
+                if (end == std::string_view::npos) return;
+                lines.remove_prefix(end + 1);
+            }
+            sorter.add(lines);
+            });
+        if (!header && m_plan.isMergedByOutput(slot) && sorter.getRunCount() != 0) {
+            // the Output node takes the rows from the sorter, see writeOutput
+            sorter.complete();
+            return;
+        }
+        sorter.finish(result);
+    }
+
+    void computeSearch(Index slot, const TextSearcher& searcher, SearchScan& scan) {
+        auto& result = m_values[slot].editString();
+        result.clear();
+        const Index source = m_graph.getDependencies(slot)[0];
+        if (!isOnDisk(source)) {
+            searcher.searchAll(textOf(source), scan, result);
+            return;
+        }
+        searcher.begin(scan, result);
+        FileSystem::getInstance()->scanInputFile(getInputHandle(source).get(), m_scanBuffer, ScanBlockSize, [&](std::string_view lines) {
+            searcher.search(lines, scan, result);
+            });
+        searcher.finish(scan, result);
+    }
+
+    void computeSketch(Index slot, const SketchCounter& counter, SketchState& state) {
+        auto& result = m_values[slot].editString();
+        result.clear();
+        const Index source = m_graph.getDependencies(slot)[0];
+        if (!isOnDisk(source)) {
+            if (m_appendedTexts) {
+                counter.resume(state);
+                counter.add(textOf(source), state);
+                counter.finish(state, result);
+                return;
+            }
+            counter.sketchAll(textOf(source), state, result);
+            return;
+        }
+        counter.begin(state);
+        FileSystem::getInstance()->scanInputFile(getInputHandle(source).get(), m_scanBuffer, ScanBlockSize, [&](std::string_view lines) {
+            counter.add(lines, state);
+            });
+        counter.finish(state, result);
+    }
+
+    long long inputSize(Index slot) const {
+        if (isOnDisk(slot)) {
+            return FileSystem::getInstance()->getInputFileSize(getInputHandle(slot).get());
+        }
+        return static_cast<long long>(textOf(slot).size());
+    }
+
+    void joinOperands(Index slot, char delim, bool newLineAfterEach, std::string& result) {
+        auto operands = m_graph.getDependencies(slot);
+        for (size_t index = 0; index < operands.size(); index++) {
+            result += textOf(operands[index]);
+            if (index + 1 < operands.size()) {
+                result += delim;
+            }
+            if (newLineAfterEach) {
+                result += '\n';
+            }
+        }
+    }
+
+    ExternalSorter* pendingSorter(Index slot) noexcept {
+        if (m_graph.getType(slot) != NodeType::Sort) return nullptr;
+        auto& sorter = m_sorters[m_plan.getSteps()[slot].stateIndex];
+        return sorter.hasPendingRows() ? &sorter : nullptr;
+    }
+    bool hasPendingSort(Index slot) noexcept {
+        auto operands = m_graph.getDependencies(slot);
+        return std::any_of(operands.begin(), operands.end(), [this](Index operand) { return pendingSorter(operand) != nullptr; });
+    }
+
+    // Same text as renderOutput, with the rows of a spilled sort merged into the stream block by block
+    void writeOutput(Index slot, ResultSink& sink, std::string& block) {
+        auto& node = static_cast<const OutputNode&>(*m_graph.getNode(slot));
+        char delim = strcmp(node.getExtension(), ".csv") == 0 ? ',' : ' ';
+        auto output = sink.openOutput(node);
+        block.assign(node.getTitle());
+        block += '\n';
+        block += node.getDescription();
+        block += '\n';
+        auto operands = m_graph.getDependencies(slot);
+        for (size_t index = 0; index < operands.size(); index++) {
+            block += textOf(operands[index]);
+            if (auto sorter = pendingSorter(operands[index])) {
+                while (sorter->next(block, ScanBlockSize)) {
+                    output->append(block);
+                    block.clear();
+                }
+            }
+            if (index + 1 < operands.size()) {
+                block += delim;
+            }
+            block += '\n';
+        }
+        output->append(block);
+        output->close();
+        block.clear();
+    }
+
+    void renderOutput(Index slot, std::string& result) {
+        auto& node = static_cast<const OutputNode&>(*m_graph.getNode(slot));
+        char delim = strcmp(node.getExtension(), ".csv") == 0 ? ',' : ' ';
+        result.assign(node.getTitle());
+        result += '\n';
+        result += node.getDescription();
+        result += '\n';
+        joinOperands(slot, delim, true, result);
+    }
+};
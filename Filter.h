@@ -0,0 +1,165 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+
+#include "Csv.h"
+
+enum class FilterComparison {
+	Equal,
+	NotEqual,
+	Less,
+	LessEqual,
+	Greater,
+	GreaterEqual,
+	Prefix,
+	Contains
+};
+
+inline std::string filterComparisonToString(FilterComparison comparison) {
+	switch (comparison) {
+	case FilterComparison::Equal:
+		return "==";
+	case FilterComparison::NotEqual:
+		return "!=";
+	case FilterComparison::Less:
+		return "<";
+	case FilterComparison::LessEqual:
+		return "<=";
+	case FilterComparison::Greater:
+		return ">";
+	case FilterComparison::GreaterEqual:
+		return ">=";
+	case FilterComparison::Prefix:
+		return "starts with";
+	case FilterComparison::Contains:
+		return "contains";
+	default:
+		return "UnknownComparison";
+	}
+}
+
+/**
+ * Predicate on one column of CSV rows : "column <comparison> operand".
+ *
+ * Equal and NotEqual compare numerically when both sides are numbers and as text otherwise; the
+ * ordering comparisons only match numeric fields; Prefix and Contains compare text. A row that is
+ * too short to have the column reads the field as empty.
+ *
+ * Rows are tested while their block is scanned and only the matching ones are copied out. Text
+ * comparisons first look for the operand anywhere in the raw line, which rejects most rows without
+ * splitting them into fields.
+ */
+class RowFilter {
+public:
+	RowFilter(std::string column, FilterComparison comparison, std::string operand)
+		: m_column(std::move(column)), m_comparison(comparison), m_operand(std::move(operand)) {
+		m_numeric = Csv::parseNumber(m_operand, m_number);
+		bool textual = m_comparison == FilterComparison::Prefix || m_comparison == FilterComparison::Contains ||
+			(m_comparison == FilterComparison::Equal && !m_numeric);
+		// quoted fields double their quotes, so such operands are not found verbatim in the line
+		m_prefilter = textual && !m_operand.empty() && m_operand.find('"') == std::string::npos;
+	}
+
+	const std::string& getColumn() const noexcept {
+		return m_column;
+	}
+	FilterComparison getComparison() const noexcept {
+		return m_comparison;
+	}
+	const std::string& getOperand() const noexcept {
+		return m_operand;
+	}
+
+	/**
+	 * Resolves the column in the header line and copies the header to the result.
+	 * @return The index of the column, to pass to matches and appendMatches.
+	 * @throws InvalidInput if the column is not in the header.
+	 */
+	size_t begin(std::string_view headerLine, std::vector<std::string_view>& fields, std::string& result) const {
+		headerLine = Csv::trimLineEnd(headerLine);
+		Csv::splitFields(headerLine, fields);
+		size_t column = Csv::findColumn(fields, m_column);
+		result.append(headerLine.data(), headerLine.size());
+		result += '\n';
+		return column;
+	}
+
+	bool matches(std::string_view line, size_t column, std::vector<std::string_view>& fields) const {
+		if (m_prefilter && line.find(m_operand) == std::string_view::npos) {
+			return false;
+		}
+		Csv::splitFields(line, fields);
+		auto field = Csv::fieldAt(fields, column);
+		switch (m_comparison) {
+		case FilterComparison::Equal:
+			return equals(field);
+		case FilterComparison::NotEqual:
+			return !equals(field);
+		case FilterComparison::Less:
+		case FilterComparison::LessEqual:
+		case FilterComparison::Greater:
+		case FilterComparison::GreaterEqual:
+			return compares(field);
+		case FilterComparison::Prefix:
+			return field.substr(0, m_operand.size()) == m_operand;
+		case FilterComparison::Contains:
+			return field.find(m_operand) != std::string_view::npos;
+		default:
+			return false;
+		}
+	}
+
+	// Appends the matching lines of a run of complete lines
+	void appendMatches(std::string_view lines, size_t column, std::vector<std::string_view>& fields, std::string& result) const {
+		Csv::forEachLine(lines, [&](std::string_view line) {
+			if (matches(line, column, fields)) {
+				result.append(line.data(), line.size());
+				result += '\n';
+			}
+		});
+	}
+
+	// Filters CSV text held in memory, header line first
+	void apply(std::string_view text, std::vector<std::string_view>& fields, std::string& result) const {
+		std::string_view body;
+		auto header = Csv::splitHeader(text, body);
+		size_t column = begin(header, fields, result);
+		appendMatches(body, column, fields, result);
+	}
+
+private:
+	std::string m_column;
+	FilterComparison m_comparison;
+	std::string m_operand;
+	double m_number = 0.0;
+	bool m_numeric = false;
+	bool m_prefilter = false;
+
+	bool equals(std::string_view field) const noexcept {
+		double value;
+		if (m_numeric && Csv::parseNumber(field, value)) {
+			return value == m_number;
+		}
+		return field == m_operand;
+	}
+
+	bool compares(std::string_view field) const noexcept {
+		double value;
+		if (!m_numeric || !Csv::parseNumber(field, value)) {
+			return false;
+		}
+		switch (m_comparison) {
+		case FilterComparison::Less:
+			return value < m_number;
+		case FilterComparison::LessEqual:
+			return value <= m_number;
+		case FilterComparison::Greater:
+			return value > m_number;
+		case FilterComparison::GreaterEqual:
+			return value >= m_number;
+		default:
+			return false;
+		}
+	}
+};
@@ -12,8 +12,10 @@
 #include <ctime>
 
 #include "Node.h"
+#include "FlowGraph.h"
 #include "Operation.h"
 #include "filesystem.h"
+#include "InputPrefetcher.h"
 #include "InputHandler.h"
 
 class Flow : private NodeVisitor {
@@ -41,18 +43,63 @@ public:
         this->m_flowName = name;
     }
     void executeFlow() {
+        // the files are read while the interactive steps before their nodes run
+        InputPrefetcher prefetcher;
+        prefetcher.start(getNodesInExecutionOrder());
+        m_prefetcher = &prefetcher;
+        struct Detach {
+            InputPrefetcher*& prefetcher;
+            ~Detach() { prefetcher = nullptr; }
+        } detach{ m_prefetcher };
         while (!executionOrder.empty()) {
             NodeUid uid = executionOrder.front();
             nodes.at(uid)->acceptVisitor(*this);
             executionOrder.pop();
         }
       }
+      // Runs only the given node and its transitive dependencies, each of them once, in execution order
+      void evaluate(NodeUid uid) {
+          if (nodes.find(uid) == nodes.end()) {
+              std::stringstream ss;
+              ss << "Node with uid = " << uid << " is not part of the flow";
+              throw InvalidInput(ss.str().c_str());
+          }
+          std::unordered_set<NodeUid> needed;
+          std::vector<NodeUid> pending{ uid };
+          while (!pending.empty()) {
+              NodeUid current = pending.back();
+              pending.pop_back();
+              if (!needed.insert(current).second) continue;
+              auto iterator = nodes.find(current);
+              if (iterator == nodes.end()) {
+                  std::stringstream ss;
+                  ss << "Leaf Node with uid = " << current << " was not found \n";
+                  throw InvalidInput(ss.str().c_str());
+              }
+              for (auto dependency : iterator->second->getDependencies()) {
+                  pending.push_back(dependency);
+              }
+          }
+          std::queue tmp_q = executionOrder;
+          while (!tmp_q.empty()) {
+              if (needed.count(tmp_q.front()) != 0) {
+                  nodes.at(tmp_q.front())->acceptVisitor(*this);
+              }
+              tmp_q.pop();
+          }
+      }
       void addToFlow(Node* node) {
           if (nodes.find(node->getUid()) == nodes.end()) {
               nodes[node->getUid()] = node;
               executionOrder.push(node->getUid());
           }
       }
+      void reserve(size_t nodeCount) {
+          nodes.reserve(nodeCount);
+      }
+      size_t getNodeCount() const noexcept {
+          return nodes.size();
+      }
       void reset() {
           nodes.clear();
           while (!executionOrder.empty()) {
@@ -68,6 +115,20 @@ public:
           }
           return result;
       }
+      std::vector<Node*> getNodesInExecutionOrder() const {
+          std::vector<Node*> result;
+          result.reserve(executionOrder.size());
+          std::queue tmp_q = executionOrder;
+          while (!tmp_q.empty()) {
+              result.push_back(nodes.at(tmp_q.front()));
+              tmp_q.pop();
+          }
+          return result;
+      }
+      // Dense, CSR form of the flow used by prepared execution
+      FlowGraph finalize() const {
+          return FlowGraph(getNodesInExecutionOrder());
+      }
       void printFlow(){
           std::queue tmp_q = executionOrder; //copy the original queue to the temporary queue
           std::cout << "*********** Flow So Far ***********\n";
@@ -87,6 +148,8 @@ private:
     std::string m_flowName;
     std::string m_timeStamp;
     InputHandler handler;
+    // set while executeFlow runs
+    InputPrefetcher* m_prefetcher = nullptr;
     void restartDecision(std::function<void()> onSkip, std::function<void()> onRestart) {
         auto picked = handler.pickOption("Do you want to restart", { Option("Yes" , "Y" , "Y") , Option("No" , "N" , "N")});
         if (picked.has_value()) {
@@ -143,7 +206,10 @@ private:
             if (fileHandle == nullptr) {
                 throw InvalidHandle((std::string("Failed to get a file handle for file ") + std::string(node.getFileName()) + std::string(node.getExtension())).c_str());
             }
-            auto fileContent = fileSystem->readFromInputFile(fileHandle.get());
+            std::string fileContent;
+            if (m_prefetcher == nullptr || !m_prefetcher->take(node, fileContent)) {
+                fileContent = fileSystem->readFromInputFile(fileHandle.get());
+            }
             node.setBuffer(std::move(fileContent));
         }
         catch (const InvalidHandle& e) {
@@ -222,16 +288,16 @@ private:
                 typeSet.insert(iterator->second->getType());
                
                 //check to see if the node implements this interface
-                auto storable = dynamic_cast<Storable<float>*>(iterator->second);
+                auto storable = asNumberStorable(iterator->second);
                 if (storable != nullptr) return float(storable->getBuffer());
                 else return 0.0f;
                 });
 
 
             //check to see if there are more types than supported
-            if (typeSet.count(NodeType::NumberInput) + typeSet.count(NodeType::FloatCalculus) != typeSet.size()) {
+            if (std::any_of(typeSet.begin(), typeSet.end(), [](NodeType type) { return !isNumericNodeType(type); })) {
                 std::stringstream ss;
-                ss << "Operation cannot be performed! The nodes must be either of type NumberInput and / or FloatCalculus" << "\n";
+                ss << "Operation cannot be performed! The nodes must be either of type NumberInput, FloatCalculus and / or WindowAggregate" << "\n";
                 ss << "Provided types are : ";
                 for (auto& type : typeSet) {
                     ss << nodeTypeToString(type) << ",";
@@ -241,7 +307,7 @@ private:
 
 
 
-            auto result = performNumberOperation(foundNodes, node.getOperationType());
+            auto result = performNumberOperation(foundNodes, node.getOperationType(), node.getSummation());
             node.setBuffer(result);
 
 
@@ -282,7 +348,7 @@ private:
                     throw InvalidInput(ss.str().c_str());
                 }
                 //check to see it if implements the interface
-                auto displayable = dynamic_cast<Displayable*>(iterator->second);
+                auto displayable = asDisplayable(iterator->second);
                 if (displayable != nullptr) {
                     return displayable->getContent();
                 }
@@ -306,9 +372,7 @@ private:
         }
     }
     FileExtension translateExtension(const char* extension) {
-        if (strcmp(extension, ".csv") == 0) return CSV;
-        else if (strcmp(extension, ".txt") == 0) return TXT;
-        throw InvalidHandle("The extension was not recognized");
+        return FileHandle::parseExtension(extension);
     }
     void visit(OutputNode& node) override {
         try
@@ -339,7 +403,7 @@ private:
                     throw InvalidInput(ss.str().c_str());
                 }
                 //check to see it if implements the interface
-                auto displayable = dynamic_cast<Displayable*>(iterator->second);
+                auto displayable = asDisplayable(iterator->second);
                 if (displayable != nullptr) {
                     return displayable->getContent();
                 }
@@ -414,7 +478,7 @@ private:
                 throw InvalidInput(ss.str().c_str());
             }
             //check to see it if implements the interface
-            auto displayable = dynamic_cast<Displayable*>(iterator->second);
+            auto displayable = asDisplayable(iterator->second);
             if (displayable != nullptr) {
                 return displayable->getContent();
             }
@@ -436,12 +500,12 @@ private:
 
     }
 
-    float performNumberOperation(const std::vector<float>& operands, OperationType operation) {
+    float performNumberOperation(const std::vector<float>& operands, OperationType operation, SummationMode summation = SummationMode::Plain) {
 
 
         auto operationImpl = getNumberOperation(operation);
 
-        auto result = Calculation<float>().execute(operands, operationImpl.get());
+        auto result = Calculation<float>(Calculation<float>::summationFor(operation, summation)).execute(operands, operationImpl.get());
 
         return *result.release();
     }
@@ -496,6 +560,315 @@ private:
             throw std::invalid_argument("Unsupported operation type");
         }
     }
+    void visit(WindowAggregateNode& node) override {
+        try {
+            auto skip = handler.pickOption("Do you want to skip this step", { Option("Yes" , "Yes" , "Yes") , Option("No" , "No" , "No") });
+            if (skip.has_value()) {
+                if (skip->m_key == "Yes") return;
+            }
+            double now = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+            // a text dependency holds the whole stream, so the window starts over
+            for (auto uid : node.getDependencies()) {
+                auto iterator = nodes.find(uid);
+                if (iterator != nodes.end() && !isNumericNodeType(iterator->second->getType())) {
+                    node.getWindow().clear();
+                    break;
+                }
+            }
+            for (auto uid : node.getDependencies()) {
+                auto iterator = nodes.find(uid);
+                if (iterator == nodes.end()) {
+                    std::stringstream ss;
+                    ss << "Leaf Node with uid = " << uid << " was not found \n";
+                    throw InvalidInput(ss.str().c_str());
+                }
+                if (isNumericNodeType(iterator->second->getType())) {
+                    auto storable = asNumberStorable(iterator->second);
+                    if (storable != nullptr) node.getWindow().push(storable->getBuffer(), now);
+                }
+                else {
+                    auto displayable = asDisplayable(iterator->second);
+                    if (displayable != nullptr) node.getWindow().pushText(displayable->getContent(), now);
+                }
+            }
+            node.setBuffer(float(node.getWindow().get(node.getStatistic())));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            restartDecision([&node]() {
+                }, [this, &node]() {
+                    this->visit(node);
+                });
+        }
+    }
+    void visit(GroupByNode& node) override {
+        try {
+            auto skip = handler.pickOption("Do you want to skip this step", { Option("Yes" , "Yes" , "Yes") , Option("No" , "No" , "No") });
+            if (skip.has_value()) {
+                if (skip->m_key == "Yes") {
+                    node.setBuffer(std::string());
+                    return;
+                }
+            }
+            auto result = std::string();
+            node.getAggregator().aggregate(getDependencyContent(node.getDependencies().front()), result);
+            node.setBuffer(std::move(result));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            restartDecision([&node]() {
+                node.setBuffer(std::string());
+                }, [this, &node]() {
+                    this->visit(node);
+                });
+        }
+    }
+    void visit(HashJoinNode& node) override {
+        try {
+            auto skip = handler.pickOption("Do you want to skip this step", { Option("Yes" , "Yes" , "Yes") , Option("No" , "No" , "No") });
+            if (skip.has_value()) {
+                if (skip->m_key == "Yes") {
+                    node.setBuffer(std::string());
+                    return;
+                }
+            }
+            if (node.getDependencies().size() != 2) {
+                throw InvalidInput("A Hash Join node needs a left and a right input");
+            }
+            auto left = getDependencyContent(node.getDependencies()[0]);
+            auto right = getDependencyContent(node.getDependencies()[1]);
+            bool buildIsLeft = left.size() < right.size();
+
+            auto joiner = node.createJoiner();
+            auto result = std::string();
+            joiner.build(buildIsLeft ? left : right, buildIsLeft);
+            joiner.probeAll(buildIsLeft ? right : left, result);
+            joiner.finish(result);
+            node.setBuffer(std::move(result));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            restartDecision([&node]() {
+                node.setBuffer(std::string());
+                }, [this, &node]() {
+                    this->visit(node);
+                });
+        }
+    }
+    void visit(FilterNode& node) override {
+        try {
+            auto skip = handler.pickOption("Do you want to skip this step", { Option("Yes" , "Yes" , "Yes") , Option("No" , "No" , "No") });
+            if (skip.has_value()) {
+                if (skip->m_key == "Yes") {
+                    node.setBuffer(std::string());
+                    return;
+                }
+            }
+            std::vector<std::string_view> fields;
+            auto result = std::string();
+            node.getFilter().apply(getDependencyContent(node.getDependencies().front()), fields, result);
+            node.setBuffer(std::move(result));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            restartDecision([&node]() {
+                node.setBuffer(std::string());
+                }, [this, &node]() {
+                    this->visit(node);
+                });
+        }
+    }
+    void visit(SortNode& node) override {
+        try {
+            auto skip = handler.pickOption("Do you want to skip this step", { Option("Yes" , "Yes" , "Yes") , Option("No" , "No" , "No") });
+            if (skip.has_value()) {
+                if (skip->m_key == "Yes") {
+                    node.setBuffer(std::string());
+                    return;
+                }
+            }
+            auto result = std::string();
+            node.createSorter().sort(getDependencyContent(node.getDependencies().front()), result);
+            node.setBuffer(std::move(result));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            restartDecision([&node]() {
+                node.setBuffer(std::string());
+                }, [this, &node]() {
+                    this->visit(node);
+                });
+        }
+    }
+    void visit(SearchNode& node) override {
+        try {
+            auto skip = handler.pickOption("Do you want to skip this step", { Option("Yes" , "Yes" , "Yes") , Option("No" , "No" , "No") });
+            if (skip.has_value()) {
+                if (skip->m_key == "Yes") {
+                    node.setBuffer(std::string());
+                    return;
+                }
+            }
+            SearchScan scan;
+            auto result = std::string();
+            node.getSearcher().searchAll(getDependencyContent(node.getDependencies().front()), scan, result);
+            node.setBuffer(std::move(result));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            restartDecision([&node]() {
+                node.setBuffer(std::string());
+                }, [this, &node]() {
+                    this->visit(node);
+                });
+        }
+    }
+    void visit(TokenizeNode& node) override {
+        try {
+            auto skip = handler.pickOption("Do you want to skip this step", { Option("Yes" , "Yes" , "Yes") , Option("No" , "No" , "No") });
+            if (skip.has_value()) {
+                if (skip->m_key == "Yes") {
+                    node.setBuffer(std::string());
+                    return;
+                }
+            }
+            auto result = std::string();
+            node.getCounter().count(getDependencyContent(node.getDependencies().front()), result);
+            node.setBuffer(std::move(result));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            restartDecision([&node]() {
+                node.setBuffer(std::string());
+                }, [this, &node]() {
+                    this->visit(node);
+                });
+        }
+    }
+    void visit(SketchNode& node) override {
+        try {
+            auto skip = handler.pickOption("Do you want to skip this step", { Option("Yes" , "Yes" , "Yes") , Option("No" , "No" , "No") });
+            if (skip.has_value()) {
+                if (skip->m_key == "Yes") {
+                    node.setBuffer(std::string());
+                    return;
+                }
+            }
+            auto state = node.getCounter().createState();
+            auto result = std::string();
+            node.getCounter().sketchAll(getDependencyContent(node.getDependencies().front()), state, result);
+            node.setBuffer(std::move(result));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            restartDecision([&node]() {
+                node.setBuffer(std::string());
+                }, [this, &node]() {
+                    this->visit(node);
+                });
+        }
+    }
+    void visit(VectorNode& node) override {
+        try {
+            auto skip = handler.pickOption("Do you want to skip this step", { Option("Yes" , "Yes" , "Yes") , Option("No" , "No" , "No") });
+            if (skip.has_value()) {
+                if (skip->m_key == "Yes") {
+                    node.setBuffer(NumberVector());
+                    return;
+                }
+            }
+            auto values = NumberVector();
+            parseNumbers(getDependencyContent(node.getDependencies().front()), node.getColumn(), values);
+            node.setBuffer(std::move(values));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            restartDecision([&node]() {
+                node.setBuffer(NumberVector());
+                }, [this, &node]() {
+                    this->visit(node);
+                });
+        }
+    }
+    void visit(VectorCalculusNode& node) override {
+        try {
+            auto skip = handler.pickOption("Do you want to skip this step", { Option("Yes" , "Yes" , "Yes") , Option("No" , "No" , "No") });
+            if (skip.has_value()) {
+                if (skip->m_key == "Yes") {
+                    node.setBuffer(NumberVector());
+                    return;
+                }
+            }
+            auto operands = getVectorOperands(node.getDependencies());
+            auto result = NumberVector();
+            VectorCalculation().executeInto(operands.data(), operands.size(), node.getOperationType(), result);
+            node.setBuffer(std::move(result));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            restartDecision([&node]() {
+                node.setBuffer(NumberVector());
+                }, [this, &node]() {
+                    this->visit(node);
+                });
+        }
+    }
+    void visit(VectorReduceNode& node) override {
+        try {
+            auto skip = handler.pickOption("Do you want to skip this step", { Option("Yes" , "Yes" , "Yes") , Option("No" , "No" , "No") });
+            if (skip.has_value()) {
+                if (skip->m_key == "Yes") {
+                    node.setBuffer(0.0f);
+                    return;
+                }
+            }
+            auto operands = getVectorOperands(node.getDependencies());
+            node.setBuffer(float(VectorCalculation().reduce(operands.data(), operands.size(), node.getReduction())));
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << "\n";
+            restartDecision([&node]() {
+                node.setBuffer(0.0f);
+                }, [this, &node]() {
+                    this->visit(node);
+                });
+        }
+    }
+    // Vector nodes are read in place, numeric nodes as numbers broadcast to every element
+    std::vector<VectorOperand> getVectorOperands(const std::vector<NodeUid>& dependencies) {
+        std::vector<VectorOperand> operands;
+        for (auto uid : dependencies) {
+            auto iterator = nodes.find(uid);
+            if (iterator == nodes.end()) {
+                std::stringstream ss;
+                ss << "Leaf Node with uid = " << uid << " was not found \n";
+                throw InvalidInput(ss.str().c_str());
+            }
+            auto type = iterator->second->getType();
+            if (isVectorNodeType(type)) {
+                operands.push_back(VectorOperand::ofVector(asVectorStorable(iterator->second)->getBuffer()));
+            }
+            else if (isNumericNodeType(type)) {
+                operands.push_back(VectorOperand::ofScalar(asNumberStorable(iterator->second)->getBuffer()));
+            }
+            else {
+                std::stringstream ss;
+                ss << "Operation cannot be performed! The nodes must be vectors or numbers, provided type is : " << nodeTypeToString(type);
+                throw InvalidInput(ss.str().c_str());
+            }
+        }
+        return operands;
+    }
+    std::string getDependencyContent(NodeUid uid) {
+        auto iterator = nodes.find(uid);
+        if (iterator == nodes.end()) {
+            std::stringstream ss;
+            ss << "Leaf Node with uid = " << uid << " was not found \n";
+            throw InvalidInput(ss.str().c_str());
+        }
+        auto displayable = asDisplayable(iterator->second);
+        return displayable != nullptr ? displayable->getContent() : std::string();
+    }
     void visit(TextNode& node) {
      //   std::cout << node.getContent();
     }
@@ -6,7 +6,7 @@ void CreateNewFlowState::doWork(FlowController& controller) {
     bool isRunning = true;
     
 
-    while (isRunning) {
+    while (isRunning && !exiting) {
         //method to clear the console screen
         system("CLS");
         flow.printFlow();
@@ -15,7 +15,17 @@ void CreateNewFlowState::doWork(FlowController& controller) {
                 Option("NumberInput Node", "3", "3"), Option("Float Calculus Node", "4", "4"),
                 Option("String Calculus Node", "5", "5"), Option("Display Node", "6", "6"),
                 Option("File Input Node", "7", "7"), Option("Output Node", "8", "8"),
-                Option("End Node", "9", "9") });
+                Option("End Node", "9", "9"), Option("Window Aggregate Node", "10", "10"),
+                Option("Group By Node", "11", "11"),
+                Option("Hash Join Node", "12", "12"),
+                Option("Filter Node", "13", "13"),
+                Option("Sort Node", "14", "14"),
+                Option("Search Node", "15", "15"),
+                Option("Tokenize Node", "16", "16"),
+                Option("Sketch Node", "17", "17"),
+                Option("Vector Node", "18", "18"),
+                Option("Vector Calculus Node", "19", "19"),
+                Option("Vector Reduce Node", "20", "20") });
 
         if (!picked.has_value()) {
             restartDecision(controller);
@@ -64,6 +74,50 @@ void CreateNewFlowState::doWork(FlowController& controller) {
             controller.addNewFlow(std::move(flow));
             onExit(controller);
         }
+        else if (picked->m_key == "10") {
+            std::cout << "\nYou have picked Window Aggregate Node\n";
+            addWindowAggregateNode(controller);
+        }
+        else if (picked->m_key == "11") {
+            std::cout << "\nYou have picked Group By Node\n";
+            addGroupByNode(controller);
+        }
+        else if (picked->m_key == "12") {
+            std::cout << "\nYou have picked Hash Join Node\n";
+            addHashJoinNode(controller);
+        }
+        else if (picked->m_key == "13") {
+            std::cout << "\nYou have picked Filter Node\n";
+            addFilterNode(controller);
+        }
+        else if (picked->m_key == "14") {
+            std::cout << "\nYou have picked Sort Node\n";
+            addSortNode(controller);
+        }
+        else if (picked->m_key == "15") {
+            std::cout << "\nYou have picked Search Node\n";
+            addSearchNode(controller);
+        }
+        else if (picked->m_key == "16") {
+            std::cout << "\nYou have picked Tokenize Node\n";
+            addTokenizeNode(controller);
+        }
+        else if (picked->m_key == "17") {
+            std::cout << "\nYou have picked Sketch Node\n";
+            addSketchNode(controller);
+        }
+        else if (picked->m_key == "18") {
+            std::cout << "\nYou have picked Vector Node\n";
+            addVectorNode(controller);
+        }
+        else if (picked->m_key == "19") {
+            std::cout << "\nYou have picked Vector Calculus Node\n";
+            addVectorCalculusNode(controller);
+        }
+        else if (picked->m_key == "20") {
+            std::cout << "\nYou have picked Vector Reduce Node\n";
+            addVectorReduceNode(controller);
+        }
         else {
             
             restartDecision(controller);
@@ -90,15 +144,23 @@ void CreateNewFlowState::addFloatCalculusNode(FlowController& controller)
 {
     
     auto dependencies = buildDependencies([](const auto* node) {
-        return node->getType() == NodeType::FloatCalculus || node->getType() == NodeType::NumberInput;
+        return isNumericNodeType(node->getType());
         });
 
     if (dependencies.size() == 0) {
         return;
     }
     OperationType type = pickOperation().value_or(OperationType::Add);
+    auto summation = SummationMode::Plain;
+    if (type == OperationType::Add) {
+        auto picked = handler.pickOption("Pick the summation",
+            { Option("Plain", "Plain", "Plain"), Option("Compensated, slower but more accurate", "Compensated", "Compensated") });
+        if (picked.has_value() && picked->m_key == "Compensated") {
+            summation = SummationMode::Compensated;
+        }
+    }
    
-    auto calculusNode =new  FloatCalculusNode(++counter, type, std::move(dependencies));
+    auto calculusNode =new  FloatCalculusNode(++counter, type, std::move(dependencies), summation);
     flow.addToFlow(calculusNode);
     std::cout << "Float Calculus node Added\n";
 }
@@ -309,6 +371,263 @@ void CreateNewFlowState::addOutputNode()
     std::cout << "Output Node Added\n";
 }
 
+void CreateNewFlowState::addWindowAggregateNode(FlowController& controller)
+{
+    auto dependencies = buildDependencies([](const auto* node) {
+        return isNumericNodeType(node->getType()) || node->getType() == NodeType::TextInput ||
+            node->getType() == NodeType::FileInput || node->getType() == NodeType::StringCalculus;
+        });
+    if (dependencies.empty()) {
+        return;
+    }
+    auto picked = handler.pickOption("Pick the statistic",
+        { Option("Sum", "Sum", "Sum"), Option("Mean", "Mean", "Mean"), Option("Min", "Min", "Min"),
+            Option("Max", "Max", "Max"), Option("Count", "Count", "Count") });
+    WindowStatistic statistic = WindowStatistic::Sum;
+    if (picked.has_value()) {
+        if (picked->m_key == "Mean") statistic = WindowStatistic::Mean;
+        else if (picked->m_key == "Min") statistic = WindowStatistic::Min;
+        else if (picked->m_key == "Max") statistic = WindowStatistic::Max;
+        else if (picked->m_key == "Count") statistic = WindowStatistic::Count;
+    }
+    auto windowSize = handler.readFloat("Enter the number of values in the window (0 for no limit) : ").value_or(0.0f);
+    auto windowSeconds = handler.readFloat("Enter the duration of the window in seconds (0 for no limit) : ").value_or(0.0f);
+
+    auto windowNode = new WindowAggregateNode(++counter, statistic, size_t(std::max(windowSize, 0.0f)), std::max(windowSeconds, 0.0f), std::move(dependencies));
+    flow.addToFlow(windowNode);
+    std::cout << "Window Aggregate node Added\n";
+}
+
+// Splits "a, b,c" into its trimmed, non empty parts
+static std::vector<std::string> splitColumnList(const std::string& list) {
+    std::vector<std::string> columns;
+    std::stringstream ss(list);
+    std::string column;
+    while (std::getline(ss, column, ',')) {
+        auto first = column.find_first_not_of(" \t");
+        if (first == std::string::npos) continue;
+        columns.push_back(column.substr(first, column.find_last_not_of(" \t") - first + 1));
+    }
+    return columns;
+}
+
+void CreateNewFlowState::addGroupByNode(FlowController& controller)
+{
+    auto dependencies = buildDependencies([](const auto* node) {
+        return isTextNodeType(node->getType());
+        });
+    if (dependencies.size() != 1) {
+        std::cout << "\nA Group By node needs exactly one CSV input\n";
+        return;
+    }
+    auto keyColumn = handler.readString("Enter the key column : ");
+    auto valueColumns = handler.readString("Enter the value columns, separated by commas : ");
+    if (!keyColumn.has_value() || !valueColumns.has_value()) {
+        handleInvalidInput(controller);
+        return;
+    }
+    auto groupByNode = new GroupByNode(++counter, std::move(*keyColumn), splitColumnList(*valueColumns), std::move(dependencies));
+    flow.addToFlow(groupByNode);
+    std::cout << "Group By node Added\n";
+}
+
+void CreateNewFlowState::addHashJoinNode(FlowController& controller)
+{
+    std::cout << "Pick the left input first, then the right input\n";
+    auto dependencies = buildDependencies([](const auto* node) {
+        return isTextNodeType(node->getType());
+        });
+    if (dependencies.size() != 2) {
+        std::cout << "\nA Hash Join node needs exactly two CSV inputs\n";
+        return;
+    }
+    auto picked = handler.pickOption("Pick the join", { Option("Inner", "Inner", "Inner"), Option("Left", "Left", "Left") });
+    auto leftKey = handler.readString("Enter the key column of the left input : ");
+    auto rightKey = handler.readString("Enter the key column of the right input : ");
+    if (!picked.has_value() || !leftKey.has_value() || !rightKey.has_value()) {
+        handleInvalidInput(controller);
+        return;
+    }
+    auto kind = picked->m_key == "Left" ? JoinKind::Left : JoinKind::Inner;
+    auto hashJoinNode = new HashJoinNode(++counter, kind, std::move(*leftKey), std::move(*rightKey), std::move(dependencies));
+    flow.addToFlow(hashJoinNode);
+    std::cout << "Hash Join node Added\n";
+}
+
+void CreateNewFlowState::addFilterNode(FlowController& controller)
+{
+    auto dependencies = buildDependencies([](const auto* node) {
+        return isTextNodeType(node->getType());
+        });
+    if (dependencies.size() != 1) {
+        std::cout << "\nA Filter node needs exactly one CSV input\n";
+        return;
+    }
+    auto column = handler.readString("Enter the column to test : ");
+    auto picked = handler.pickOption("Pick the comparison",
+        { Option("==", "a", "a"), Option("!=", "b", "b"), Option("<", "c", "c"), Option("<=", "d", "d"),
+          Option(">", "e", "e"), Option(">=", "f", "f"), Option("starts with", "g", "g"), Option("contains", "h", "h") });
+    auto operand = handler.readString("Enter the value to compare with : ");
+    if (!column.has_value() || !picked.has_value() || !operand.has_value()) {
+        handleInvalidInput(controller);
+        return;
+    }
+    auto comparison = static_cast<FilterComparison>(picked->m_key[0] - 'a');
+    auto filterNode = new FilterNode(++counter, std::move(*column), comparison, std::move(*operand), std::move(dependencies));
+    flow.addToFlow(filterNode);
+    std::cout << "Filter node Added\n";
+}
+
+void CreateNewFlowState::addSortNode(FlowController& controller)
+{
+    auto dependencies = buildDependencies([](const auto* node) {
+        return isTextNodeType(node->getType());
+        });
+    if (dependencies.size() != 1) {
+        std::cout << "\nA Sort node needs exactly one CSV input\n";
+        return;
+    }
+    auto keys = handler.readString("Enter the key columns, separated by commas, '-' before a column sorts it descending : ");
+    if (!keys.has_value() || parseSortKeys(*keys).empty()) {
+        handleInvalidInput(controller);
+        return;
+    }
+    auto sortNode = new SortNode(++counter, parseSortKeys(*keys), ExternalSorter::DefaultMemoryBudget, std::move(dependencies));
+    flow.addToFlow(sortNode);
+    std::cout << "Sort node Added\n";
+}
+
+void CreateNewFlowState::addSearchNode(FlowController& controller)
+{
+    auto dependencies = buildDependencies([](const auto* node) {
+        return isTextNodeType(node->getType());
+        });
+    if (dependencies.size() != 1) {
+        std::cout << "\nA Search node needs exactly one text input\n";
+        return;
+    }
+    auto patterns = handler.readString("Enter the patterns, separated by commas : ");
+    auto picked = handler.pickOption("Pick the result",
+        { Option("Match counts", "Counts", "Counts"), Option("Match offsets", "Offsets", "Offsets"), Option("Matching lines", "Lines", "Lines") });
+    if (!patterns.has_value() || !picked.has_value()) {
+        handleInvalidInput(controller);
+        return;
+    }
+    auto output = picked->m_key == "Offsets" ? SearchOutput::Offsets : (picked->m_key == "Lines" ? SearchOutput::Lines : SearchOutput::Counts);
+    try {
+        auto searchNode = new SearchNode(++counter, splitColumnList(*patterns), output, std::move(dependencies));
+        flow.addToFlow(searchNode);
+        std::cout << "Search node Added\n";
+    }
+    catch (const InvalidInput& e) {
+        std::cout << e.what() << "\n";
+        handleInvalidInput(controller);
+    }
+}
+
+void CreateNewFlowState::addTokenizeNode(FlowController& controller)
+{
+    auto dependencies = buildDependencies([](const auto* node) {
+        return isTextNodeType(node->getType());
+        });
+    if (dependencies.size() != 1) {
+        std::cout << "\nA Tokenize node needs exactly one text input\n";
+        return;
+    }
+    auto delimiters = handler.readString("Enter the delimiters besides whitespace, or nothing : ");
+    auto picked = handler.pickOption("Pick the result",
+        { Option("Token count", "Count", "Count"), Option("Token frequencies", "Frequencies", "Frequencies"), Option("Tokens", "Tokens", "Tokens") });
+    if (!picked.has_value()) {
+        handleInvalidInput(controller);
+        return;
+    }
+    auto output = picked->m_key == "Count" ? TokenOutput::Count : (picked->m_key == "Tokens" ? TokenOutput::Tokens : TokenOutput::Frequencies);
+    auto tokenizeNode = new TokenizeNode(++counter, delimiters.value_or(std::string()), output, std::move(dependencies));
+    flow.addToFlow(tokenizeNode);
+    std::cout << "Tokenize node Added\n";
+}
+
+void CreateNewFlowState::addSketchNode(FlowController& controller)
+{
+    auto dependencies = buildDependencies([](const auto* node) {
+        return isTextNodeType(node->getType());
+        });
+    if (dependencies.size() != 1) {
+        std::cout << "\nA Sketch node needs exactly one text input\n";
+        return;
+    }
+    auto picked = handler.pickOption("Pick the sketch",
+        { Option("Distinct count", "Distinct", "Distinct"), Option("Heavy hitters", "Hitters", "Hitters") });
+    auto column = handler.readString("Enter the CSV column, or nothing to use the words of the text : ");
+    if (!picked.has_value()) {
+        handleInvalidInput(controller);
+        return;
+    }
+    size_t k = 10;
+    if (picked->m_key == "Hitters") {
+        auto count = handler.readFloat("How many items do you want : ");
+        if (count.has_value() && *count >= 1.0f) {
+            k = static_cast<size_t>(*count);
+        }
+    }
+    auto kind = picked->m_key == "Hitters" ? SketchKind::HeavyHitters : SketchKind::DistinctCount;
+    auto sketchNode = new SketchNode(++counter, kind, column.value_or(std::string()), k, std::move(dependencies));
+    flow.addToFlow(sketchNode);
+    std::cout << "Sketch node Added\n";
+}
+
+void CreateNewFlowState::addVectorNode(FlowController& controller)
+{
+    auto dependencies = buildDependencies([](const auto* node) {
+        return isTextNodeType(node->getType());
+        });
+    if (dependencies.size() != 1) {
+        std::cout << "\nA Vector node needs exactly one text input\n";
+        return;
+    }
+    auto column = handler.readString("Enter the CSV column, or nothing to use every number of the text : ");
+    auto vectorNode = new VectorNode(++counter, column.value_or(std::string()), std::move(dependencies));
+    flow.addToFlow(vectorNode);
+    std::cout << "Vector node Added\n";
+}
+
+void CreateNewFlowState::addVectorCalculusNode(FlowController& controller)
+{
+    auto dependencies = buildDependencies([](const auto* node) {
+        return isVectorNodeType(node->getType()) || isNumericNodeType(node->getType());
+        });
+    if (dependencies.size() == 0) {
+        return;
+    }
+    OperationType type = pickOperation().value_or(OperationType::Add);
+    auto calculusNode = new VectorCalculusNode(++counter, type, std::move(dependencies));
+    flow.addToFlow(calculusNode);
+    std::cout << "Vector Calculus node Added\n";
+}
+
+void CreateNewFlowState::addVectorReduceNode(FlowController& controller)
+{
+    auto picked = handler.pickOption("Pick the reduction",
+        { Option("Sum", "Sum", "Sum"), Option("Min", "Min", "Min"), Option("Max", "Max", "Max"),
+          Option("Mean", "Mean", "Mean"), Option("Dot product of two vectors", "Dot", "Dot") });
+    if (!picked.has_value()) {
+        handleInvalidInput(controller);
+        return;
+    }
+    auto reduction = picked->m_key == "Min" ? VectorReduction::Min : picked->m_key == "Max" ? VectorReduction::Max
+        : picked->m_key == "Mean" ? VectorReduction::Mean : picked->m_key == "Dot" ? VectorReduction::Dot : VectorReduction::Sum;
+    auto dependencies = buildDependencies([](const auto* node) {
+        return isVectorNodeType(node->getType());
+        });
+    if (dependencies.size() != (reduction == VectorReduction::Dot ? 2 : 1)) {
+        std::cout << "\nA " << vectorReductionToString(reduction) << " reduction needs exactly " << (reduction == VectorReduction::Dot ? "two vectors" : "one vector") << "\n";
+        return;
+    }
+    auto reduceNode = new VectorReduceNode(++counter, reduction, std::move(dependencies));
+    flow.addToFlow(reduceNode);
+    std::cout << "Vector Reduce node Added\n";
+}
+
 void CreateNewFlowState::addEndNode()
 {
     EndNode* node = new EndNode(++counter);
@@ -334,7 +653,13 @@ void StartState::doWork(FlowController& controller) {
     system("CLS");
     std::cout << "Welcome to Flow Builder 1.1.0\n";
     auto picked = handler.pickOption("What do you want to do?",
-        { Option("Run Existing Flow", "a", "a"), Option("Create New Flow", "b", "b")  , Option("Delete Flow", "c", "c") });
+        { Option("Run Existing Flow", "a", "a"), Option("Create New Flow", "b", "b")  , Option("Delete Flow", "c", "c"),
+          Option("Queue a Flow Run in the background", "e", "e")
+#ifdef __linux__
+        , Option("Serve Flows over a local socket", "d", "d")
+        , Option("Watch the input files and re-run the Flows on changes", "f", "f")
+#endif
+        });
 
     if (picked.has_value()) {
         if (picked->m_key == "a") {
@@ -353,6 +678,17 @@ void StartState::doWork(FlowController& controller) {
             controller.setState(deleteFlow);
 
         }
+        else if (picked->m_key == "e") {
+            controller.setState(new QueueFlowState());
+        }
+#ifdef __linux__
+        else if (picked->m_key == "d") {
+            controller.setState(new ServeFlowsState());
+        }
+        else if (picked->m_key == "f") {
+            controller.setState(new WatchFlowsState());
+        }
+#endif
         else {
             goto decision;
         }
@@ -378,8 +714,113 @@ FlowController::FlowController()
 }
 
 void FlowController::start() {
-    FlowState* state = new StartState();
-    state->doWork(*this);
+    setState(new StartState());
+    while (m_next != nullptr) {
+        std::unique_ptr<FlowState> state(m_next);
+        m_next = nullptr;
+        state->onEnter(*this);
+        state->doWork(*this);
+        state->onExit(*this);
+    }
+    auto metrics = m_scheduler.getMetrics();
+    if (metrics.queued + metrics.running != 0) {
+        std::cout << "\nWaiting for " << metrics.queued + metrics.running << " queued runs to finish\n";
+        m_scheduler.waitIdle();
+    }
+}
+
+void FlowController::submitFlow(const Flow& flow, const JobOptions& options, BatchRecord&& inputs)
+{
+    // bound and loaded here, so the job never reads the input files on a worker
+    struct QueuedRun {
+        Flow flow;
+        ExecutionPlan plan;
+        ExecutionContext context;
+
+        explicit QueuedRun(const Flow& source) : flow(source), plan(flow), context(plan) {}
+    };
+    auto run = std::make_shared<QueuedRun>(flow);
+    for (const auto& text : inputs.texts) {
+        run->context.bindText(text.first, text.second);
+    }
+    for (const auto& number : inputs.numbers) {
+        run->context.bindDouble(number.first, number.second);
+    }
+    run->context.loadInputs();
+
+    m_scheduler.submit(options, [this, run]() {
+        try {
+            SerializedResultSink sink(m_console, m_consoleMutex);
+            run->context.run(sink);
+            std::lock_guard<std::mutex> lock(m_consoleMutex);
+            m_console.flush();
+        }
+        catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(m_consoleMutex);
+            std::cout << "\nThe queued run of " << run->flow.getName() << " failed : " << e.what() << "\n";
+            throw;
+        }
+    });
+}
+
+void QueueFlowState::doWork(FlowController& controller)
+{
+    auto flows = controller.getCurrentFlows();
+    if (flows.empty()) {
+        std::cout << "There are no flows!";
+        return;
+    }
+    std::vector<Option> options;
+    for (size_t index = 0; index < flows.size(); index++) {
+        std::stringstream ss;
+        ss << index + 1 << "." << " " << flows.at(index).getName() << " " << flows.at(index).getTimeOfCreation();
+        options.emplace_back(ss.str(), std::to_string(index + 1), std::to_string(index + 1));
+    }
+    auto result = handler.pickOption("Pick the Flow to queue ", options);
+    if (!result.has_value()) {
+        return;
+    }
+    auto& flow = flows.at(std::atoi(result->m_key.c_str()) - 1);
+
+    JobOptions jobOptions;
+    auto priority = handler.pickOption("Pick the priority",
+        { Option("Interactive", "a", "a"), Option("Normal", "b", "b"), Option("Batch", "c", "c") });
+    if (priority.has_value()) {
+        jobOptions.priority = priority->m_key == "a" ? JobPriority::Interactive : priority->m_key == "c" ? JobPriority::Batch : JobPriority::Normal;
+    }
+    auto tenant = handler.readString("Enter the tenant, or nothing for default : ");
+    if (tenant.has_value() && !tenant->empty()) {
+        jobOptions.tenant = *tenant;
+    }
+    auto deadline = handler.readFloat("Seconds before the run must start, 0 for no deadline : ");
+    if (deadline.has_value() && *deadline > 0.0f) {
+        jobOptions.deadline = std::chrono::milliseconds(static_cast<int64_t>(*deadline * 1000.0f));
+    }
+
+    // inputs are read now, the run itself never prompts
+    BatchRecord inputs;
+    for (auto node : flow.filterNodesByType([](const Node* node) { return node->getType() == NodeType::TextInput; })) {
+        auto text = handler.readString(static_cast<TextInputNode*>(node)->getPrompt().c_str());
+        inputs.texts.emplace_back(node->getUid(), text.value_or(""));
+    }
+    for (auto node : flow.filterNodesByType([](const Node* node) { return node->getType() == NodeType::NumberInput; })) {
+        auto number = handler.readFloat(static_cast<NumberInputNode*>(node)->getPrompt().c_str());
+        inputs.numbers.emplace_back(node->getUid(), number.value_or(0.0f));
+    }
+
+    try {
+        controller.submitFlow(flow, jobOptions, std::move(inputs));
+    }
+    catch (const std::exception& e) {
+        std::cout << e.what() << "\n";
+    }
+    auto metrics = controller.getJobMetrics();
+    std::cout << "\nQueued : " << metrics.queued << " (";
+    for (size_t index = 0; index < JobMetrics::PriorityCount; index++) {
+        std::cout << (index == 0 ? "" : ", ") << jobPriorityToString(JobPriority(index)) << " " << metrics.queuedByPriority[index];
+    }
+    std::cout << ")  Running : " << metrics.running << "  Completed : " << metrics.completed << "  Failed : " << metrics.failed
+        << "\nAverage wait : " << metrics.averageWait << " ms  Max wait : " << metrics.maxWait << " ms  Missed deadlines : " << metrics.missedDeadlines << "\n";
 }
 
 void DeleteExistingFlow::onExit(FlowController& controller)
@@ -411,3 +852,60 @@ void DeleteExistingFlow::doWork(FlowController& controller)
         onExit(controller);
     }
 }
+
+#ifdef __linux__
+void ServeFlowsState::doWork(FlowController& controller)
+{
+    auto flows = controller.getCurrentFlows();
+    if (flows.empty()) {
+        std::cout << "There are no flows!";
+        onExit(controller);
+        return;
+    }
+    auto path = handler.readString("Enter the socket path, or nothing for /tmp/flowbuilder.sock : ");
+    auto socketPath = path.has_value() && !path->empty() ? *path : std::string("/tmp/flowbuilder.sock");
+    try {
+        FlowServer server;
+        for (size_t index = 0; index < flows.size(); index++) {
+            server.registerFlow(std::to_string(index + 1), std::move(flows.at(index)));
+            std::cout << "Flow " << index + 1 << " : " << server.getFlowName(std::to_string(index + 1)) << "\n";
+        }
+        std::cout << "Serving on " << socketPath << ", send SHUTDOWN to stop\n";
+        server.serve(socketPath);
+    }
+    catch (const std::exception& e) {
+        std::cout << e.what() << "\n";
+    }
+    onExit(controller);
+}
+
+void WatchFlowsState::doWork(FlowController& controller)
+{
+    auto flows = controller.getCurrentFlows();
+    if (flows.empty()) {
+        std::cout << "There are no flows!";
+        onExit(controller);
+        return;
+    }
+    try {
+        FlowWatcher watcher;
+        for (auto& flow : flows) {
+            watcher.registerFlow(std::move(flow));
+        }
+        ConsoleResultSink sink;
+        watcher.runAll(sink);
+        sink.flush();
+        std::cout << "\nWatching the input files, press Enter to stop\n";
+        watcher.watch(sink, STDIN_FILENO, [&sink](size_t flowsRun) {
+            sink.flush();
+            std::cout << "\nRe-ran " << flowsRun << " flows\n";
+        });
+        std::string line;
+        std::getline(std::cin, line);
+    }
+    catch (const std::exception& e) {
+        std::cout << e.what() << "\n";
+    }
+    onExit(controller);
+}
+#endif
@@ -2,8 +2,19 @@
 #include <queue>
 #include <vector>
 #include <iostream>
+#include <thread>
+#include <atomic>
+#include <chrono>
 
 #include "Flow.h"
+#include "ExecutionPlan.h"
+#include "BatchRunner.h"
+#include "JobScheduler.h"
+#include "StreamingPipeline.h"
+#include "FlowServer.h"
+#include "FlowWatcher.h"
+#include "FollowRunner.h"
+#include "ShardedRunner.h"
 
 // Forward declarations
 struct FlowController;
@@ -12,6 +23,7 @@ class CreateNewFlowState;
 class RunExistingFlowState;
 
 struct FlowState {
+    virtual ~FlowState() = default;
     virtual void onEnter(FlowController& controller) = 0;
     virtual void onExit(FlowController& controller) = 0;
     virtual void doWork(FlowController& controller) = 0;
@@ -20,13 +32,14 @@ struct FlowState {
 
 struct FlowController {
     FlowController(); 
+    ~FlowController() {
+        delete m_next;
+    }
 
+    // The state runs once the current one returns, so moving between states does not grow the stack
     void setState(FlowState* state) {
-        
-        state->onEnter(*this);
-        state->doWork(*this);
-        state->onExit(*this);
-        delete state;
+        delete m_next;
+        m_next = state;
     }
 
     void addNewFlow(Flow&& flow) {
@@ -40,9 +53,24 @@ struct FlowController {
     std::vector<Flow> getCurrentFlows() const noexcept {
         return m_flows;
     }
+
+    /**
+     * Queues a run of the flow in the background, its inputs bound to the given values.
+     * Results go to the console and the output files, like executeFlow. The input files are read
+     * before the run is queued.
+     * @throws InvalidInput if the job queue is full or an input cannot be bound, InvalidHandle if an input file has no handle.
+     */
+    void submitFlow(const Flow& flow, const JobOptions& options, BatchRecord&& inputs);
+    JobMetrics getJobMetrics() const {
+        return m_scheduler.getMetrics();
+    }
 private:
     std::vector<Flow> m_flows;
-   // FlowState* currentState ;
+    FlowState* m_next = nullptr;
+    ConsoleResultSink m_console;
+    std::mutex m_consoleMutex;
+    // declared last so it stops, and its running jobs finish, before the sink they write to goes away
+    JobScheduler m_scheduler;
 };
 
 class StartState : public FlowState {
@@ -75,6 +103,7 @@ public:
     }
 
     void onExit(FlowController& controller) override {
+        exiting = true;
         StartState* newState = new StartState();
         controller.setState(newState);
     }
@@ -106,11 +135,32 @@ private:
 
     void addOutputNode();
 
+    void addWindowAggregateNode(FlowController& controller);
+
+    void addGroupByNode(FlowController& controller);
+
+    void addHashJoinNode(FlowController& controller);
+
+    void addFilterNode(FlowController& controller);
+
+    void addSortNode(FlowController& controller);
+
+    void addSearchNode(FlowController& controller);
+
+    void addTokenizeNode(FlowController& controller);
+
+    void addSketchNode(FlowController& controller);
+    void addVectorNode(FlowController& controller);
+    void addVectorCalculusNode(FlowController& controller);
+    void addVectorReduceNode(FlowController& controller);
+
     void addEndNode();
 
     void handleInvalidInput(FlowController& controller);
 
     NodeUid counter = 0;
+    // set once the state asked to leave, ending the menu loop
+    bool exiting = false;
     Flow flow;
     InputHandler handler;
 };
@@ -141,6 +191,41 @@ public:
         auto result = handler.pickOption("Pick the desired Flow ", options);
         if (result.has_value()) {
             auto index = std::atoi(result->m_key.c_str())-1;
+            auto mode = handler.pickOption("What do you want to run?", { Option("The whole flow", "a", "a"), Option("Preview one result", "b", "b"),
+                Option("The whole flow, streaming its files line by line", "c", "c"),
+                Option("The whole flow on the lines appended to one of its files", "d", "d"),
+                Option("The whole flow once for each of several sets of inputs", "e", "e")
+#ifdef __linux__
+                , Option("The whole flow in several processes, each over a part of one of its files", "f", "f")
+#endif
+                });
+            if (mode.has_value() && mode->m_key == "b") {
+                previewResult(flows.at(index));
+                onExit(controller);
+                return;
+            }
+            if (mode.has_value() && mode->m_key == "c") {
+                streamFlow(flows.at(index));
+                onExit(controller);
+                return;
+            }
+            if (mode.has_value() && mode->m_key == "d") {
+                followFlow(flows.at(index));
+                onExit(controller);
+                return;
+            }
+            if (mode.has_value() && mode->m_key == "e") {
+                batchFlow(flows.at(index));
+                onExit(controller);
+                return;
+            }
+#ifdef __linux__
+            if (mode.has_value() && mode->m_key == "f") {
+                shardFlow(flows.at(index));
+                onExit(controller);
+                return;
+            }
+#endif
             system("CLS");
             std::cout << "\nExecution has began"<<"\n";
           
@@ -153,6 +238,164 @@ public:
     }
 private:
     InputHandler handler;
+
+    // Runs the flow as a StreamingPipeline, prompting for its text inputs first
+    void streamFlow(Flow& flow) {
+        try {
+            ExecutionPlan plan(flow);
+            StreamingPipeline pipeline(plan);
+            for (auto node : flow.filterNodesByType([](const Node* node) { return node->getType() == NodeType::TextInput; })) {
+                auto text = handler.readString(static_cast<TextInputNode*>(node)->getPrompt().c_str());
+                pipeline.bindText(node->getUid(), text.value_or(""));
+            }
+            system("CLS");
+            std::cout << "\nExecution has began" << "\n";
+            ConsoleResultSink sink;
+            pipeline.run(sink);
+        }
+        catch (const std::exception& e) {
+            std::cout << e.what() << "\n";
+        }
+    }
+
+    // Runs the flow with a BatchRunner over sets of inputs read first; results come in the order of the sets
+    void batchFlow(Flow& flow) {
+        auto count = handler.readFloat("How many sets of inputs? ");
+        if (!count.has_value() || *count < 1.0f) return;
+        auto texts = flow.filterNodesByType([](const Node* node) { return node->getType() == NodeType::TextInput; });
+        auto numbers = flow.filterNodesByType([](const Node* node) { return node->getType() == NodeType::NumberInput; });
+        std::vector<BatchRecord> records(static_cast<size_t>(*count));
+        for (size_t index = 0; index < records.size(); index++) {
+            std::cout << "\nSet " << index + 1 << "\n";
+            for (auto node : texts) {
+                auto text = handler.readString(static_cast<TextInputNode*>(node)->getPrompt().c_str());
+                records[index].texts.emplace_back(node->getUid(), text.value_or(""));
+            }
+            for (auto node : numbers) {
+                auto number = handler.readFloat(static_cast<NumberInputNode*>(node)->getPrompt().c_str());
+                records[index].numbers.emplace_back(node->getUid(), number.value_or(0.0f));
+            }
+        }
+        try {
+            ExecutionPlan plan(flow);
+            BatchRunner runner(plan);
+            system("CLS");
+            std::cout << "\nExecution has began" << "\n";
+            ConsoleResultSink sink;
+            runner.run(records, sink);
+        }
+        catch (const std::exception& e) {
+            std::cout << e.what() << "\n";
+        }
+    }
+
+    // Runs the flow each time lines are appended to the picked file input, until Enter is pressed
+    void followFlow(Flow& flow) {
+        auto inputs = flow.filterNodesByType([](const Node* node) { return node->getType() == NodeType::FileInput; });
+        if (inputs.empty()) {
+            std::cout << "There are no file inputs to follow!";
+            return;
+        }
+        std::vector<Option> options;
+        for (auto node : inputs) {
+            auto input = static_cast<FileInputNode*>(node);
+            options.emplace_back(std::string(input->getFileName()) + input->getExtension(), std::to_string(node->getUid()), std::to_string(node->getUid()));
+        }
+        auto picked = handler.pickOption("Pick the file to follow ", options);
+        if (!picked.has_value()) return;
+        auto header = handler.pickOption("Does the file start with a header line?", { Option("Yes", "Yes", "Yes"), Option("No", "No", "No") });
+        try {
+            ExecutionPlan plan(flow);
+            FollowRunner runner(plan, static_cast<NodeUid>(std::atol(picked->m_key.c_str())), header.has_value() && header->m_key == "Yes");
+            system("CLS");
+            std::cout << "\nFollowing the file, press Enter to stop" << "\n";
+            std::atomic<bool> stopped{ false };
+            std::thread stopper([&stopped]() {
+                std::string line;
+                std::getline(std::cin, line);
+                stopped = true;
+            });
+            ConsoleResultSink sink;
+            while (!stopped) {
+                try {
+                    if (runner.poll(sink) == 0) {
+                        sink.flush();
+                        std::this_thread::sleep_for(std::chrono::milliseconds(250));
+                    }
+                }
+                catch (const std::exception& e) {
+                    std::cout << e.what() << "\nPress Enter to return\n";
+                    break;
+                }
+            }
+            stopper.join();
+        }
+        catch (const std::exception& e) {
+            std::cout << e.what() << "\n";
+        }
+    }
+
+#ifdef __linux__
+    // Runs the flow with a ShardedRunner over the picked file input, then reports the shards that failed
+    void shardFlow(Flow& flow) {
+        auto inputs = flow.filterNodesByType([](const Node* node) { return node->getType() == NodeType::FileInput; });
+        if (inputs.empty()) {
+            std::cout << "There are no file inputs to split!";
+            return;
+        }
+        std::vector<Option> options;
+        for (auto node : inputs) {
+            auto input = static_cast<FileInputNode*>(node);
+            options.emplace_back(std::string(input->getFileName()) + input->getExtension(), std::to_string(node->getUid()), std::to_string(node->getUid()));
+        }
+        auto picked = handler.pickOption("Pick the file to split ", options);
+        if (!picked.has_value()) return;
+        auto header = handler.pickOption("Does the file start with a header line?", { Option("Yes", "Yes", "Yes"), Option("No", "No", "No") });
+        auto workers = handler.readFloat("How many processes? ");
+        try {
+            auto input = static_cast<FileInputNode*>(*std::find_if(inputs.begin(), inputs.end(), [&picked](const Node* node) {
+                return std::to_string(node->getUid()) == picked->m_key;
+                }));
+            auto handle = FileSystem::getInstance()->getFileHandle(input->getFileName(), FileHandle::parseExtension(input->getExtension()));
+            if (handle == nullptr) {
+                throw InvalidHandle("Failed to get a valid handle");
+            }
+            ExecutionPlan plan(flow);
+            ShardedRunner runner(plan, input->getUid(), static_cast<size_t>(workers.value_or(1.0f)), header.has_value() && header->m_key == "Yes");
+            system("CLS");
+            std::cout << "\nExecution has began" << "\n";
+            ConsoleResultSink sink;
+            for (const auto& report : runner.run(FileSystem::getInstance()->getInputFilePath(handle.get()), sink)) {
+                if (!report.succeeded) {
+                    std::cout << "The part from byte " << report.begin << " to " << report.end << " failed : " << report.error << "\n";
+                }
+            }
+        }
+        catch (const std::exception& e) {
+            std::cout << e.what() << "\n";
+        }
+    }
+#endif
+
+    // Evaluates a single Display or Output node, prompting only for the inputs it depends on
+    void previewResult(Flow& flow) {
+        auto results = flow.filterNodesByType([](const Node* node) {
+            return node->getType() == NodeType::Display || node->getType() == NodeType::Output;
+            });
+        if (results.empty()) {
+            std::cout << "There are no results to preview!";
+            return;
+        }
+        std::vector<Option> options;
+        for (auto node : results) {
+            options.emplace_back("( " + nodeTypeToString(node->getType()) + " , " + std::to_string(node->getUid()) + " )", std::to_string(node->getUid()), std::to_string(node->getUid()));
+        }
+        auto picked = handler.pickOption("Pick the result to preview ", options);
+        if (picked.has_value()) {
+            system("CLS");
+            flow.evaluate(static_cast<NodeUid>(std::atol(picked->m_key.c_str())));
+        }
+    }
 };
 
 class DeleteExistingFlow : public FlowState {
@@ -168,6 +411,50 @@ private:
     InputHandler handler;
 };
 
+// Queues a background run of a flow, with a priority, a tenant and a deadline
+class QueueFlowState : public FlowState {
+public:
+    void onEnter(FlowController& controller) override {
+    }
+    void onExit(FlowController& controller) override {
+        controller.setState(new StartState());
+    }
+    void doWork(FlowController& controller) override;
+    const char* getType() const noexcept override {
+        return "Queue Flow State";
+    }
+private:
+    InputHandler handler;
+};
 
+#ifdef __linux__
+// Keeps the flows of the session compiled and runs them for local clients, see FlowServer
+class ServeFlowsState : public FlowState {
+public:
+    void onEnter(FlowController& controller) override {
+    }
+    void onExit(FlowController& controller) override {
+        controller.setState(new StartState());
+    }
+    void doWork(FlowController& controller) override;
+    const char* getType() const noexcept override {
+        return "Serve Flows State";
+    }
+private:
+    InputHandler handler;
+};
 
-
+// Runs the flows of the session, then again whenever the files they read change, see FlowWatcher
+class WatchFlowsState : public FlowState {
+public:
+    void onEnter(FlowController& controller) override {
+    }
+    void onExit(FlowController& controller) override {
+        controller.setState(new StartState());
+    }
+    void doWork(FlowController& controller) override;
+    const char* getType() const noexcept override {
+        return "Watch Flows State";
+    }
+};
+#endif
@@ -0,0 +1,181 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <sstream>
+#include <unordered_map>
+#include <algorithm>
+
+#include "Node.h"
+#include "InputHandler.h"
+
+/**
+ * Finalized, read only graph of a flow.
+ *
+ * Nodes are renumbered into dense indices following the execution order. Dependencies (forward
+ * edges) and dependents (reverse edges) are stored in compressed sparse row form : the edges of
+ * node i are the targets in [offsets[i], offsets[i + 1]). Node indices of each NodeType are kept
+ * the same way, so every traversal is a contiguous scan and the uid hash map is only needed at
+ * the boundary, when translating a NodeUid into an index.
+ */
+class FlowGraph {
+public:
+    typedef uint32_t Index;
+
+    // Contiguous run of node indices
+    class IndexRange {
+    public:
+        IndexRange(const Index* first, const Index* last) noexcept : m_first(first), m_last(last) {}
+        const Index* begin() const noexcept {
+            return m_first;
+        }
+        const Index* end() const noexcept {
+            return m_last;
+        }
+        size_t size() const noexcept {
+            return m_last - m_first;
+        }
+        bool empty() const noexcept {
+            return m_first == m_last;
+        }
+        Index operator[](size_t position) const noexcept {
+            return m_first[position];
+        }
+    private:
+        const Index* m_first;
+        const Index* m_last;
+    };
+
+    FlowGraph() = default;
+
+    /**
+     * @param ordered The nodes in execution order.
+     * @throws InvalidInput if a dependency is unknown or does not come before its consumer.
+     */
+    explicit FlowGraph(const std::vector<Node*>& ordered) : m_nodes(ordered) {
+        const size_t count = m_nodes.size();
+        m_types.reserve(count);
+        m_indices.reserve(count);
+        for (size_t index = 0; index < count; index++) {
+            m_types.push_back(m_nodes[index]->getType());
+            m_indices.emplace(m_nodes[index]->getUid(), Index(index));
+        }
+
+        // forward edges, already grouped by consumer
+        m_dependencyOffsets.reserve(count + 1);
+        m_dependencyOffsets.push_back(0);
+        for (size_t index = 0; index < count; index++) {
+            for (auto uid : m_nodes[index]->getDependencies()) {
+                auto iterator = m_indices.find(uid);
+                if (iterator == m_indices.end() || iterator->second >= index) {
+                    std::stringstream ss;
+                    ss << "Leaf Node with uid = " << uid << " was not found \n";
+                    throw InvalidInput(ss.str().c_str());
+                }
+                m_dependencyTargets.push_back(iterator->second);
+            }
+            m_dependencyOffsets.push_back(Index(m_dependencyTargets.size()));
+        }
+
+        // reverse edges through a counting pass
+        m_dependentOffsets.assign(count + 1, 0);
+        for (auto target : m_dependencyTargets) {
+            m_dependentOffsets[target + 1]++;
+        }
+        for (size_t index = 0; index < count; index++) {
+            m_dependentOffsets[index + 1] += m_dependentOffsets[index];
+        }
+        m_dependentTargets.resize(m_dependencyTargets.size());
+        std::vector<Index> cursor(m_dependentOffsets.begin(), m_dependentOffsets.end() - 1);
+        for (size_t index = 0; index < count; index++) {
+            for (auto dependency : getDependencies(Index(index))) {
+                m_dependentTargets[cursor[dependency]++] = Index(index);
+            }
+        }
+
+        // per type lists, same counting pass over the types
+        m_typeOffsets.assign(NodeTypeCount + 1, 0);
+        for (auto type : m_types) {
+            m_typeOffsets[size_t(type) + 1]++;
+        }
+        for (size_t type = 0; type < NodeTypeCount; type++) {
+            m_typeOffsets[type + 1] += m_typeOffsets[type];
+        }
+        m_typeTargets.resize(count);
+        cursor.assign(m_typeOffsets.begin(), m_typeOffsets.end() - 1);
+        for (size_t index = 0; index < count; index++) {
+            m_typeTargets[cursor[size_t(m_types[index])]++] = Index(index);
+        }
+    }
+
+    size_t getNodeCount() const noexcept {
+        return m_nodes.size();
+    }
+    size_t getEdgeCount() const noexcept {
+        return m_dependencyTargets.size();
+    }
+    Node* getNode(Index index) const noexcept {
+        return m_nodes[index];
+    }
+    NodeType getType(Index index) const noexcept {
+        return m_types[index];
+    }
+    NodeUid getUid(Index index) const noexcept {
+        return m_nodes[index]->getUid();
+    }
+    bool contains(NodeUid uid) const {
+        return m_indices.find(uid) != m_indices.end();
+    }
+    Index getIndex(NodeUid uid) const {
+        auto iterator = m_indices.find(uid);
+        if (iterator == m_indices.end()) {
+            std::stringstream ss;
+            ss << "Node with uid = " << uid << " is not part of the flow";
+            throw InvalidInput(ss.str().c_str());
+        }
+        return iterator->second;
+    }
+
+    IndexRange getDependencies(Index index) const noexcept {
+        return range(m_dependencyOffsets, m_dependencyTargets, index);
+    }
+    IndexRange getDependents(Index index) const noexcept {
+        return range(m_dependentOffsets, m_dependentTargets, index);
+    }
+    IndexRange getNodesOfType(NodeType type) const noexcept {
+        return range(m_typeOffsets, m_typeTargets, size_t(type));
+    }
+
+    // Whether index reads input, directly or through other nodes
+    bool dependsOn(Index index, Index input) const noexcept {
+        if (index == input) return true;
+        // dependencies come before their consumers
+        if (index < input) return false;
+        auto dependencies = getDependencies(index);
+        return std::any_of(dependencies.begin(), dependencies.end(), [this, input](Index dependency) {
+            return dependsOn(dependency, input);
+        });
+    }
+
+    // Whether the values of index over consecutive pieces of input are its values over each of them, one after the other
+    bool followsRowByRow(Index index, Index input) const noexcept {
+        if (index == input) return true;
+        auto dependencies = getDependencies(index);
+        if (!isRowLocalNodeType(getType(index)) || dependencies.empty()) return false;
+        return std::all_of(dependencies.begin(), dependencies.end(), [this, input](Index dependency) {
+            return followsRowByRow(dependency, input);
+        });
+    }
+
+private:
+    std::vector<Node*> m_nodes;
+    std::vector<NodeType> m_types;
+    std::unordered_map<NodeUid, Index> m_indices;
+    std::vector<Index> m_dependencyOffsets, m_dependencyTargets;
+    std::vector<Index> m_dependentOffsets, m_dependentTargets;
+    std::vector<Index> m_typeOffsets, m_typeTargets;
+
+    static IndexRange range(const std::vector<Index>& offsets, const std::vector<Index>& targets, size_t position) noexcept {
+        const Index* data = targets.data();
+        return IndexRange(data + offsets[position], data + offsets[position + 1]);
+    }
+};
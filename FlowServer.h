@@ -0,0 +1,579 @@
+#pragma once
+#ifdef __linux__
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "ExecutionPlan.h"
+#include "Parallel.h"
+
+/**
+ * Long lived execution server : flows are registered once, compiled into an ExecutionPlan and
+ * kept in memory with their prepared ExecutionContexts, and clients run them over a Unix domain
+ * socket instead of starting a process per execution.
+ *
+ * One thread runs an epoll loop that accepts connections, reads requests and writes results;
+ * the flows themselves run on a pool of workers. Each connection executes its requests in order,
+ * different connections run in parallel, and every worker streams the Display and Output results
+ * back as the nodes produce them.
+ *
+ * Protocol, text headers and length prefixed payloads :
+ *
+ *     LIST                        ->  FLOW <id> <name> ... then DONE
+ *     RUN <flow id>                   one binding per line, then END
+ *     TEXT <uid> <byte count>         followed by the bytes and a line break
+ *     NUMBER <uid> <value>
+ *     END                         ->  DISPLAY|OUTPUT <uid> <byte count>, the bytes and a line break,
+ *                                     for every result, then DONE, or ERROR <message>
+ *     SHUTDOWN                    ->  stops the server once the running requests finished
+ *
+ * Text and number inputs a request does not bind are empty and 0, whichever context runs it. The
+ * files of FileInput nodes are read once, when the flow is registered, and are not refreshed while
+ * the server runs; only the files that joins and scans stream are read again by every request.
+ */
+class FlowServer {
+public:
+	// A request larger than this closes the connection
+	static constexpr size_t MaxRequestSize = size_t(1) << 30;
+
+	explicit FlowServer(size_t workerCount = std::max<size_t>(1, std::thread::hardware_concurrency()))
+		: m_workers(std::make_unique<ThreadPool>(workerCount)) {}
+	FlowServer(const FlowServer&) = delete;
+	FlowServer& operator=(const FlowServer&) = delete;
+
+	~FlowServer() {
+		// workers finish their requests before the descriptors they notify are closed
+		m_workers.reset();
+		for (auto& connection : m_connections) {
+			::close(connection.first);
+		}
+		if (m_listener >= 0) ::close(m_listener);
+		if (m_wakeup >= 0) ::close(m_wakeup);
+		if (m_epoll >= 0) ::close(m_epoll);
+		if (!m_socketPath.empty()) ::unlink(m_socketPath.c_str());
+	}
+
+	/**
+	 * Compiles the flow and makes it available under id. Flows must be registered before serve().
+	 * Its input files are read here, so the workers never read them.
+	 * @throws InvalidInput if the id is taken or the flow cannot be compiled.
+	 */
+	void registerFlow(const std::string& id, Flow&& flow) {
+		if (m_flows.find(id) != m_flows.end()) {
+			throw InvalidInput(("A flow is already registered as " + id).c_str());
+		}
+		auto loaded = std::make_unique<LoadedFlow>();
+		loaded->flow = std::make_unique<Flow>(std::move(flow));
+		loaded->plan = std::make_unique<ExecutionPlan>(*loaded->flow);
+		ExecutionContext loader(*loaded->plan);
+		loader.loadInputs();
+		const auto& graph = loaded->plan->getGraph();
+		for (auto slot : graph.getNodesOfType(NodeType::FileInput)) {
+			if (!loaded->plan->isStreamed(slot)) {
+				loaded->files.emplace(graph.getUid(slot), loader.getText(graph.getUid(slot)));
+			}
+		}
+		m_flows.emplace(id, std::move(loaded));
+		m_flowIds.push_back(id);
+	}
+
+	const char* getFlowName(const std::string& id) const {
+		return m_flows.at(id)->flow->getName();
+	}
+
+	/**
+	 * Listens on socketPath and serves requests until stop() is called or a client sends SHUTDOWN.
+	 * @throws InvalidHandle if the socket cannot be created.
+	 */
+	void serve(const std::string& socketPath) {
+		sockaddr_un address{};
+		address.sun_family = AF_UNIX;
+		if (socketPath.empty() || socketPath.size() >= sizeof(address.sun_path)) {
+			throw InvalidInput("The socket path is empty or too long");
+		}
+		std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+		m_listener = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+		::unlink(socketPath.c_str());
+		if (m_listener < 0 || ::bind(m_listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || ::listen(m_listener, SOMAXCONN) != 0) {
+			throw InvalidHandle(("Failed to listen on " + socketPath + " : " + std::strerror(errno)).c_str());
+		}
+		m_socketPath = socketPath;
+		m_epoll = ::epoll_create1(EPOLL_CLOEXEC);
+		m_wakeup = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (m_epoll < 0 || m_wakeup < 0) {
+			throw InvalidHandle("Failed to create the event loop");
+		}
+		watch(m_listener, EPOLLIN, EPOLL_CTL_ADD);
+		watch(m_wakeup, EPOLLIN, EPOLL_CTL_ADD);
+
+		epoll_event events[64];
+		{
+			std::lock_guard<std::mutex> lock(m_readyMutex);
+			m_running = !m_stopRequested;
+		}
+		while (m_running || m_activeRequests != 0) {
+			int count = ::epoll_wait(m_epoll, events, 64, -1);
+			if (count < 0) {
+				if (errno == EINTR) continue;
+				throw InvalidHandle("epoll_wait failed");
+			}
+			for (int index = 0; index < count; index++) {
+				int fd = events[index].data.fd;
+				if (fd == m_listener) {
+					acceptConnections();
+				}
+				else if (fd == m_wakeup) {
+					drainWakeups();
+				}
+				else {
+					auto iterator = m_connections.find(fd);
+					if (iterator != m_connections.end()) {
+						onConnectionEvent(iterator->second, events[index].events);
+					}
+				}
+			}
+		}
+	}
+
+	// Thread safe; serve() returns once the running requests finished
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(m_readyMutex);
+			m_stopRequested = true;
+		}
+		notifyLoop();
+	}
+
+private:
+	struct LoadedFlow {
+		std::unique_ptr<Flow> flow;
+		std::unique_ptr<ExecutionPlan> plan;
+		// content of the FileInput nodes that are not streamed, read at registration
+		std::unordered_map<NodeUid, std::string> files;
+		// prepared contexts not used by a running request
+		std::mutex mutex;
+		std::vector<std::unique_ptr<ExecutionContext>> idle;
+	};
+
+	struct Binding {
+		NodeUid uid;
+		bool isText;
+		std::string text;
+		double number;
+	};
+
+	struct Request {
+		enum class Kind { List, Run, Shutdown } kind = Kind::Run;
+		std::string flowId;
+		std::vector<Binding> bindings;
+	};
+
+	// Input and readClosed are only touched by the loop; output and busy are shared with the worker running a request
+	struct Connection {
+		int fd;
+		std::string input;
+		// the client shut its sending side, the connection closes once its requests are answered
+		bool readClosed = false;
+		std::mutex mutex;
+		std::string output;
+		size_t written = 0;
+		bool busy = false;
+		bool closed = false;
+		bool waitingForWrite = false;
+	};
+
+	// Streams the results of a run to its connection as they are produced
+	class ConnectionSink : public ResultSink {
+	public:
+		ConnectionSink(FlowServer& server, const std::shared_ptr<Connection>& connection) : m_server(server), m_connection(connection) {}
+
+		void onDisplay(const DisplayNode& node, std::string_view content) override {
+			m_server.send(m_connection, "DISPLAY", node.getUid(), content);
+		}
+		void onOutput(const OutputNode& node, std::string_view content) override {
+			m_server.send(m_connection, "OUTPUT", node.getUid(), content);
+		}
+	private:
+		FlowServer& m_server;
+		std::shared_ptr<Connection> m_connection;
+	};
+
+	std::unordered_map<std::string, std::unique_ptr<LoadedFlow>> m_flows;
+	std::vector<std::string> m_flowIds;
+	std::unordered_map<int, std::shared_ptr<Connection>> m_connections;
+	int m_listener = -1;
+	int m_epoll = -1;
+	int m_wakeup = -1;
+	std::string m_socketPath;
+	bool m_running = false;
+	std::atomic<size_t> m_activeRequests{ 0 };
+	// connections with new output or a finished request, handed from the workers to the loop
+	std::mutex m_readyMutex;
+	std::vector<std::shared_ptr<Connection>> m_ready;
+	bool m_stopRequested = false;
+	std::unique_ptr<ThreadPool> m_workers;
+
+	void watch(int fd, uint32_t events, int operation) {
+		epoll_event event{};
+		event.events = events;
+		event.data.fd = fd;
+		::epoll_ctl(m_epoll, operation, fd, &event);
+	}
+
+	void notifyLoop() {
+		uint64_t one = 1;
+		ssize_t ignored = ::write(m_wakeup, &one, sizeof(one));
+		(void)ignored;
+	}
+
+	void acceptConnections() {
+		while (true) {
+			int fd = ::accept4(m_listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			if (fd < 0) return;
+			if (!m_running) {
+				::close(fd);
+				continue;
+			}
+			auto connection = std::make_shared<Connection>();
+			connection->fd = fd;
+			m_connections.emplace(fd, connection);
+			watch(fd, EPOLLIN | EPOLLRDHUP, EPOLL_CTL_ADD);
+		}
+	}
+
+	void drainWakeups() {
+		uint64_t count;
+		while (::read(m_wakeup, &count, sizeof(count)) > 0) {}
+		std::vector<std::shared_ptr<Connection>> ready;
+		{
+			std::lock_guard<std::mutex> lock(m_readyMutex);
+			ready.swap(m_ready);
+			if (m_stopRequested) m_running = false;
+		}
+		for (auto& connection : ready) {
+			if (connection->closed) continue;
+			flush(connection);
+			if (connection->closed) continue;
+			dispatch(connection);
+			closeIfFinished(connection);
+		}
+	}
+
+	void onConnectionEvent(const std::shared_ptr<Connection>& connection, uint32_t events) {
+		if (connection->readClosed && (events & (EPOLLHUP | EPOLLERR))) {
+			// the client went away entirely, nobody reads the remaining results
+			close(connection);
+			return;
+		}
+		if (events & EPOLLOUT) {
+			flush(connection);
+		}
+		if (!connection->readClosed && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+			char buffer[1 << 16];
+			while (true) {
+				ssize_t read = ::read(connection->fd, buffer, sizeof(buffer));
+				if (read > 0) {
+					connection->input.append(buffer, size_t(read));
+					continue;
+				}
+				if (read == 0) {
+					// end of stream : the complete requests buffered still run and are answered
+					connection->readClosed = true;
+					std::lock_guard<std::mutex> lock(connection->mutex);
+					watch(connection->fd, connectionEvents(*connection), EPOLL_CTL_MOD);
+					break;
+				}
+				if (errno == EAGAIN || errno == EINTR) break;
+				// error : results of a running request are dropped
+				close(connection);
+				return;
+			}
+			if (connection->input.size() > MaxRequestSize) {
+				close(connection);
+				return;
+			}
+			dispatch(connection);
+		}
+		closeIfFinished(connection);
+	}
+
+	// Closes a connection whose client stopped sending once it has no request running or output left
+	void closeIfFinished(const std::shared_ptr<Connection>& connection) {
+		if (!connection->readClosed) return;
+		{
+			std::lock_guard<std::mutex> lock(connection->mutex);
+			if (connection->busy || !connection->output.empty()) return;
+		}
+		close(connection);
+	}
+
+	// Events the loop waits for on a connection, its mutex held
+	static uint32_t connectionEvents(const Connection& connection) {
+		return (connection.readClosed ? 0u : uint32_t(EPOLLIN | EPOLLRDHUP)) | (connection.waitingForWrite ? uint32_t(EPOLLOUT) : 0u);
+	}
+
+	void close(const std::shared_ptr<Connection>& connection) {
+		{
+			std::lock_guard<std::mutex> lock(connection->mutex);
+			connection->closed = true;
+		}
+		::epoll_ctl(m_epoll, EPOLL_CTL_DEL, connection->fd, nullptr);
+		::close(connection->fd);
+		m_connections.erase(connection->fd);
+	}
+
+	// Starts the next complete request of an idle connection
+	void dispatch(const std::shared_ptr<Connection>& connection) {
+		if (!m_running) return;
+		{
+			std::lock_guard<std::mutex> lock(connection->mutex);
+			if (connection->busy) return;
+		}
+		Request request;
+		try {
+			if (!parseRequest(connection->input, request)) return;
+		}
+		catch (const std::exception& e) {
+			connection->input.clear();
+			send(connection, std::string("ERROR ") + singleLine(e.what()) + "\n");
+			return;
+		}
+
+		if (request.kind == Request::Kind::Shutdown) {
+			send(connection, "DONE\n");
+			flush(connection);
+			m_running = false;
+			return;
+		}
+		if (request.kind == Request::Kind::List) {
+			std::string reply;
+			for (const auto& id : m_flowIds) {
+				reply += "FLOW " + id + " " + singleLine(m_flows.at(id)->flow->getName()) + "\n";
+			}
+			send(connection, reply + "DONE\n");
+			dispatch(connection);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(connection->mutex);
+			connection->busy = true;
+		}
+		m_activeRequests++;
+		m_workers->submit([this, connection, request = std::move(request)]() mutable {
+			execute(connection, request);
+			{
+				std::lock_guard<std::mutex> lock(connection->mutex);
+				connection->busy = false;
+			}
+			markReady(connection, true);
+		});
+	}
+
+	// Runs on a worker
+	void execute(const std::shared_ptr<Connection>& connection, Request& request) {
+		auto iterator = m_flows.find(request.flowId);
+		if (iterator == m_flows.end()) {
+			send(connection, "ERROR No flow is registered as " + singleLine(request.flowId) + "\n");
+			return;
+		}
+		auto& loaded = *iterator->second;
+		std::unique_ptr<ExecutionContext> context;
+		try {
+			context = acquireContext(loaded);
+			for (auto& binding : request.bindings) {
+				if (binding.isText) {
+					context->bindText(binding.uid, binding.text);
+				}
+				else {
+					context->bindDouble(binding.uid, binding.number);
+				}
+			}
+			ConnectionSink sink(*this, connection);
+			context->run(sink);
+			send(connection, "DONE\n");
+		}
+		catch (const std::exception& e) {
+			send(connection, std::string("ERROR ") + singleLine(e.what()) + "\n");
+		}
+		if (context != nullptr) {
+			// a file the request replaced goes back to the registered one
+			try {
+				for (auto& binding : request.bindings) {
+					auto file = loaded.files.find(binding.uid);
+					if (file != loaded.files.end()) {
+						context->bindText(binding.uid, file->second);
+					}
+					else if (binding.isText && loaded.plan->getGraph().getType(loaded.plan->getSlot(binding.uid)) == NodeType::FileInput) {
+						context->unbindFile(binding.uid);
+					}
+				}
+			}
+			catch (const std::exception&) {
+				// a binding of a node the flow does not have, the context is not worth keeping
+				return;
+			}
+			std::lock_guard<std::mutex> lock(loaded.mutex);
+			loaded.idle.push_back(std::move(context));
+		}
+	}
+
+	// A context used before, or a new one prepared for the flow, its inputs back to their defaults
+	static std::unique_ptr<ExecutionContext> acquireContext(LoadedFlow& loaded) {
+		std::unique_ptr<ExecutionContext> context;
+		{
+			std::lock_guard<std::mutex> lock(loaded.mutex);
+			if (!loaded.idle.empty()) {
+				context = std::move(loaded.idle.back());
+				loaded.idle.pop_back();
+			}
+		}
+		if (context == nullptr) {
+			context = std::make_unique<ExecutionContext>(*loaded.plan);
+			for (const auto& file : loaded.files) {
+				context->bindText(file.first, file.second);
+			}
+			context->prepare();
+		}
+		context->resetInputs();
+		return context;
+	}
+
+	void send(const std::shared_ptr<Connection>& connection, const char* kind, NodeUid uid, std::string_view content) {
+		std::string header = std::string(kind) + " " + std::to_string(uid) + " " + std::to_string(content.size()) + "\n";
+		{
+			std::lock_guard<std::mutex> lock(connection->mutex);
+			if (connection->closed) return;
+			connection->output += header;
+			connection->output.append(content.data(), content.size());
+			connection->output += '\n';
+		}
+		markReady(connection, false);
+	}
+
+	void send(const std::shared_ptr<Connection>& connection, const std::string& text) {
+		{
+			std::lock_guard<std::mutex> lock(connection->mutex);
+			if (connection->closed) return;
+			connection->output += text;
+		}
+		markReady(connection, false);
+	}
+
+	// Hands the connection to the loop, which writes its output and starts its next request
+	void markReady(const std::shared_ptr<Connection>& connection, bool finished) {
+		{
+			std::lock_guard<std::mutex> lock(m_readyMutex);
+			m_ready.push_back(connection);
+		}
+		if (finished) m_activeRequests--;
+		notifyLoop();
+	}
+
+	// Writes what the socket accepts and waits for EPOLLOUT for the rest
+	void flush(const std::shared_ptr<Connection>& connection) {
+		bool blocked = false;
+		{
+			std::lock_guard<std::mutex> lock(connection->mutex);
+			while (connection->written < connection->output.size()) {
+				ssize_t sent = ::send(connection->fd, connection->output.data() + connection->written, connection->output.size() - connection->written, MSG_NOSIGNAL);
+				if (sent > 0) {
+					connection->written += size_t(sent);
+					continue;
+				}
+				if (sent < 0 && errno == EINTR) continue;
+				// a peer that went away is noticed by the read side
+				blocked = sent < 0 && errno == EAGAIN;
+				break;
+			}
+			if (connection->written == connection->output.size()) {
+				connection->output.clear();
+				connection->written = 0;
+			}
+			if (blocked != connection->waitingForWrite) {
+				connection->waitingForWrite = blocked;
+				watch(connection->fd, connectionEvents(*connection), EPOLL_CTL_MOD);
+			}
+		}
+	}
+
+	static std::string singleLine(std::string text) {
+		std::replace(text.begin(), text.end(), '\n', ' ');
+		std::replace(text.begin(), text.end(), '\r', ' ');
+		return text;
+	}
+
+	// Reads the line starting at position, without its line break; false if it is not complete yet
+	static bool readLine(const std::string& input, size_t& position, std::string_view& line) {
+		size_t end = input.find('\n', position);
+		if (end == std::string::npos) return false;
+		line = Csv::trimLineEnd(std::string_view(input.data() + position, end - position));
+		position = end + 1;
+		return true;
+	}
+
+	/**
+	 * Removes the request at the front of input into request.
+	 * @return false while the request is incomplete.
+	 * @throws InvalidInput if the request is malformed.
+	 */
+	static bool parseRequest(std::string& input, Request& request) {
+		size_t position = 0;
+		std::string_view line;
+		if (!readLine(input, position, line)) return false;
+		if (line == "LIST" || line == "SHUTDOWN") {
+			request.kind = line == "LIST" ? Request::Kind::List : Request::Kind::Shutdown;
+			input.erase(0, position);
+			return true;
+		}
+		if (line.substr(0, 4) != "RUN ") {
+			throw InvalidInput("Unknown request, expected LIST, RUN <flow id> or SHUTDOWN");
+		}
+		request.kind = Request::Kind::Run;
+		request.flowId.assign(line.substr(4));
+		while (true) {
+			if (!readLine(input, position, line)) return false;
+			if (line == "END") break;
+			Binding binding{};
+			std::string header(line);
+			char* end = nullptr;
+			if (header.compare(0, 5, "TEXT ") == 0) {
+				binding.isText = true;
+				binding.uid = static_cast<NodeUid>(std::strtoull(header.c_str() + 5, &end, 10));
+				size_t length = static_cast<size_t>(std::strtoull(end, &end, 10));
+				if (length > MaxRequestSize) throw InvalidInput("Binding is too large");
+				if (input.size() < position + length + 1) return false;
+				binding.text.assign(input, position, length);
+				position += length + 1;
+			}
+			else if (header.compare(0, 7, "NUMBER ") == 0) {
+				binding.isText = false;
+				binding.uid = static_cast<NodeUid>(std::strtoull(header.c_str() + 7, &end, 10));
+				binding.number = std::strtod(end, &end);
+			}
+			else {
+				throw InvalidInput("Unknown binding, expected TEXT <uid> <byte count>, NUMBER <uid> <value> or END");
+			}
+			request.bindings.push_back(std::move(binding));
+		}
+		input.erase(0, position);
+		return true;
+	}
+};
+#endif
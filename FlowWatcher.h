@@ -0,0 +1,215 @@
+#pragma once
+#ifdef __linux__
+#include <string>
+#include <vector>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <unordered_map>
+#include <unordered_set>
+#include <iostream>
+#include <cerrno>
+
+#include <sys/inotify.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include "ExecutionPlan.h"
+
+/**
+ * Watch mode : the registered flows stay compiled with their ExecutionContexts and, whenever files
+ * their FileInput nodes read change, only the nodes downstream of the changed files run again,
+ * rewriting the outputs that depend on them.
+ *
+ * The directories holding the input files are watched with inotify rather than the files, so a
+ * file replaced by a rename is still followed. Events are coalesced : after the first one the
+ * watcher waits until no event came for QuietPeriod, at most MaxDelay, then runs each affected flow
+ * once for every file that changed meanwhile. Flows reading none of the changed files do not run.
+ *
+ * The files a flow writes through its Output nodes never re-trigger that same flow.
+ */
+class FlowWatcher {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static constexpr std::chrono::milliseconds QuietPeriod{ 50 };
+	static constexpr std::chrono::milliseconds MaxDelay{ 300 };
+
+	// @throws InvalidHandle if inotify is not available.
+	FlowWatcher() {
+		m_inotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_inotify < 0) {
+			throw InvalidHandle("Failed to start watching the input files");
+		}
+	}
+	FlowWatcher(const FlowWatcher&) = delete;
+	FlowWatcher& operator=(const FlowWatcher&) = delete;
+
+	~FlowWatcher() {
+		::close(m_inotify);
+	}
+
+	/**
+	 * Compiles the flow and watches the files its FileInput nodes read.
+	 * @throws InvalidInput if the flow cannot be compiled, InvalidHandle if a directory cannot be watched.
+	 */
+	void registerFlow(Flow&& flow) {
+		auto watched = std::make_unique<WatchedFlow>();
+		watched->flow = std::make_unique<Flow>(std::move(flow));
+		watched->plan = std::make_unique<ExecutionPlan>(*watched->flow);
+		watched->context = std::make_unique<ExecutionContext>(*watched->plan);
+
+		auto fileSystem = FileSystem::getInstance();
+		const auto& graph = watched->plan->getGraph();
+		for (auto slot : graph.getNodesOfType(NodeType::FileInput)) {
+			auto& node = static_cast<const FileInputNode&>(*graph.getNode(slot));
+			auto path = fileSystem->getInputFilePath(getHandle(node.getFileName(), node.getExtension()).get());
+			watched->inputs[path].push_back(node.getUid());
+			watchDirectory(path);
+			m_watchedPaths.insert(path);
+		}
+		for (auto slot : graph.getNodesOfType(NodeType::Output)) {
+			auto& node = static_cast<const OutputNode&>(*graph.getNode(slot));
+			watched->outputs.insert(fileSystem->getOutputFilePath(getHandle(node.getFileName(), node.getExtension()).get()));
+		}
+		m_flows.push_back(std::move(watched));
+	}
+
+	// Runs every registered flow once in full, the starting point later changes are applied to
+	void runAll(ResultSink& sink) {
+		for (auto& watched : m_flows) {
+			try {
+				watched->context->loadInputs();
+				watched->context->run(sink);
+			}
+			catch (const std::exception& e) {
+				std::cerr << "The run of " << watched->flow->getName() << " failed : " << e.what() << "\n";
+			}
+		}
+	}
+
+	/**
+	 * Re-runs the affected flows after each batch of changes, until stopDescriptor, when not
+	 * negative, becomes readable. afterPass receives the number of flows a batch ran, once their
+	 * results were handed to the sink.
+	 */
+	void watch(ResultSink& sink, int stopDescriptor, const std::function<void(size_t)>& afterPass) {
+		pollfd descriptors[2] = { { m_inotify, POLLIN, 0 }, { stopDescriptor, POLLIN, 0 } };
+		const nfds_t count = stopDescriptor >= 0 ? 2 : 1;
+		while (true) {
+			if (::poll(descriptors, count, -1) < 0) {
+				if (errno == EINTR) continue;
+				throw InvalidHandle("Failed to wait for changes of the input files");
+			}
+			if (count == 2 && (descriptors[1].revents & (POLLIN | POLLHUP)) != 0) {
+				return;
+			}
+			if ((descriptors[0].revents & POLLIN) == 0) continue;
+
+			std::unordered_set<std::string> changed;
+			bool overflowed = readEvents(changed);
+			const auto deadline = Clock::now() + MaxDelay;
+			while (true) {
+				const auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now());
+				if (left.count() <= 0) break;
+				pollfd events{ m_inotify, POLLIN, 0 };
+				int ready = ::poll(&events, 1, int(std::min(left, QuietPeriod).count()));
+				if (ready == 0) break;
+				if (ready < 0 && errno != EINTR) {
+					throw InvalidHandle("Failed to wait for changes of the input files");
+				}
+				overflowed = readEvents(changed) || overflowed;
+			}
+
+			const size_t flowsRun = rerun(changed, overflowed, sink);
+			if (flowsRun != 0 && afterPass) {
+				afterPass(flowsRun);
+			}
+		}
+	}
+
+private:
+	struct WatchedFlow {
+		std::unique_ptr<Flow> flow;
+		std::unique_ptr<ExecutionPlan> plan;
+		std::unique_ptr<ExecutionContext> context;
+		// path of each input file, with the FileInput nodes reading it
+		std::unordered_map<std::string, std::vector<NodeUid>> inputs;
+		std::unordered_set<std::string> outputs;
+	};
+
+	int m_inotify = -1;
+	// watched directory of each watch descriptor, empty for the working directory
+	std::unordered_map<int, std::string> m_directories;
+	std::unordered_set<std::string> m_watchedPaths;
+	std::vector<std::unique_ptr<WatchedFlow>> m_flows;
+
+	static std::shared_ptr<FileHandle> getHandle(const char* fileName, const char* extension) {
+		auto handle = FileSystem::getInstance()->getFileHandle(fileName, FileHandle::parseExtension(extension));
+		if (handle == nullptr) {
+			throw InvalidHandle((std::string("Failed to get a file handle for file ") + fileName + extension).c_str());
+		}
+		return handle;
+	}
+
+	void watchDirectory(const std::string& path) {
+		const size_t slash = path.rfind('/');
+		const std::string directory = slash == std::string::npos ? std::string() : path.substr(0, slash);
+		const int descriptor = ::inotify_add_watch(m_inotify, directory.empty() ? "." : directory.c_str(),
+			IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR);
+		if (descriptor < 0) {
+			throw InvalidHandle(("Failed to watch the directory of " + path).c_str());
+		}
+		m_directories[descriptor] = directory;
+	}
+
+	// Adds the watched files the pending events are about, returns true if the kernel dropped events
+	bool readEvents(std::unordered_set<std::string>& changed) {
+		alignas(inotify_event) char buffer[16 * 1024];
+		bool overflowed = false;
+		while (true) {
+			const ssize_t size = ::read(m_inotify, buffer, sizeof(buffer));
+			if (size <= 0) {
+				if (size < 0 && errno == EINTR) continue;
+				return overflowed;
+			}
+			for (ssize_t offset = 0; offset < size;) {
+				const auto& event = *reinterpret_cast<const inotify_event*>(buffer + offset);
+				offset += sizeof(inotify_event) + event.len;
+				if ((event.mask & IN_Q_OVERFLOW) != 0) {
+					overflowed = true;
+					continue;
+				}
+				auto directory = m_directories.find(event.wd);
+				if (event.len == 0 || directory == m_directories.end()) continue;
+				std::string path = directory->second.empty() ? std::string(event.name) : directory->second + "/" + event.name;
+				if (m_watchedPaths.count(path) != 0) {
+					changed.insert(std::move(path));
+				}
+			}
+		}
+	}
+
+	// Every input counts as changed after an overflow, since the dropped events are unknown
+	size_t rerun(const std::unordered_set<std::string>& changed, bool overflowed, ResultSink& sink) {
+		size_t flowsRun = 0;
+		for (auto& watched : m_flows) {
+			std::vector<NodeUid> inputs;
+			for (const auto& input : watched->inputs) {
+				if ((overflowed || changed.count(input.first) != 0) && watched->outputs.count(input.first) == 0) {
+					inputs.insert(inputs.end(), input.second.begin(), input.second.end());
+				}
+			}
+			if (inputs.empty()) continue;
+			try {
+				watched->context->rerunFrom(inputs, sink);
+			}
+			catch (const std::exception& e) {
+				std::cerr << "The run of " << watched->flow->getName() << " failed : " << e.what() << "\n";
+			}
+			flowsRun++;
+		}
+		return flowsRun;
+	}
+};
+#endif
@@ -0,0 +1,150 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include "ExecutionPlan.h"
+
+/**
+ * Runs an ExecutionPlan incrementally over an input file that is only appended to, like a log.
+ *
+ * A FileFollower remembers how far the followed FileInput node's file was consumed; every poll
+ * binds only the complete lines appended since, preceded by the header line when the file has
+ * one, and runs the plan over them, so a growing file is never read again from its start. The
+ * other file inputs are read once, when the runner is created.
+ *
+ * Outputs hold the results of every batch so far, truncations and rotations included :
+ * - Window Aggregate, Group By and Sketch nodes are incremental, they keep their state from one
+ *   batch to the next, so an output reading them is rewritten with their cumulative result.
+ * - An output whose operands derive row by row from the followed input alone (through filters and
+ *   vectors, see isRowLocalNodeType) is appended to : the first batch writes it whole, the next
+ *   ones add their rows without the title, description and header lines written first.
+ * - Any other node, like a sort, a join, a search or a calculation, covers the last batch only.
+ * Displays show what the last batch computed.
+ */
+class FollowRunner {
+public:
+	/**
+	 * @param input The FileInput node to follow.
+	 * @param fromEnd Whether to skip the lines already in the file.
+	 * @throws InvalidInput if input is not a FileInput node, InvalidHandle if its file has no handle.
+	 */
+	FollowRunner(const ExecutionPlan& plan, NodeUid input, bool hasHeader = true, bool fromEnd = false, size_t maxBatch = FileFollower::DefaultMaxBatch)
+		: m_plan(plan), m_input(input), m_hasHeader(hasHeader), m_context(plan), m_sink(*this) {
+		const auto& graph = plan.getGraph();
+		const Node* node = graph.getNode(plan.getSlot(input));
+		if (node->getType() != NodeType::FileInput) {
+			throw InvalidInput(("Node with uid = " + std::to_string(input) + " is not a FileInput node").c_str());
+		}
+		auto& fileInput = static_cast<const FileInputNode&>(*node);
+		auto fileSystem = FileSystem::getInstance();
+		auto handle = fileSystem->getFileHandle(fileInput.getFileName(), FileHandle::parseExtension(fileInput.getExtension()));
+		if (handle == nullptr) {
+			throw InvalidHandle((std::string("Failed to get a file handle for file ") + fileInput.getFileName() + fileInput.getExtension()).c_str());
+		}
+		m_follower = std::make_unique<FileFollower>(fileSystem->getInputFilePath(handle.get()), fromEnd, hasHeader, maxBatch);
+		const auto inputSlot = plan.getSlot(input);
+		m_appended.assign(plan.getSlotCount(), false);
+		m_started.assign(plan.getSlotCount(), false);
+		for (auto slot : graph.getNodesOfType(NodeType::Output)) {
+			m_appended[slot] = graph.followsRowByRow(slot, inputSlot);
+		}
+		// bound to an empty batch so loadInputs leaves the followed file alone
+		m_context.bindText(input, std::string_view());
+		m_context.setAppendedTexts(true);
+		m_context.loadInputs();
+	}
+
+	FollowRunner(const FollowRunner&) = delete;
+	FollowRunner& operator=(const FollowRunner&) = delete;
+
+	/**
+	 * Runs the plan over the lines appended since the previous poll; nothing runs when there are none.
+	 * Outputs that are appended to reach the sink through appendOutput after the first batch.
+	 * @return The bytes of new lines the run covered, 0 when nothing ran.
+	 */
+	size_t poll(ResultSink& sink) {
+		m_lastEvent = m_follower->poll(m_lines);
+		if (m_lines.empty()) return 0;
+		if (m_hasHeader) {
+			m_batch.assign(m_follower->getHeader());
+			m_batch.append(m_lines);
+			m_context.bindText(m_input, m_batch);
+		}
+		else {
+			m_context.bindText(m_input, m_lines);
+		}
+		m_sink.m_target = &sink;
+		m_context.run(m_sink);
+		return m_lines.size();
+	}
+
+	// What the last poll found, Truncated or Rotated telling the file started over
+	FileFollower::Event getLastEvent() const noexcept {
+		return m_lastEvent;
+	}
+	uint64_t getOffset() const noexcept {
+		return m_follower->getOffset();
+	}
+
+private:
+	typedef ExecutionPlan::Index Index;
+
+	// Passes the results of a batch on, turning the outputs that are appended to into their new rows
+	class BatchSink : public ResultSink {
+	public:
+		explicit BatchSink(FollowRunner& runner) : m_runner(runner) {}
+
+		void onDisplay(const DisplayNode& node, std::string_view content) override {
+			m_target->onDisplay(node, content);
+		}
+		void onOutput(const OutputNode& node, std::string_view content) override {
+			const Index slot = m_runner.m_plan.getSlot(node.getUid());
+			if (!m_runner.m_appended[slot]) {
+				m_target->onOutput(node, content);
+				return;
+			}
+			content = Csv::withoutBlankEnd(content);
+			if (!m_runner.m_started[slot]) {
+				m_runner.m_started[slot] = true;
+				m_target->onOutput(node, content);
+				return;
+			}
+			// title and description, then the header line the filtered rows start with again
+			content = Csv::withoutFirstLine(Csv::withoutFirstLine(content));
+			if (m_runner.m_hasHeader && Csv::firstLine(content) == Csv::firstLine(m_runner.m_follower->getHeader())) {
+				content = Csv::withoutFirstLine(content);
+			}
+			if (!content.empty()) {
+				m_target->appendOutput(node, content);
+			}
+		}
+		// Outputs that are rewritten keep streaming to the target
+		std::unique_ptr<OutputStream> openOutput(const OutputNode& node) override {
+			if (!m_runner.m_appended[m_runner.m_plan.getSlot(node.getUid())]) {
+				return m_target->openOutput(node);
+			}
+			return ResultSink::openOutput(node);
+		}
+
+		ResultSink* m_target = nullptr;
+
+	private:
+		FollowRunner& m_runner;
+	};
+
+	const ExecutionPlan& m_plan;
+	NodeUid m_input;
+	bool m_hasHeader;
+	ExecutionContext m_context;
+	BatchSink m_sink;
+	// by slot, the outputs that are appended to and the ones the first batch already wrote
+	std::vector<bool> m_appended;
+	std::vector<bool> m_started;
+	std::unique_ptr<FileFollower> m_follower;
+	FileFollower::Event m_lastEvent = FileFollower::Event::None;
+	std::string m_lines;
+	std::string m_batch;
+};
@@ -0,0 +1,143 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <deque>
+
+#include "Csv.h"
+#include "GroupByTable.h"
+#include "Parallel.h"
+
+// Aggregates of every text given to GroupByAggregator::accumulate, owning their keys
+struct GroupByState {
+	GroupByTable table;
+	std::deque<std::string> keys;
+
+	explicit GroupByState(size_t valueColumns) : table(valueColumns) {}
+};
+
+/**
+ * Hash group by over CSV text with a header line.
+ *
+ * The rows are cut into line aligned chunks, every chunk is aggregated into its own table on the
+ * shared ThreadPool and the partial tables are merged in chunk order, so the output lists the keys
+ * in order of first appearance whatever the number of threads.
+ *
+ * Output columns : key, rows, then <column>_sum, _count, _min, _max, _mean for every value column.
+ * Values that are not numbers are left out of a column's aggregates.
+ */
+class GroupByAggregator {
+public:
+	// Inputs below this size are aggregated on the calling thread
+	static constexpr size_t ParallelThreshold = 1 << 20;
+
+	GroupByAggregator(std::string keyColumn, std::vector<std::string> valueColumns)
+		: m_keyColumn(std::move(keyColumn)), m_valueColumns(std::move(valueColumns)) {}
+
+	GroupByState createState() const {
+		return GroupByState(m_valueColumns.size());
+	}
+
+	void aggregate(std::string_view text, std::string& result) const {
+		result.clear();
+		std::vector<std::string_view> header;
+		std::vector<size_t> valueIndices;
+		std::vector<GroupByTable> partials;
+		size_t keyIndex = aggregateChunks(text, header, valueIndices, partials);
+		for (size_t chunk = 1; chunk < partials.size(); chunk++) {
+			partials[0].merge(partials[chunk]);
+		}
+		render(partials[0], header[keyIndex], valueIndices, header, result);
+	}
+
+	/**
+	 * Adds the rows of text to the aggregates of the texts accumulated before and renders them all,
+	 * for input arriving in batches that each start with the header line.
+	 */
+	void accumulate(std::string_view text, GroupByState& state, std::string& result) const {
+		result.clear();
+		std::vector<std::string_view> header;
+		std::vector<size_t> valueIndices;
+		std::vector<GroupByTable> partials;
+		size_t keyIndex = aggregateChunks(text, header, valueIndices, partials);
+		for (const auto& partial : partials) {
+			state.table.merge(partial, state.keys);
+		}
+		render(state.table, header[keyIndex], valueIndices, header, result);
+	}
+
+private:
+	std::string m_keyColumn;
+	std::vector<std::string> m_valueColumns;
+
+	// Aggregates the rows into one table per chunk and returns the index of the key column
+	size_t aggregateChunks(std::string_view text, std::vector<std::string_view>& header, std::vector<size_t>& valueIndices,
+		std::vector<GroupByTable>& partials) const {
+		std::string_view body;
+		auto headerLine = Csv::splitHeader(text, body);
+		Csv::splitFields(headerLine, header);
+
+		size_t keyIndex = Csv::findColumn(header, m_keyColumn);
+		for (const auto& column : m_valueColumns) {
+			valueIndices.push_back(Csv::findColumn(header, column));
+		}
+
+		auto& pool = ThreadPool::getInstance();
+		size_t chunkCount = body.size() < ParallelThreshold ? 1 : pool.getThreadCount() + 1;
+		auto chunks = Csv::splitIntoChunks(body, chunkCount);
+		partials.assign(chunks.size(), GroupByTable(valueIndices.size()));
+
+		pool.parallelFor(chunks.size(), [&](size_t chunk) {
+			std::vector<std::string_view> fields;
+			auto& table = partials[chunk];
+			Csv::forEachLine(chunks[chunk], [&](std::string_view line) {
+				Csv::splitFields(line, fields);
+				size_t entry = table.addRow(Csv::fieldAt(fields, keyIndex));
+				auto aggregates = table.getAggregates(entry);
+				for (size_t column = 0; column < valueIndices.size(); column++) {
+					double value;
+					if (Csv::parseNumber(Csv::fieldAt(fields, valueIndices[column]), value)) {
+						aggregates[column].add(value);
+					}
+				}
+			});
+		});
+		return keyIndex;
+	}
+
+	static void render(const GroupByTable& table, std::string_view keyName, const std::vector<size_t>& valueIndices,
+		const std::vector<std::string_view>& header, std::string& result) {
+		static const char* suffixes[] = { "_sum", "_count", "_min", "_max", "_mean" };
+		Csv::appendField(result, keyName);
+		result += ",rows";
+		for (auto column : valueIndices) {
+			for (auto suffix : suffixes) {
+				result += ',';
+				result.append(header[column].data(), header[column].size());
+				result += suffix;
+			}
+		}
+		result += '\n';
+
+		for (size_t entry = 0; entry < table.size(); entry++) {
+			Csv::appendField(result, table.getKey(entry));
+			result += ',';
+			Csv::appendNumber(result, double(table.getRowCount(entry)));
+			auto aggregates = table.getAggregates(entry);
+			for (size_t column = 0; column < valueIndices.size(); column++) {
+				const auto& aggregate = aggregates[column];
+				result += ',';
+				Csv::appendNumber(result, aggregate.sum);
+				result += ',';
+				Csv::appendNumber(result, double(aggregate.count));
+				result += ',';
+				if (aggregate.count != 0) Csv::appendNumber(result, aggregate.min);
+				result += ',';
+				if (aggregate.count != 0) Csv::appendNumber(result, aggregate.max);
+				result += ',';
+				Csv::appendNumber(result, aggregate.mean());
+			}
+			result += '\n';
+		}
+	}
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <limits>
+#include <deque>
+
+#include "Csv.h"
+
+// Sum, count, min and max of the numeric values of one column; the mean is derived from them
+struct ColumnAggregate {
+	double sum = 0.0;
+	uint64_t count = 0;
+	double min = std::numeric_limits<double>::infinity();
+	double max = -std::numeric_limits<double>::infinity();
+
+	void add(double value) noexcept {
+		sum += value;
+		count++;
+		if (value < min) min = value;
+		if (value > max) max = value;
+	}
+	void merge(const ColumnAggregate& other) noexcept {
+		sum += other.sum;
+		count += other.count;
+		if (other.min < min) min = other.min;
+		if (other.max > max) max = other.max;
+	}
+	double mean() const noexcept {
+		return count == 0 ? 0.0 : sum / double(count);
+	}
+};
+
+/**
+ * Open addressing hash table from a key to one ColumnAggregate per value column.
+ *
+ * Slots only hold the full hash and an entry index, so probing (linear, load factor <= 1/2)
+ * touches a compact array; keys and aggregates live in dense arrays in insertion order. Keys are
+ * views into the scanned text, which must outlive the table.
+ */
+class GroupByTable {
+public:
+	explicit GroupByTable(size_t valueColumns, size_t expectedKeys = 64) : m_valueColumns(valueColumns) {
+		size_t capacity = 16;
+		while (capacity < expectedKeys * 2) capacity <<= 1;
+		m_slots.assign(capacity, Slot{ 0, EmptySlot });
+	}
+
+	size_t size() const noexcept {
+		return m_keys.size();
+	}
+	std::string_view getKey(size_t entry) const noexcept {
+		return m_keys[entry];
+	}
+	// The value column aggregates of an entry, valueColumns of them
+	ColumnAggregate* getAggregates(size_t entry) noexcept {
+		return &m_aggregates[entry * m_valueColumns];
+	}
+	const ColumnAggregate* getAggregates(size_t entry) const noexcept {
+		return &m_aggregates[entry * m_valueColumns];
+	}
+	uint64_t getRowCount(size_t entry) const noexcept {
+		return m_rowCounts[entry];
+	}
+
+	// Returns the entry of key, inserting an empty one when it is new, and counts one row for it
+	size_t addRow(std::string_view key) {
+		size_t entry = findOrInsert(key, hashKey(key));
+		m_rowCounts[entry]++;
+		return entry;
+	}
+
+	// Folds the aggregates of another table in; keys new to this table are appended in the other table's order
+	void merge(const GroupByTable& other) {
+		mergeEntries(other, nullptr);
+	}
+	// Same, copying the keys new to this table into keyStorage so the text of other can go away
+	void merge(const GroupByTable& other, std::deque<std::string>& keyStorage) {
+		mergeEntries(other, &keyStorage);
+	}
+
+private:
+	static constexpr uint32_t EmptySlot = std::numeric_limits<uint32_t>::max();
+
+	struct Slot {
+		uint64_t hash;
+		uint32_t entry;
+	};
+
+	size_t m_valueColumns;
+	std::vector<Slot> m_slots;
+	std::vector<std::string_view> m_keys;
+	std::vector<uint64_t> m_hashes;
+	std::vector<uint64_t> m_rowCounts;
+	std::vector<ColumnAggregate> m_aggregates;
+
+	void mergeEntries(const GroupByTable& other, std::deque<std::string>* keyStorage) {
+		for (size_t entry = 0; entry < other.size(); entry++) {
+			const size_t keyCount = m_keys.size();
+			size_t target = findOrInsert(other.m_keys[entry], other.m_hashes[entry]);
+			if (keyStorage != nullptr && m_keys.size() > keyCount) {
+				keyStorage->emplace_back(other.m_keys[entry]);
+				m_keys[target] = keyStorage->back();
+			}
+			m_rowCounts[target] += other.m_rowCounts[entry];
+			auto destination = getAggregates(target);
+			auto source = other.getAggregates(entry);
+			for (size_t column = 0; column < m_valueColumns; column++) {
+				destination[column].merge(source[column]);
+			}
+		}
+	}
+
+	size_t findOrInsert(std::string_view key, uint64_t hash) {
+		size_t mask = m_slots.size() - 1;
+		for (size_t position = hash & mask;; position = (position + 1) & mask) {
+			Slot& slot = m_slots[position];
+			if (slot.entry == EmptySlot) {
+				slot.hash = hash;
+				slot.entry = uint32_t(m_keys.size());
+				m_keys.push_back(key);
+				m_hashes.push_back(hash);
+				m_rowCounts.push_back(0);
+				m_aggregates.resize(m_aggregates.size() + m_valueColumns);
+				if (m_keys.size() * 2 > m_slots.size()) grow();
+				return m_keys.size() - 1;
+			}
+			if (slot.hash == hash && m_keys[slot.entry] == key) {
+				return slot.entry;
+			}
+		}
+	}
+
+	void grow() {
+		std::vector<Slot> slots(m_slots.size() * 2, Slot{ 0, EmptySlot });
+		size_t mask = slots.size() - 1;
+		for (const auto& slot : m_slots) {
+			if (slot.entry == EmptySlot) continue;
+			size_t position = slot.hash & mask;
+			while (slots[position].entry != EmptySlot) position = (position + 1) & mask;
+			slots[position] = slot;
+		}
+		m_slots.swap(slots);
+	}
+};
@@ -0,0 +1,184 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <algorithm>
+
+#include "Node.h"
+#include "filesystem.h"
+
+/**
+ * Reads the files of a flow's FileInput nodes on a background thread while the flow runs, so a
+ * file is already in memory when the execution reaches its node instead of being read then.
+ *
+ * Files are read in the order their nodes execute, as long as their total size stays within the
+ * memory budget; the files past the budget are only announced to the system so its cache warms up.
+ * Taking a file's content frees its share of the budget for the next files. cancel, also run by the
+ * destructor when a run aborts, stops the reads and drops whatever was not taken.
+ */
+class InputPrefetcher {
+public:
+	static constexpr size_t DefaultMemoryBudget = size_t(256) << 20;
+
+	explicit InputPrefetcher(size_t memoryBudget = DefaultMemoryBudget) : m_budget(memoryBudget) {}
+	InputPrefetcher(const InputPrefetcher&) = delete;
+	InputPrefetcher& operator=(const InputPrefetcher&) = delete;
+
+	~InputPrefetcher() {
+		cancel();
+	}
+
+	// Starts reading the files of the FileInput nodes among nodes, given in execution order
+	void start(const std::vector<Node*>& nodes) {
+		auto fileSystem = FileSystem::getInstance();
+		for (auto node : nodes) {
+			if (node->getType() != NodeType::FileInput) continue;
+			auto& input = static_cast<FileInputNode&>(*node);
+			std::shared_ptr<FileHandle> handle;
+			try {
+				handle = fileSystem->getFileHandle(input.getFileName(), FileHandle::parseExtension(input.getExtension()));
+			}
+			catch (const InvalidHandle&) {
+				// the node reports it when it runs
+			}
+			if (handle == nullptr) continue;
+			if (auto existing = find(input)) {
+				existing->uses++;
+				continue;
+			}
+			auto entry = std::make_unique<Entry>();
+			entry->fileName = input.getFileName();
+			entry->extension = input.getExtension();
+			entry->handle = handle;
+			entry->size = fileSystem->getInputFileSize(handle.get());
+			m_entries.push_back(std::move(entry));
+		}
+		if (!m_entries.empty()) {
+			m_worker = std::thread([this]() { prefetch(); });
+		}
+	}
+
+	/**
+	 * Hands over the content read for the node's file, waiting for a read in progress.
+	 * @return false when the file was not prefetched, the caller then reads it itself.
+	 */
+	bool take(const FileInputNode& node, std::string& content) {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		Entry* entry = find(node);
+		if (entry == nullptr) return false;
+		if (entry->state == State::Queued) {
+			// reading it here costs no more than waiting for the worker to get to it
+			entry->state = State::Skipped;
+			lock.unlock();
+			m_changed.notify_all();
+			return false;
+		}
+		m_changed.wait(lock, [entry]() { return entry->state != State::Reading; });
+		if (entry->state != State::Ready) return false;
+		if (--entry->uses != 0) {
+			content = entry->content;
+			return true;
+		}
+		content = std::move(entry->content);
+		entry->state = State::Taken;
+		m_used -= size_t(entry->size);
+		lock.unlock();
+		m_changed.notify_all();
+		return true;
+	}
+
+	// Stops the reads and drops what was read, the nodes then read their own files
+	void cancel() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_cancelled.store(true, std::memory_order_relaxed);
+		}
+		m_changed.notify_all();
+		if (m_worker.joinable()) {
+			m_worker.join();
+		}
+		m_entries.clear();
+	}
+
+private:
+	enum class State {
+		Queued,
+		Reading,
+		Ready,
+		Taken,
+		// announced only, or claimed by its node before the worker got to it
+		Skipped,
+		Failed
+	};
+
+	struct Entry {
+		std::string fileName;
+		std::string extension;
+		std::shared_ptr<FileHandle> handle;
+		long long size = -1;
+		// nodes of the flow reading this file
+		size_t uses = 1;
+		State state = State::Queued;
+		std::string content;
+	};
+
+	size_t m_budget;
+	size_t m_used = 0;
+	std::vector<std::unique_ptr<Entry>> m_entries;
+	std::mutex m_mutex;
+	std::condition_variable m_changed;
+	std::atomic<bool> m_cancelled{ false };
+	std::thread m_worker;
+
+	Entry* find(const FileInputNode& node) {
+		for (auto& entry : m_entries) {
+			if (entry->fileName == node.getFileName() && entry->extension == node.getExtension()) {
+				return entry.get();
+			}
+		}
+		return nullptr;
+	}
+
+	void prefetch() {
+		auto fileSystem = FileSystem::getInstance();
+		// files past the budget are announced first, so the system works on them in the meantime
+		for (auto& entry : m_entries) {
+			if (entry->size < 0 || size_t(entry->size) > m_budget) {
+				fileSystem->adviseWillNeed(entry->handle.get());
+			}
+		}
+		for (auto& entry : m_entries) {
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (entry->state != State::Queued) continue;
+			if (entry->size < 0 || size_t(entry->size) > m_budget) {
+				entry->state = State::Skipped;
+				continue;
+			}
+			// a file fitting the budget waits for taken files to free their share
+			m_changed.wait(lock, [this, &entry]() {
+				return m_cancelled.load(std::memory_order_relaxed) || entry->state != State::Queued || m_used + size_t(entry->size) <= m_budget;
+			});
+			if (m_cancelled.load(std::memory_order_relaxed)) return;
+			if (entry->state != State::Queued) continue;
+			entry->state = State::Reading;
+			m_used += size_t(entry->size);
+			lock.unlock();
+
+			std::string content;
+			bool succeeded = fileSystem->readInputFile(entry->handle.get(), content, m_cancelled);
+
+			lock.lock();
+			entry->content = std::move(content);
+			entry->state = succeeded ? State::Ready : State::Failed;
+			if (!succeeded) {
+				m_used -= size_t(entry->size);
+			}
+			lock.unlock();
+			m_changed.notify_all();
+		}
+	}
+};
@@ -0,0 +1,302 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <map>
+#include <array>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <algorithm>
+#include <tuple>
+
+#include "InputHandler.h"
+
+enum class JobPriority {
+	Interactive,
+	Normal,
+	Batch
+};
+
+inline std::string jobPriorityToString(JobPriority priority) {
+	switch (priority) {
+	case JobPriority::Interactive:
+		return "Interactive";
+	case JobPriority::Normal:
+		return "Normal";
+	case JobPriority::Batch:
+		return "Batch";
+	default:
+		return "UnknownPriority";
+	}
+}
+
+struct JobOptions {
+	std::string tenant = "default";
+	JobPriority priority = JobPriority::Normal;
+	// time allowed from submission to start, none when zero
+	std::chrono::milliseconds deadline{ 0 };
+};
+
+struct JobMetrics {
+	static constexpr size_t PriorityCount = 3;
+
+	size_t queued = 0;
+	std::array<size_t, PriorityCount> queuedByPriority{};
+	size_t running = 0;
+	uint64_t completed = 0;
+	uint64_t failed = 0;
+	// jobs that started after their deadline
+	uint64_t missedDeadlines = 0;
+	// time from submission to start of the started jobs, in milliseconds
+	double averageWait = 0.0;
+	double maxWait = 0.0;
+	std::array<double, PriorityCount> averageWaitByPriority{};
+};
+
+/**
+ * Runs submitted jobs on a fixed number of worker threads, picking the next job by :
+ *
+ *  1. urgency : a job whose deadline is closer than UrgencyWindow, or already passed, goes first;
+ *  2. priority : Interactive before Normal before Batch, a waiting job climbing one priority every
+ *     AgingInterval so batch jobs are delayed but never starved;
+ *  3. tenant fairness : between tenants with jobs at the same level, the one served the least;
+ *  4. the earliest deadline, then the order of submission.
+ *
+ * Tenants are scanned at each dispatch, which suits the handful a FlowController has; the jobs of
+ * one tenant and priority are kept in submission order, the age of the oldest one driving the aging,
+ * with a heap ordered by deadline alongside. Once aged, the oldest job is the one taken, so a job
+ * without deadline is not held back by the deadline jobs submitted after it.
+ */
+class JobScheduler {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static constexpr std::chrono::milliseconds AgingInterval{ 5000 };
+	static constexpr std::chrono::milliseconds UrgencyWindow{ 250 };
+
+	/**
+	 * @param maxQueued Jobs waiting at once, submit refusing more.
+	 */
+	explicit JobScheduler(size_t workerCount = std::max<size_t>(1, std::thread::hardware_concurrency()), size_t maxQueued = 4096)
+		: m_maxQueued(maxQueued) {
+		for (size_t index = 0; index < std::max<size_t>(1, workerCount); index++) {
+			m_workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+	JobScheduler(const JobScheduler&) = delete;
+	JobScheduler& operator=(const JobScheduler&) = delete;
+
+	// Drops the jobs still queued and waits for the running ones
+	~JobScheduler() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_available.notify_all();
+		for (auto& worker : m_workers) {
+			worker.join();
+		}
+	}
+
+	/**
+	 * Queues a job. An exception thrown by the job is counted as a failure in the metrics.
+	 * @throws InvalidInput if the queue is full.
+	 */
+	void submit(const JobOptions& options, std::function<void()>&& work) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_queued >= m_maxQueued) {
+				throw InvalidInput("The job queue is full");
+			}
+			const auto now = Clock::now();
+			auto& tenant = m_tenants[options.tenant];
+			if (tenant.queued == 0) {
+				// a tenant coming back does not get credit for the time it had nothing queued
+				tenant.served = std::max(tenant.served, m_virtualTime);
+			}
+			auto& queue = tenant.queues[size_t(options.priority)];
+			const auto deadline = options.deadline.count() > 0 ? now + options.deadline : Clock::time_point::max();
+			const uint64_t sequence = m_sequence++;
+			queue.byDeadline.push_back(Pending{ deadline, sequence });
+			std::push_heap(queue.byDeadline.begin(), queue.byDeadline.end(), later);
+			queue.jobs.emplace(sequence, Job{ std::move(work), now, deadline, sequence });
+			tenant.queued++;
+			m_queued++;
+			m_queuedByPriority[size_t(options.priority)]++;
+		}
+		m_available.notify_one();
+	}
+
+	// Blocks until no job is queued or running
+	void waitIdle() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle.wait(lock, [this]() { return m_queued == 0 && m_running == 0; });
+	}
+
+	JobMetrics getMetrics() const {
+		std::lock_guard<std::mutex> lock(m_mutex);
+		JobMetrics metrics;
+		metrics.queued = m_queued;
+		metrics.queuedByPriority = m_queuedByPriority;
+		metrics.running = m_running;
+		metrics.completed = m_completed;
+		metrics.failed = m_failed;
+		metrics.missedDeadlines = m_missedDeadlines;
+		uint64_t started = 0;
+		double totalWait = 0.0;
+		for (size_t priority = 0; priority < JobMetrics::PriorityCount; priority++) {
+			started += m_startedByPriority[priority];
+			totalWait += m_waitByPriority[priority];
+			if (m_startedByPriority[priority] != 0) {
+				metrics.averageWaitByPriority[priority] = m_waitByPriority[priority] / double(m_startedByPriority[priority]);
+			}
+		}
+		metrics.averageWait = started == 0 ? 0.0 : totalWait / double(started);
+		metrics.maxWait = m_maxWait;
+		return metrics;
+	}
+
+private:
+	struct Job {
+		std::function<void()> work;
+		Clock::time_point submitted;
+		Clock::time_point deadline;
+		uint64_t sequence;
+	};
+
+	struct Pending {
+		Clock::time_point deadline;
+		uint64_t sequence;
+	};
+
+	// The jobs by sequence, so the first is the oldest, and a heap of their deadlines which may
+	// still hold jobs already taken in submission order, dropped once they reach its top
+	struct Queue {
+		std::map<uint64_t, Job> jobs;
+		std::vector<Pending> byDeadline;
+	};
+
+	struct Tenant {
+		std::array<Queue, JobMetrics::PriorityCount> queues;
+		size_t queued = 0;
+		uint64_t served = 0;
+	};
+
+	std::vector<std::thread> m_workers;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_available;
+	std::condition_variable m_idle;
+	std::unordered_map<std::string, Tenant> m_tenants;
+	size_t m_maxQueued;
+	size_t m_queued = 0;
+	std::array<size_t, JobMetrics::PriorityCount> m_queuedByPriority{};
+	size_t m_running = 0;
+	uint64_t m_sequence = 0;
+	uint64_t m_virtualTime = 0;
+	uint64_t m_completed = 0;
+	uint64_t m_failed = 0;
+	uint64_t m_missedDeadlines = 0;
+	std::array<uint64_t, JobMetrics::PriorityCount> m_startedByPriority{};
+	std::array<double, JobMetrics::PriorityCount> m_waitByPriority{};
+	double m_maxWait = 0.0;
+	bool m_stopping = false;
+
+	// Heap order : the earliest deadline, then the first submitted, on top
+	static bool later(const Pending& lhs, const Pending& rhs) noexcept {
+		return std::tie(lhs.deadline, lhs.sequence) > std::tie(rhs.deadline, rhs.sequence);
+	}
+
+	// The queued job with the earliest deadline, the queue must not be empty
+	static std::map<uint64_t, Job>::iterator earliestDeadline(Queue& queue) {
+		while (true) {
+			auto found = queue.jobs.find(queue.byDeadline.front().sequence);
+			if (found != queue.jobs.end()) return found;
+			std::pop_heap(queue.byDeadline.begin(), queue.byDeadline.end(), later);
+			queue.byDeadline.pop_back();
+		}
+	}
+
+	// Removes the job to run next, m_queued must not be 0
+	Job takeNext(Clock::time_point now, size_t& priorityTaken) {
+		typedef std::tuple<int64_t, uint64_t, Clock::time_point, uint64_t> Rank;
+		Tenant* bestTenant = nullptr;
+		size_t bestPriority = 0;
+		std::map<uint64_t, Job>::iterator bestJob;
+		Rank best;
+		for (auto& entry : m_tenants) {
+			auto& tenant = entry.second;
+			for (size_t priority = 0; priority < JobMetrics::PriorityCount && tenant.queued != 0; priority++) {
+				auto& queue = tenant.queues[priority];
+				if (queue.jobs.empty()) continue;
+				auto candidate = earliestDeadline(queue);
+				int64_t level;
+				if (candidate->second.deadline != Clock::time_point::max() && candidate->second.deadline - now <= UrgencyWindow) {
+					level = 0;
+				}
+				else {
+					const auto oldest = queue.jobs.begin();
+					const int64_t aged = int64_t((now - oldest->second.submitted) / AgingInterval);
+					level = 1 + std::max<int64_t>(0, int64_t(priority) - aged);
+					if (aged > 0 && priority > 0) candidate = oldest;
+				}
+				const Job& head = candidate->second;
+				Rank rank(level, tenant.served, head.deadline, head.sequence);
+				if (bestTenant == nullptr || rank < best) {
+					best = rank;
+					bestTenant = &tenant;
+					bestPriority = priority;
+					bestJob = candidate;
+				}
+			}
+		}
+
+		auto& queue = bestTenant->queues[bestPriority];
+		Job job = std::move(bestJob->second);
+		queue.jobs.erase(bestJob);
+		if (queue.jobs.empty()) queue.byDeadline.clear();
+		bestTenant->queued--;
+		m_virtualTime = bestTenant->served++;
+		m_queued--;
+		m_queuedByPriority[bestPriority]--;
+		priorityTaken = bestPriority;
+		return job;
+	}
+
+	void workerLoop() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true) {
+			m_available.wait(lock, [this]() { return m_stopping || m_queued != 0; });
+			if (m_stopping) return;
+
+			const auto now = Clock::now();
+			size_t priority;
+			Job job = takeNext(now, priority);
+			const double wait = std::chrono::duration<double, std::milli>(now - job.submitted).count();
+			m_startedByPriority[priority]++;
+			m_waitByPriority[priority] += wait;
+			m_maxWait = std::max(m_maxWait, wait);
+			if (now > job.deadline) m_missedDeadlines++;
+			m_running++;
+
+			lock.unlock();
+			bool succeeded = true;
+			try {
+				job.work();
+			}
+			catch (...) {
+				succeeded = false;
+			}
+			job.work = nullptr;
+			lock.lock();
+
+			m_running--;
+			succeeded ? m_completed++ : m_failed++;
+			if (m_queued == 0 && m_running == 0) {
+				m_idle.notify_all();
+			}
+		}
+	}
+};
@@ -0,0 +1,289 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <limits>
+
+#include "Csv.h"
+#include "Parallel.h"
+
+enum class JoinKind {
+	Inner,
+	Left
+};
+
+inline std::string joinKindToString(JoinKind kind) {
+	switch (kind) {
+	case JoinKind::Inner:
+		return "Inner";
+	case JoinKind::Left:
+		return "Left";
+	default:
+		return "UnknownJoin";
+	}
+}
+
+/**
+ * Hash join of two CSV inputs (header line first) on one key column of each.
+ *
+ * The build input is indexed in a hash table split into partitions by the high bits of the key
+ * hash. Large build inputs are scanned in line aligned chunks on the shared ThreadPool and every
+ * partition is then filled by a single thread, so no locks are needed and the rows of a key stay
+ * in input order. The probe input is fed in blocks of complete lines and never has to be in memory
+ * as a whole.
+ *
+ * Output : the left header and rows as they are, followed by the right columns except the right
+ * key. Rows follow the probe order and a probe row yields one row per match, in build order. In a
+ * left join the left rows without a match get empty right columns; when the left input is the
+ * build side they are appended after the probed rows.
+ *
+ * Build rows are views into the build text, which must stay alive until the join finished.
+ */
+class HashJoiner {
+public:
+	// Inputs below this size are built and probed on the calling thread
+	static constexpr size_t ParallelThreshold = 1 << 20;
+
+	HashJoiner(JoinKind kind, std::string leftKey, std::string rightKey)
+		: m_kind(kind), m_leftKey(std::move(leftKey)), m_rightKey(std::move(rightKey)) {}
+
+	// Storage for a build input that has to be read first, its capacity is kept between joins
+	std::string& getBuildBuffer() noexcept {
+		return m_buildBuffer;
+	}
+
+	/**
+	 * Indexes the build input.
+	 * @param buildIsLeft Whether the text is the left input of the join.
+	 * @throws InvalidInput if the key column is not in the header.
+	 */
+	void build(std::string_view text, bool buildIsLeft) {
+		m_buildIsLeft = buildIsLeft;
+		m_probeColumnCount = 0;
+		std::string_view body;
+		m_buildHeader = Csv::splitHeader(text, body);
+		Csv::splitFields(m_buildHeader, m_fields);
+		m_buildKeyIndex = Csv::findColumn(m_fields, buildIsLeft ? m_leftKey : m_rightKey);
+		m_buildColumnCount = m_fields.size();
+
+		auto& pool = ThreadPool::getInstance();
+		bool parallel = body.size() >= ParallelThreshold;
+		size_t partitionCount = 1;
+		m_partitionShift = 64;
+		if (parallel) {
+			while (partitionCount < pool.getThreadCount() + 1) {
+				partitionCount <<= 1;
+				m_partitionShift--;
+			}
+		}
+		auto chunks = Csv::splitIntoChunks(body, parallel ? pool.getThreadCount() + 1 : 1);
+
+		// every chunk sorts its rows into partitions, then every partition gathers its rows chunk by chunk
+		m_scattered.resize(chunks.size());
+		for (auto& partitions : m_scattered) {
+			partitions.resize(partitionCount);
+			for (auto& rows : partitions) rows.clear();
+		}
+		pool.parallelFor(chunks.size(), [&](size_t chunk) {
+			std::vector<std::string_view> fields;
+			auto& partitions = m_scattered[chunk];
+			Csv::forEachLine(chunks[chunk], [&](std::string_view line) {
+				Csv::splitFields(line, fields);
+				auto key = Csv::fieldAt(fields, m_buildKeyIndex);
+				uint64_t hash = hashKey(key);
+				partitions[partitionOf(hash)].push_back(BuildRow{ hash, key, line, NoRow });
+			});
+		});
+
+		m_partitions.resize(partitionCount);
+		pool.parallelFor(partitionCount, [&](size_t index) {
+			auto& partition = m_partitions[index];
+			partition.rows.clear();
+			for (auto& partitions : m_scattered) {
+				partition.rows.insert(partition.rows.end(), partitions[index].begin(), partitions[index].end());
+			}
+			partition.index();
+			partition.matched.assign(needsMatches() ? partition.rows.size() : 0, 0);
+		});
+	}
+
+	// Reads the header line of the probe input and writes the output header
+	void beginProbe(std::string_view headerLine, std::string& result) {
+		m_probeHeader = Csv::trimLineEnd(headerLine);
+		Csv::splitFields(m_probeHeader, m_fields);
+		m_probeKeyIndex = Csv::findColumn(m_fields, m_buildIsLeft ? m_rightKey : m_leftKey);
+		m_probeColumnCount = m_fields.size();
+		if (m_buildIsLeft) {
+			appendRow(m_buildHeader, m_probeHeader, m_probeKeyIndex, m_probeColumnCount, m_fields, result);
+		}
+		else {
+			appendRow(m_probeHeader, m_buildHeader, m_buildKeyIndex, m_buildColumnCount, m_fields, result);
+		}
+	}
+
+	// Joins a run of complete probe lines, appending the output rows
+	void probe(std::string_view lines, std::string& result) {
+		probeLines(lines, m_fields, result);
+	}
+
+	// Joins a probe input held in memory, header included; large inputs are probed in parallel chunks
+	void probeAll(std::string_view text, std::string& result) {
+		std::string_view body;
+		beginProbe(Csv::splitHeader(text, body), result);
+		auto& pool = ThreadPool::getInstance();
+		// matches of a left build side are flagged while probing, which keeps that case on one thread
+		if (body.size() < ParallelThreshold || needsMatches()) {
+			probe(body, result);
+			return;
+		}
+		auto chunks = Csv::splitIntoChunks(body, pool.getThreadCount() + 1);
+		m_chunkResults.resize(chunks.size());
+		pool.parallelFor(chunks.size(), [&](size_t chunk) {
+			std::vector<std::string_view> fields;
+			m_chunkResults[chunk].clear();
+			probeLines(chunks[chunk], fields, m_chunkResults[chunk]);
+		});
+		for (const auto& chunkResult : m_chunkResults) {
+			result += chunkResult;
+		}
+	}
+
+	// Appends the unmatched left rows of a left join whose left input was the build side
+	void finish(std::string& result) {
+		if (!needsMatches()) return;
+		m_unmatched.clear();
+		for (const auto& partition : m_partitions) {
+			for (size_t row = 0; row < partition.rows.size(); row++) {
+				if (!partition.matched[row]) m_unmatched.push_back(partition.rows[row].line);
+			}
+		}
+		// partitions scatter the rows, the views point into one buffer so their address is the input order
+		std::sort(m_unmatched.begin(), m_unmatched.end(), [](std::string_view a, std::string_view b) {
+			return a.data() < b.data();
+		});
+		for (auto line : m_unmatched) {
+			appendRow(line, std::string_view(), m_probeKeyIndex, m_probeColumnCount, m_fields, result);
+		}
+	}
+
+private:
+	static constexpr uint32_t NoRow = std::numeric_limits<uint32_t>::max();
+
+	struct BuildRow {
+		uint64_t hash;
+		std::string_view key;
+		std::string_view line;
+		// next row with the same key
+		uint32_t next;
+	};
+
+	// Open addressing table over the rows of one partition; a slot chains the rows of one key
+	struct Partition {
+		struct Slot {
+			uint64_t hash;
+			uint32_t head;
+			uint32_t tail;
+		};
+		std::vector<BuildRow> rows;
+		std::vector<Slot> slots;
+		std::vector<uint8_t> matched;
+
+		void index() {
+			size_t capacity = 16;
+			while (capacity < rows.size() * 2) capacity <<= 1;
+			slots.assign(capacity, Slot{ 0, NoRow, NoRow });
+			for (uint32_t row = 0; row < rows.size(); row++) {
+				Slot& slot = find(rows[row].hash, rows[row].key);
+				if (slot.head == NoRow) {
+					slot.hash = rows[row].hash;
+					slot.head = row;
+				}
+				else {
+					rows[slot.tail].next = row;
+				}
+				slot.tail = row;
+			}
+		}
+		// The slot of key, or the empty slot where it would go
+		Slot& find(uint64_t hash, std::string_view key) {
+			size_t mask = slots.size() - 1;
+			for (size_t position = hash & mask;; position = (position + 1) & mask) {
+				Slot& slot = slots[position];
+				if (slot.head == NoRow || (slot.hash == hash && rows[slot.head].key == key)) {
+					return slot;
+				}
+			}
+		}
+	};
+
+	JoinKind m_kind;
+	std::string m_leftKey;
+	std::string m_rightKey;
+	bool m_buildIsLeft = false;
+	std::string m_buildBuffer;
+	std::string_view m_buildHeader;
+	std::string_view m_probeHeader;
+	size_t m_buildKeyIndex = 0;
+	size_t m_buildColumnCount = 0;
+	size_t m_probeKeyIndex = 0;
+	size_t m_probeColumnCount = 0;
+	unsigned m_partitionShift = 64;
+	std::vector<Partition> m_partitions;
+	std::vector<std::vector<std::vector<BuildRow>>> m_scattered;
+	std::vector<std::string_view> m_fields;
+	std::vector<std::string> m_chunkResults;
+	std::vector<std::string_view> m_unmatched;
+
+	bool needsMatches() const noexcept {
+		return m_kind == JoinKind::Left && m_buildIsLeft;
+	}
+
+	size_t partitionOf(uint64_t hash) const noexcept {
+		return m_partitionShift == 64 ? 0 : size_t(hash >> m_partitionShift);
+	}
+
+	void probeLines(std::string_view lines, std::vector<std::string_view>& fields, std::string& result) {
+		Csv::forEachLine(lines, [&](std::string_view line) {
+			Csv::splitFields(line, fields);
+			auto key = Csv::fieldAt(fields, m_probeKeyIndex);
+			uint64_t hash = hashKey(key);
+			auto& partition = m_partitions[partitionOf(hash)];
+			const auto& slot = partition.find(hash, key);
+			if (slot.head == NoRow) {
+				if (m_kind == JoinKind::Left && !m_buildIsLeft) {
+					appendRow(line, std::string_view(), m_buildKeyIndex, m_buildColumnCount, fields, result);
+				}
+				return;
+			}
+			for (uint32_t row = slot.head; row != NoRow; row = partition.rows[row].next) {
+				if (m_buildIsLeft) {
+					if (needsMatches()) partition.matched[row] = 1;
+					appendRow(partition.rows[row].line, line, m_probeKeyIndex, m_probeColumnCount, fields, result);
+				}
+				else {
+					appendRow(line, partition.rows[row].line, m_buildKeyIndex, m_buildColumnCount, fields, result);
+				}
+			}
+		});
+	}
+
+	// Writes the left line followed by the right columns except its key; an empty right line leaves them blank
+	static void appendRow(std::string_view left, std::string_view right, size_t rightKeyIndex, size_t rightColumnCount,
+		std::vector<std::string_view>& fields, std::string& result) {
+		result.append(left.data(), left.size());
+		if (right.empty()) {
+			for (size_t column = 1; column < rightColumnCount; column++) result += ',';
+		}
+		else {
+			Csv::splitFields(right, fields);
+			for (size_t column = 0; column < rightColumnCount; column++) {
+				if (column == rightKeyIndex) continue;
+				result += ',';
+				auto field = Csv::rawField(right, Csv::fieldAt(fields, column));
+				result.append(field.data(), field.size());
+			}
+		}
+		result += '\n';
+	}
+};
@@ -4,6 +4,16 @@
 #include <string>
 #include <memory>
 
+#include "SlidingWindow.h"
+#include "GroupBy.h"
+#include "Join.h"
+#include "Filter.h"
+#include "Sort.h"
+#include "Search.h"
+#include "Tokenizer.h"
+#include "Sketch.h"
+#include "Vector.h"
+
 #define interface struct
 
 typedef size_t NodeUid;
@@ -19,8 +29,22 @@ enum class NodeType
 	FloatCalculus,
 	StringCalculus,
 	Output,
+	WindowAggregate,
+	GroupBy,
+	HashJoin,
+	Filter,
+	Sort,
+	Search,
+	Tokenize,
+	Sketch,
+	Vector,
+	VectorCalculus,
+	VectorReduce,
 	End
 };
+// End stays the last enumerator so node types can index dense tables
+constexpr size_t NodeTypeCount = static_cast<size_t>(NodeType::End) + 1;
+
 inline std::string nodeTypeToString(NodeType type) {
 	switch (type) {
 	case NodeType::Text:
@@ -41,6 +65,28 @@ inline std::string nodeTypeToString(NodeType type) {
 		return "StringCalculus";
 	case NodeType::Output:
 		return "Output";
+	case NodeType::WindowAggregate:
+		return "WindowAggregate";
+	case NodeType::GroupBy:
+		return "GroupBy";
+	case NodeType::HashJoin:
+		return "HashJoin";
+	case NodeType::Filter:
+		return "Filter";
+	case NodeType::Sort:
+		return "Sort";
+	case NodeType::Search:
+		return "Search";
+	case NodeType::Tokenize:
+		return "Tokenize";
+	case NodeType::Sketch:
+		return "Sketch";
+	case NodeType::Vector:
+		return "Vector";
+	case NodeType::VectorCalculus:
+		return "VectorCalculus";
+	case NodeType::VectorReduce:
+		return "VectorReduce";
 	case NodeType::End:
 		return "End";
 	default:
@@ -48,6 +94,40 @@ inline std::string nodeTypeToString(NodeType type) {
 	}
 }
 
+// Node types whose value is a number that FloatCalculus nodes can consume
+inline bool isNumericNodeType(NodeType type) {
+	return type == NodeType::NumberInput || type == NodeType::FloatCalculus || type == NodeType::WindowAggregate || type == NodeType::VectorReduce;
+}
+
+// Node types whose value is a NumberVector that VectorCalculus and VectorReduce nodes can consume
+inline bool isVectorNodeType(NodeType type) {
+	return type == NodeType::Vector || type == NodeType::VectorCalculus;
+}
+
+// Node types whose results over a text are their results over its parts, one after the other
+inline bool isRowLocalNodeType(NodeType type) {
+	switch (type) {
+	case NodeType::TextInput:
+	case NodeType::FileInput:
+	case NodeType::NumberInput:
+	case NodeType::Text:
+	case NodeType::Title:
+	case NodeType::Filter:
+	case NodeType::Vector:
+	case NodeType::Display:
+	case NodeType::Output:
+	case NodeType::End:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Node types whose value is text that CSV consuming nodes can read
+inline bool isTextNodeType(NodeType type) {
+	return type == NodeType::TextInput || type == NodeType::FileInput || type == NodeType::StringCalculus || type == NodeType::GroupBy || type == NodeType::HashJoin || type == NodeType::Filter || type == NodeType::Sort || type == NodeType::Search || type == NodeType::Tokenize || type == NodeType::Sketch;
+}
+
 enum class PrimitiveType {
 
 	Char,
@@ -55,6 +135,7 @@ enum class PrimitiveType {
 	Float,
 	Double,
 	String,
+	Vector,
 	Unknown
 };
 
@@ -67,6 +148,14 @@ enum class OperationType {
 	Max
 };
 
+// How FloatCalculus nodes add numbers, see Calculation
+enum class SummationMode {
+	// left to right, or in a fixed tree of blocks for very wide nodes
+	Plain,
+	// compensated (Kahan-Neumaier) sums per block, blocks added pairwise
+	Compensated
+};
+
 interface Displayable {
 	virtual  std::string getContent() const noexcept = 0;
 };
@@ -90,6 +179,17 @@ class OutputNode;
 class DisplayNode;
 class FileInputNode;
 class TitleNode;
+class WindowAggregateNode;
+class GroupByNode;
+class HashJoinNode;
+class FilterNode;
+class SortNode;
+class SearchNode;
+class TokenizeNode;
+class SketchNode;
+class VectorNode;
+class VectorCalculusNode;
+class VectorReduceNode;
 class EndNode;
 // Visitor base class
 interface NodeVisitor {
@@ -103,18 +203,35 @@ interface NodeVisitor {
 	virtual void visit(DisplayNode& node) = 0;
 	virtual void visit(FileInputNode& node) = 0;
 	virtual void visit(TitleNode& node) = 0;
+	virtual void visit(WindowAggregateNode& node) = 0;
+	virtual void visit(GroupByNode& node) = 0;
+	virtual void visit(HashJoinNode& node) = 0;
+	virtual void visit(FilterNode& node) = 0;
+	virtual void visit(SortNode& node) = 0;
+	virtual void visit(SearchNode& node) = 0;
+	virtual void visit(TokenizeNode& node) = 0;
+	virtual void visit(SketchNode& node) = 0;
+	virtual void visit(VectorNode& node) = 0;
+	virtual void visit(VectorCalculusNode& node) = 0;
+	virtual void visit(VectorReduceNode& node) = 0;
 	virtual void visit(EndNode& node) = 0;
 };
 
 class Node {
 public:
 	Node(NodeUid uid , NodeType type) : m_uid(uid), m_type(type){};
+	virtual ~Node() = default;
 	NodeUid getUid() const noexcept {
 		return m_uid;
 	}
 	NodeType getType() const noexcept {
 		return m_type;
 	}
+	// Nodes without inputs have no dependencies
+	virtual const std::vector<NodeUid>& getDependencies() const noexcept {
+		static const std::vector<NodeUid> none;
+		return none;
+	}
 	virtual void acceptVisitor(NodeVisitor& visitor) = 0;
 private:
 	NodeUid m_uid;
@@ -196,7 +313,7 @@ private:
 
 class TitleNode : public Node, public Storable<std::pair<std::string, std::string>>, public Displayable {
 public:
-	TitleNode(NodeUid uid, std::pair<std::string, std::string>&& pair) :title(pair.first) , body(pair.second) , Node(uid, NodeType::Text) {};
+	TitleNode(NodeUid uid, std::pair<std::string, std::string>&& pair) :title(pair.first) , body(pair.second) , Node(uid, NodeType::Title) {};
 
 	const std::pair<std::string, std::string>& getBuffer() const noexcept override {
 		return { title , body };
@@ -223,8 +340,8 @@ private:
 
 class FloatCalculusNode : public Node, public Storable<float>, public Displayable {
 public:
-	FloatCalculusNode(NodeUid uid,  OperationType operationType, std::vector<NodeUid>&& dependencies)
-		: Node(uid, NodeType::FloatCalculus), m_operationType(operationType), result(0.0f), m_dependencies(dependencies) {}
+	FloatCalculusNode(NodeUid uid,  OperationType operationType, std::vector<NodeUid>&& dependencies, SummationMode summation = SummationMode::Plain)
+		: Node(uid, NodeType::FloatCalculus), m_operationType(operationType), m_summation(summation), result(0.0f), m_dependencies(dependencies) {}
 
 	const float& getBuffer() const noexcept override {
 		return result;
@@ -237,18 +354,22 @@ public:
 	void acceptVisitor(NodeVisitor& visitor) override {
 		visitor.visit(*this);
 	}
-	const std::vector<NodeUid>& getDependencies() const noexcept {
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
 		return m_dependencies;
 	}
 	OperationType getOperationType() const noexcept {
 		return m_operationType;
 	}
+	SummationMode getSummation() const noexcept {
+		return m_summation;
+	}
 	std::string getContent() const noexcept override {
 		return std::to_string(result);
 	}
 
 private:
 	OperationType m_operationType;
+	SummationMode m_summation;
 	float result;
 	std::vector<NodeUid> m_dependencies;
 };
@@ -269,7 +390,7 @@ public:
 	void acceptVisitor(NodeVisitor& visitor) override {
 		visitor.visit(*this);
 	}
-	const std::vector<NodeUid>& getDependencies() const noexcept {
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
 		return m_dependencies;
 	}
 	OperationType getOperationType() const noexcept {
@@ -293,7 +414,7 @@ public:
 			   std::string&& title, 
 			   std::string&& description,
 			   std::vector<NodeUid>&& dependencies) : m_fileName(fileName), m_title(title), m_description(description), m_extension(extension), m_dependencies(dependencies), Node(uid, NodeType::Output) {};
-	const std::vector<NodeUid>& getDependencies() const noexcept {
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
 		return m_dependencies;
 	}
 	const char * getFileName() const noexcept {
@@ -330,7 +451,7 @@ private:
 class DisplayNode : public Node {
 public:
 	DisplayNode(NodeUid uid, std::vector<NodeUid>&& dependencies) :Node(uid, NodeType::Display), m_dependencies(dependencies) {};
-	const std::vector<NodeUid>& getDependencies() const noexcept {
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
 		return m_dependencies;
 	}
 	void acceptVisitor(NodeVisitor& visitor) override {
@@ -370,10 +491,486 @@ private:
 	std::string m_buffer;
 };
 
+/**
+ * Rolling statistic over the last N values and / or the last T seconds of a numeric stream.
+ *
+ * Every execution pushes the current value of its dependency into the window : one sample for a
+ * numeric node, every number of the text for a text node ("timestamp,value" lines carry their
+ * own time in seconds since the epoch). The window keeps its state between executions, except that
+ * a text dependency holds the whole stream, so a window reading one starts over on every execution.
+ */
+class WindowAggregateNode : public Node, public Storable<float>, public Displayable {
+public:
+	WindowAggregateNode(NodeUid uid, WindowStatistic statistic, size_t windowSize, double windowSeconds, std::vector<NodeUid>&& dependencies)
+		: Node(uid, NodeType::WindowAggregate), m_statistic(statistic), m_windowSize(windowSize), m_windowSeconds(windowSeconds),
+		  m_window(windowSize, windowSeconds), m_dependencies(dependencies) {}
+
+	const float& getBuffer() const noexcept override {
+		return m_result;
+	}
+	void setBuffer(float result) noexcept {
+		m_result = result;
+	}
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
+		return m_dependencies;
+	}
+	WindowStatistic getStatistic() const noexcept {
+		return m_statistic;
+	}
+	size_t getWindowSize() const noexcept {
+		return m_windowSize;
+	}
+	double getWindowSeconds() const noexcept {
+		return m_windowSeconds;
+	}
+	SlidingWindow& getWindow() noexcept {
+		return m_window;
+	}
+	std::string getContent() const noexcept override {
+		return std::to_string(m_result);
+	}
+	void acceptVisitor(NodeVisitor& visitor) override {
+		visitor.visit(*this);
+	}
+private:
+	WindowStatistic m_statistic;
+	size_t m_windowSize;
+	double m_windowSeconds;
+	SlidingWindow m_window;
+	float m_result = 0.0f;
+	std::vector<NodeUid> m_dependencies;
+};
+
+/**
+ * Groups the rows of a CSV input (header line first) by a key column and aggregates the value
+ * columns of every key : sum, count, min, max and mean. The result is CSV text, see GroupByAggregator.
+ */
+class GroupByNode : public Node, public Storable<std::string>, public Displayable {
+public:
+	GroupByNode(NodeUid uid, std::string&& keyColumn, std::vector<std::string>&& valueColumns, std::vector<NodeUid>&& dependencies)
+		: Node(uid, NodeType::GroupBy), m_keyColumn(keyColumn), m_valueColumns(valueColumns),
+		  m_aggregator(m_keyColumn, m_valueColumns), m_dependencies(dependencies) {}
+
+	const std::string& getBuffer() const noexcept override {
+		return m_result;
+	}
+	void setBuffer(std::string&& result) noexcept override {
+		m_result = std::move(result);
+	}
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
+		return m_dependencies;
+	}
+	const std::string& getKeyColumn() const noexcept {
+		return m_keyColumn;
+	}
+	const std::vector<std::string>& getValueColumns() const noexcept {
+		return m_valueColumns;
+	}
+	const GroupByAggregator& getAggregator() const noexcept {
+		return m_aggregator;
+	}
+	std::string getContent() const noexcept override {
+		return m_result;
+	}
+	void acceptVisitor(NodeVisitor& visitor) override {
+		visitor.visit(*this);
+	}
+private:
+	std::string m_keyColumn;
+	std::vector<std::string> m_valueColumns;
+	GroupByAggregator m_aggregator;
+	std::string m_result;
+	std::vector<NodeUid> m_dependencies;
+};
+
+/**
+ * Joins two CSV inputs, the first dependency being the left side, on a key column of each.
+ * The node only holds the join settings; the tables live in the HashJoiner of each execution.
+ */
+class HashJoinNode : public Node, public Storable<std::string>, public Displayable {
+public:
+	HashJoinNode(NodeUid uid, JoinKind kind, std::string&& leftKey, std::string&& rightKey, std::vector<NodeUid>&& dependencies)
+		: Node(uid, NodeType::HashJoin), m_kind(kind), m_leftKey(leftKey), m_rightKey(rightKey), m_dependencies(dependencies) {}
+
+	const std::string& getBuffer() const noexcept override {
+		return m_result;
+	}
+	void setBuffer(std::string&& result) noexcept override {
+		m_result = std::move(result);
+	}
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
+		return m_dependencies;
+	}
+	JoinKind getKind() const noexcept {
+		return m_kind;
+	}
+	const std::string& getLeftKey() const noexcept {
+		return m_leftKey;
+	}
+	const std::string& getRightKey() const noexcept {
+		return m_rightKey;
+	}
+	HashJoiner createJoiner() const {
+		return HashJoiner(m_kind, m_leftKey, m_rightKey);
+	}
+	std::string getContent() const noexcept override {
+		return m_result;
+	}
+	void acceptVisitor(NodeVisitor& visitor) override {
+		visitor.visit(*this);
+	}
+private:
+	JoinKind m_kind;
+	std::string m_leftKey;
+	std::string m_rightKey;
+	std::string m_result;
+	std::vector<NodeUid> m_dependencies;
+};
+
+// Keeps the header and the rows of a CSV input that match a RowFilter
+class FilterNode : public Node, public Storable<std::string>, public Displayable {
+public:
+	FilterNode(NodeUid uid, std::string&& column, FilterComparison comparison, std::string&& operand, std::vector<NodeUid>&& dependencies)
+		: Node(uid, NodeType::Filter), m_filter(std::move(column), comparison, std::move(operand)), m_dependencies(dependencies) {}
+
+	const std::string& getBuffer() const noexcept override {
+		return m_result;
+	}
+	void setBuffer(std::string&& result) noexcept override {
+		m_result = std::move(result);
+	}
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
+		return m_dependencies;
+	}
+	const RowFilter& getFilter() const noexcept {
+		return m_filter;
+	}
+	std::string getContent() const noexcept override {
+		return m_result;
+	}
+	void acceptVisitor(NodeVisitor& visitor) override {
+		visitor.visit(*this);
+	}
+private:
+	RowFilter m_filter;
+	std::string m_result;
+	std::vector<NodeUid> m_dependencies;
+};
+
+/**
+ * Orders the rows of a CSV input by one or more key columns. Inputs larger than the memory budget
+ * are sorted in runs spilled to temporary files, see ExternalSorter.
+ */
+class SortNode : public Node, public Storable<std::string>, public Displayable {
+public:
+	SortNode(NodeUid uid, std::vector<SortKey>&& keys, size_t memoryBudget, std::vector<NodeUid>&& dependencies)
+		: Node(uid, NodeType::Sort), m_keys(keys), m_memoryBudget(memoryBudget), m_dependencies(dependencies) {}
+
+	const std::string& getBuffer() const noexcept override {
+		return m_result;
+	}
+	void setBuffer(std::string&& result) noexcept override {
+		m_result = std::move(result);
+	}
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
+		return m_dependencies;
+	}
+	const std::vector<SortKey>& getKeys() const noexcept {
+		return m_keys;
+	}
+	size_t getMemoryBudget() const noexcept {
+		return m_memoryBudget;
+	}
+	ExternalSorter createSorter() const {
+		return ExternalSorter(m_keys, m_memoryBudget);
+	}
+	std::string getContent() const noexcept override {
+		return m_result;
+	}
+	void acceptVisitor(NodeVisitor& visitor) override {
+		visitor.visit(*this);
+	}
+private:
+	std::vector<SortKey> m_keys;
+	size_t m_memoryBudget;
+	std::string m_result;
+	std::vector<NodeUid> m_dependencies;
+};
+
+// Looks for many literal patterns at once in a text input, see TextSearcher for the output formats
+class SearchNode : public Node, public Storable<std::string>, public Displayable {
+public:
+	SearchNode(NodeUid uid, std::vector<std::string>&& patterns, SearchOutput output, std::vector<NodeUid>&& dependencies)
+		: Node(uid, NodeType::Search), m_searcher(std::move(patterns), output), m_dependencies(dependencies) {}
+
+	const std::string& getBuffer() const noexcept override {
+		return m_result;
+	}
+	void setBuffer(std::string&& result) noexcept override {
+		m_result = std::move(result);
+	}
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
+		return m_dependencies;
+	}
+	const TextSearcher& getSearcher() const noexcept {
+		return m_searcher;
+	}
+	std::string getContent() const noexcept override {
+		return m_result;
+	}
+	void acceptVisitor(NodeVisitor& visitor) override {
+		visitor.visit(*this);
+	}
+private:
+	TextSearcher m_searcher;
+	std::string m_result;
+	std::vector<NodeUid> m_dependencies;
+};
+
+// Splits a text input into tokens and reports them, their number or their frequencies, see TokenCounter
+class TokenizeNode : public Node, public Storable<std::string>, public Displayable {
+public:
+	TokenizeNode(NodeUid uid, std::string&& delimiters, TokenOutput output, std::vector<NodeUid>&& dependencies)
+		: Node(uid, NodeType::Tokenize), m_counter(std::move(delimiters), output), m_dependencies(dependencies) {}
+
+	const std::string& getBuffer() const noexcept override {
+		return m_result;
+	}
+	void setBuffer(std::string&& result) noexcept override {
+		m_result = std::move(result);
+	}
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
+		return m_dependencies;
+	}
+	const TokenCounter& getCounter() const noexcept {
+		return m_counter;
+	}
+	std::string getContent() const noexcept override {
+		return m_result;
+	}
+	void acceptVisitor(NodeVisitor& visitor) override {
+		visitor.visit(*this);
+	}
+private:
+	TokenCounter m_counter;
+	std::string m_result;
+	std::vector<NodeUid> m_dependencies;
+};
+
+/**
+ * Approximate answers over a column of CSV input, or over the tokens of a text when the column is
+ * empty : the number of distinct items (HyperLogLog) or the k most frequent ones (Count-Min sketch
+ * and a top k heap). The state is a few sketches whatever the size of the input.
+ */
+class SketchNode : public Node, public Storable<std::string>, public Displayable {
+public:
+	SketchNode(NodeUid uid, SketchKind kind, std::string&& column, size_t k, std::vector<NodeUid>&& dependencies)
+		: Node(uid, NodeType::Sketch), m_counter(kind, std::move(column), k), m_dependencies(dependencies) {}
+
+	const std::string& getBuffer() const noexcept override {
+		return m_result;
+	}
+	void setBuffer(std::string&& result) noexcept override {
+		m_result = std::move(result);
+	}
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
+		return m_dependencies;
+	}
+	const SketchCounter& getCounter() const noexcept {
+		return m_counter;
+	}
+	std::string getContent() const noexcept override {
+		return m_result;
+	}
+	void acceptVisitor(NodeVisitor& visitor) override {
+		visitor.visit(*this);
+	}
+private:
+	SketchCounter m_counter;
+	std::string m_result;
+	std::vector<NodeUid> m_dependencies;
+};
+
+/**
+ * Array of numbers loaded from a text input : the numeric fields of one column of CSV input, or
+ * every number of the text when the column is empty. See parseNumbers.
+ */
+class VectorNode : public Node, public Storable<NumberVector>, public Displayable {
+public:
+	VectorNode(NodeUid uid, std::string&& column, std::vector<NodeUid>&& dependencies)
+		: Node(uid, NodeType::Vector), m_column(column), m_dependencies(dependencies) {}
+
+	const NumberVector& getBuffer() const noexcept override {
+		return m_values;
+	}
+	void setBuffer(NumberVector&& values) noexcept override {
+		m_values = std::move(values);
+	}
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
+		return m_dependencies;
+	}
+	const std::string& getColumn() const noexcept {
+		return m_column;
+	}
+	std::string getContent() const noexcept override {
+		std::string content;
+		appendNumbers(m_values, content);
+		return content;
+	}
+	void acceptVisitor(NodeVisitor& visitor) override {
+		visitor.visit(*this);
+	}
+private:
+	std::string m_column;
+	NumberVector m_values;
+	std::vector<NodeUid> m_dependencies;
+};
+
+/**
+ * Element wise operation over vector nodes, numeric nodes taking part as a number broadcast to
+ * every element. All the vectors must have the same length. See VectorCalculation.
+ */
+class VectorCalculusNode : public Node, public Storable<NumberVector>, public Displayable {
+public:
+	VectorCalculusNode(NodeUid uid, OperationType operationType, std::vector<NodeUid>&& dependencies)
+		: Node(uid, NodeType::VectorCalculus), m_operationType(operationType), m_dependencies(dependencies) {}
+
+	const NumberVector& getBuffer() const noexcept override {
+		return m_result;
+	}
+	void setBuffer(NumberVector&& result) noexcept override {
+		m_result = std::move(result);
+	}
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
+		return m_dependencies;
+	}
+	OperationType getOperationType() const noexcept {
+		return m_operationType;
+	}
+	std::string getContent() const noexcept override {
+		std::string content;
+		appendNumbers(m_result, content);
+		return content;
+	}
+	void acceptVisitor(NodeVisitor& visitor) override {
+		visitor.visit(*this);
+	}
+private:
+	OperationType m_operationType;
+	NumberVector m_result;
+	std::vector<NodeUid> m_dependencies;
+};
+
+// Reduces a vector node to one number : sum, min, max or mean of one vector, dot product of two
+class VectorReduceNode : public Node, public Storable<float>, public Displayable {
+public:
+	VectorReduceNode(NodeUid uid, VectorReduction reduction, std::vector<NodeUid>&& dependencies)
+		: Node(uid, NodeType::VectorReduce), m_reduction(reduction), m_dependencies(dependencies) {}
+
+	const float& getBuffer() const noexcept override {
+		return m_result;
+	}
+	void setBuffer(float result) noexcept {
+		m_result = result;
+	}
+	const std::vector<NodeUid>& getDependencies() const noexcept override {
+		return m_dependencies;
+	}
+	VectorReduction getReduction() const noexcept {
+		return m_reduction;
+	}
+	std::string getContent() const noexcept override {
+		return std::to_string(m_result);
+	}
+	void acceptVisitor(NodeVisitor& visitor) override {
+		visitor.visit(*this);
+	}
+private:
+	VectorReduction m_reduction;
+	float m_result = 0.0f;
+	std::vector<NodeUid> m_dependencies;
+};
+
 class EndNode : public Node {
 public:
 	EndNode(NodeUid uid) : Node(uid, NodeType::End) {};
 	void acceptVisitor(NodeVisitor& visitor) override {
 		visitor.visit(*this);
 	}
-};
\ No newline at end of file
+};
+
+// The Displayable side of a node, resolved from its type instead of a dynamic_cast; null for Display, Output and End nodes
+inline Displayable* asDisplayable(Node* node) noexcept {
+	switch (node->getType()) {
+	case NodeType::Text:
+		return static_cast<TextNode*>(node);
+	case NodeType::Title:
+		return static_cast<TitleNode*>(node);
+	case NodeType::TextInput:
+		return static_cast<TextInputNode*>(node);
+	case NodeType::NumberInput:
+		return static_cast<NumberInputNode*>(node);
+	case NodeType::FileInput:
+		return static_cast<FileInputNode*>(node);
+	case NodeType::FloatCalculus:
+		return static_cast<FloatCalculusNode*>(node);
+	case NodeType::StringCalculus:
+		return static_cast<StringCalculusNode*>(node);
+	case NodeType::WindowAggregate:
+		return static_cast<WindowAggregateNode*>(node);
+	case NodeType::GroupBy:
+		return static_cast<GroupByNode*>(node);
+	case NodeType::HashJoin:
+		return static_cast<HashJoinNode*>(node);
+	case NodeType::Filter:
+		return static_cast<FilterNode*>(node);
+	case NodeType::Sort:
+		return static_cast<SortNode*>(node);
+	case NodeType::Search:
+		return static_cast<SearchNode*>(node);
+	case NodeType::Tokenize:
+		return static_cast<TokenizeNode*>(node);
+	case NodeType::Sketch:
+		return static_cast<SketchNode*>(node);
+	case NodeType::Vector:
+		return static_cast<VectorNode*>(node);
+	case NodeType::VectorCalculus:
+		return static_cast<VectorCalculusNode*>(node);
+	case NodeType::VectorReduce:
+		return static_cast<VectorReduceNode*>(node);
+	default:
+		return nullptr;
+	}
+}
+
+inline const Displayable* asDisplayable(const Node* node) noexcept {
+	return asDisplayable(const_cast<Node*>(node));
+}
+
+// The value of a numeric node, see isNumericNodeType; null for the other nodes
+inline Storable<float>* asNumberStorable(Node* node) noexcept {
+	switch (node->getType()) {
+	case NodeType::NumberInput:
+		return static_cast<NumberInputNode*>(node);
+	case NodeType::FloatCalculus:
+		return static_cast<FloatCalculusNode*>(node);
+	case NodeType::WindowAggregate:
+		return static_cast<WindowAggregateNode*>(node);
+	case NodeType::VectorReduce:
+		return static_cast<VectorReduceNode*>(node);
+	default:
+		return nullptr;
+	}
+}
+
+// The value of a vector node, see isVectorNodeType; null for the other nodes
+inline Storable<NumberVector>* asVectorStorable(Node* node) noexcept {
+	switch (node->getType()) {
+	case NodeType::Vector:
+		return static_cast<VectorNode*>(node);
+	case NodeType::VectorCalculus:
+		return static_cast<VectorCalculusNode*>(node);
+	default:
+		return nullptr;
+	}
+}
\ No newline at end of file
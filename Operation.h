@@ -3,10 +3,27 @@
 #include <vector>
 #include <stdexcept>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <type_traits>
+
+#include "Node.h"
+#include "Tokenizer.h"
+#include "Parallel.h"
 
 template <typename DataType>
 struct Operation {
 	virtual DataType execute(const DataType& lhs, const DataType& rhs) const noexcept = 0;
+
+	// Folds rhs into the accumulator in place; overridden where a temporary can be avoided
+	virtual void accumulate(DataType& accumulator, const DataType& rhs) const noexcept {
+		accumulator = execute(accumulator, rhs);
+	}
+
+	// Operations whose operands may be grouped freely, which lets Calculation fold wide operand sets as a tree
+	virtual bool isAssociative() const noexcept {
+		return false;
+	}
 };
 
 template<typename T>
@@ -14,6 +31,12 @@ struct AdditionOperation :public Operation<T> {
 	T execute(const T& lhs, const T& rhs) const noexcept override {
 		return lhs + rhs;
 	}
+	void accumulate(T& accumulator, const T& rhs) const noexcept override {
+		accumulator = execute(accumulator, rhs);
+	}
+	bool isAssociative() const noexcept override {
+		return true;
+	}
 };
 
 template <typename T>
@@ -21,6 +44,9 @@ struct SubstractionOperation : public Operation<T> {
 	T execute(const T& lhs, const T& rhs)const noexcept override {
 		return lhs - rhs;
 	}
+	void accumulate(T& accumulator, const T& rhs) const noexcept override {
+		accumulator = execute(accumulator, rhs);
+	}
 };
 
 template <typename T>
@@ -28,6 +54,12 @@ struct MultiplicationOperation : public Operation<T> {
 	T execute(const T& lhs, const T& rhs)const noexcept override {
 		return lhs * rhs;
 	}
+	void accumulate(T& accumulator, const T& rhs) const noexcept override {
+		accumulator = execute(accumulator, rhs);
+	}
+	bool isAssociative() const noexcept override {
+		return true;
+	}
 };
 
 template <typename T>
@@ -35,6 +67,9 @@ struct DivisionOperation : public Operation<T> {
 	T execute(const T& lhs, const T& rhs) const noexcept {
 		return lhs / rhs;
 	}
+	void accumulate(T& accumulator, const T& rhs) const noexcept override {
+		accumulator = execute(accumulator, rhs);
+	}
 };
 
 template <typename T>
@@ -43,6 +78,12 @@ struct MaxOperation : public Operation<T> {
 		if (lhs > rhs) return lhs;
 		else return rhs;
 	}
+	void accumulate(T& accumulator, const T& rhs) const noexcept override {
+		accumulator = execute(accumulator, rhs);
+	}
+	bool isAssociative() const noexcept override {
+		return true;
+	}
 };
 
 template <typename T>
@@ -51,15 +92,21 @@ struct MinOperation : public Operation<T> {
 		if (lhs > rhs) return rhs;
 		else return lhs;
 	}
+	void accumulate(T& accumulator, const T& rhs) const noexcept override {
+		accumulator = execute(accumulator, rhs);
+	}
+	bool isAssociative() const noexcept override {
+		return true;
+	}
 };
 
+// Whitespace separated words, see forEachToken for splitting without copies
 inline std::vector<std::string> splitWords(const std::string& str) {
+	static const DelimiterSet whitespace;
 	std::vector<std::string> words;
-	std::istringstream iss(str);
-	std::string word;
-	while (iss >> word) {
-		words.push_back(word);
-	}
+	forEachToken(str, whitespace, [&words](std::string_view word) {
+		words.emplace_back(word);
+	});
 	return words;
 }
 
@@ -100,10 +147,80 @@ inline std::string operator / (const std::string& str, const std::string& delimi
 
 }
 
+// In-place string folds used by Calculation::executeInto, they only allocate when the accumulator runs out of capacity
+template <>
+inline void AdditionOperation<std::string>::accumulate(std::string& accumulator, const std::string& rhs) const noexcept {
+	accumulator += rhs;
+}
+
+template <>
+inline void SubstractionOperation<std::string>::accumulate(std::string& accumulator, const std::string& rhs) const noexcept {
+	for (char ch : rhs) {
+		size_t pos = accumulator.find(ch);
+		if (pos != std::string::npos) {
+			accumulator.erase(pos, 1);
+		}
+	}
+}
+
+template <>
+inline void MultiplicationOperation<std::string>::accumulate(std::string& accumulator, const std::string& rhs) const noexcept {
+	// every pair "(a,b)" takes 5 characters, the pairs are written back to front so each lhs character is read before it is overwritten
+	const size_t lhsSize = accumulator.size();
+	const size_t rhsSize = rhs.size();
+	accumulator.resize(lhsSize * rhsSize * 5);
+	for (size_t i = lhsSize; i-- > 0;) {
+		const char ch_lhs = accumulator[i];
+		for (size_t j = rhsSize; j-- > 0;) {
+			char* pair = &accumulator[(i * rhsSize + j) * 5];
+			pair[0] = '(';
+			pair[1] = ch_lhs;
+			pair[2] = ',';
+			pair[3] = rhs[j];
+			pair[4] = ')';
+		}
+	}
+}
+
+template <>
+inline void DivisionOperation<std::string>::accumulate(std::string& accumulator, const std::string& delimiter) const noexcept {
+	size_t pos = accumulator.find(delimiter);
+	if (pos != std::string::npos) {
+		accumulator.resize(pos);
+	}
+}
+
+template <>
+inline void MaxOperation<std::string>::accumulate(std::string& accumulator, const std::string& rhs) const noexcept {
+	if (!(accumulator > rhs)) {
+		accumulator.assign(rhs);
+	}
+}
+
+template <>
+inline void MinOperation<std::string>::accumulate(std::string& accumulator, const std::string& rhs) const noexcept {
+	if (accumulator > rhs) {
+		accumulator.assign(rhs);
+	}
+}
+
 
 template <typename DataType>
 class Calculation {
 public:
+	// Operand count from which associative folds of numbers are split across the ThreadPool
+	static constexpr size_t ParallelThreshold = size_t(1) << 16;
+	// Operands folded serially into one partial result. The blocks do not depend on the thread count, so neither does the result
+	static constexpr size_t BlockSize = size_t(1) << 12;
+
+	// A compensated summation must come from summationFor, so the fold does not have to inspect the operation
+	explicit Calculation(SummationMode summation = SummationMode::Plain) noexcept : m_summation(summation) {}
+
+	// The summation a fold with operation gets when summation is requested : only additions are compensated
+	static SummationMode summationFor(OperationType operation, SummationMode summation) noexcept {
+		return operation == OperationType::Add ? summation : SummationMode::Plain;
+	}
+
 	/**
 	 *
 	 *
@@ -131,13 +248,254 @@ public:
 
 		std::unique_ptr<DataType> result = std::make_unique<DataType>(operands.front());
 
-		for (auto it = std::next(operands.begin()); it != operands.end(); ++it) {
-			*result = operation->execute(*result, *it);
-		}
+		fold([&operands](size_t index) -> const DataType& { return operands[index]; }, operands.size(), *operation, *result);
 
 		return result;
 
 	}
+
+	/**
+	 * Allocation free variant of execute used by prepared flows.
+	 *
+	 * The result is folded into the caller owned buffer, so once the buffer has enough capacity
+	 * repeated calls do not touch the heap.
+	 *
+	 * @param operands Pointers to the operands, in fold order.
+	 * @param count The number of operands.
+	 * @param operation The operation to be applied on the operands.
+	 * @param result The buffer receiving the result.
+	 * @throws std::invalid_argument if no operands are provided.
+	 */
+	void executeInto(const DataType* const* operands, size_t count, const Operation<DataType>& operation, DataType& result) const {
+
+		if (count == 0) {
+			throw std::invalid_argument("No operands provided");
+		}
+
+		fold([operands](size_t index) -> const DataType& { return *operands[index]; }, count, operation, result);
+	}
+
+	// Same as above for operands that are stored contiguously
+	void executeInto(const DataType* operands, size_t count, const Operation<DataType>& operation, DataType& result) const {
+
+		if (count == 0) {
+			throw std::invalid_argument("No operands provided");
+		}
+
+		fold([operands](size_t index) -> const DataType& { return operands[index]; }, count, operation, result);
+	}
+
+private:
+	SummationMode m_summation;
+
+	// Running sum that carries the low order bits lost by each addition (Neumaier's variant of Kahan summation)
+	struct CompensatedSum {
+		DataType sum{};
+		DataType compensation{};
+
+		void add(DataType value) noexcept {
+			DataType total = sum + value;
+			compensation += std::abs(sum) >= std::abs(value) ? (sum - total) + value : (value - total) + sum;
+			sum = total;
+		}
+		void merge(const CompensatedSum& other) noexcept {
+			add(other.sum);
+			compensation += other.compensation;
+		}
+	};
+
+	/**
+	 * Left to right fold, except for numbers : compensated sums, and associative operations over
+	 * ParallelThreshold operands or more, are folded in blocks combined in a fixed tree.
+	 */
+	template <typename OperandAt>
+	void fold(OperandAt&& operandAt, size_t count, const Operation<DataType>& operation, DataType& result) const {
+		if constexpr (std::is_floating_point_v<DataType>) {
+			if (m_summation == SummationMode::Compensated) {
+				auto total = reduceBlocks<CompensatedSum>(count, [&](size_t begin, size_t end) {
+					CompensatedSum partial;
+					for (size_t index = begin; index < end; index++) partial.add(operandAt(index));
+					return partial;
+					}, [](CompensatedSum& left, const CompensatedSum& right) { left.merge(right); });
+				result = total.sum + total.compensation;
+				return;
+			}
+		}
+		if constexpr (std::is_arithmetic_v<DataType>) {
+			if (count >= ParallelThreshold && operation.isAssociative()) {
+				result = reduceBlocks<DataType>(count, [&](size_t begin, size_t end) {
+					DataType partial = operandAt(begin);
+					for (size_t index = begin + 1; index < end; index++) operation.accumulate(partial, operandAt(index));
+					return partial;
+					}, [&operation](DataType& left, const DataType& right) { operation.accumulate(left, right); });
+				return;
+			}
+		}
+
+		result = operandAt(0);
+
+		for (size_t index = 1; index < count; index++) {
+			operation.accumulate(result, operandAt(index));
+		}
+	}
+
+	/**
+	 * Folds every block of BlockSize operands into a partial, on the ThreadPool from ParallelThreshold
+	 * operands, then combines neighbouring partials pairwise, (0 1) (2 3) ... then (01 23) ..., until
+	 * one is left. The tree only depends on the operand count, so results are reproducible whatever
+	 * the number of threads, and the rounding error of sums grows with log(count) instead of count.
+	 */
+	template <typename Partial, typename FoldBlock, typename Combine>
+	static Partial reduceBlocks(size_t count, FoldBlock&& foldBlock, Combine&& combine) {
+		const size_t blockCount = (count + BlockSize - 1) / BlockSize;
+		if (blockCount == 1) {
+			return foldBlock(0, count);
+		}
+		// kept by the calling thread, so a calculation it ran before folds without allocating ;
+		// the reference hands the caller's vector to the pool workers
+		thread_local std::vector<Partial> scratch;
+		std::vector<Partial>& partials = scratch;
+		partials.resize(blockCount);
+		auto foldInto = [&](size_t block) {
+			partials[block] = foldBlock(block * BlockSize, std::min(count, (block + 1) * BlockSize));
+		};
+		if (count >= ParallelThreshold) {
+			ThreadPool::getInstance().parallelFor(blockCount, foldInto);
+		}
+		else {
+			for (size_t block = 0; block < blockCount; block++) foldInto(block);
+		}
+		for (size_t width = 1; width < blockCount; width *= 2) {
+			for (size_t left = 0; left + width < blockCount; left += 2 * width) {
+				combine(partials[left], partials[left + width]);
+			}
+		}
+		return partials[0];
+	}
+};
+
+// One operand of a VectorCalculation : a vector, or a number that stands for a vector of any length
+struct VectorOperand {
+	const float* data = nullptr;
+	size_t size = 0;
+	float scalar = 0.0f;
+	bool isScalar = false;
+
+	static VectorOperand ofVector(const NumberVector& values) noexcept {
+		return VectorOperand{ values.data(), values.size(), 0.0f, false };
+	}
+	static VectorOperand ofScalar(float value) noexcept {
+		return VectorOperand{ nullptr, 0, value, true };
+	}
+};
+
+/**
+ * Element wise operations and reductions over whole vectors, so a computation over thousands of
+ * numbers is one call instead of one Calculation per element. The work is done by the SIMD
+ * VectorKernels; results are written into caller owned vectors, which keep their capacity.
+ */
+class VectorCalculation {
+public:
+	/**
+	 * Folds the operands element wise into result, numbers being broadcast to every element.
+	 *
+	 * @throws std::invalid_argument if no operands are provided, if none of them is a vector or if the vectors differ in length.
+	 */
+	void executeInto(const VectorOperand* operands, size_t count, OperationType operation, NumberVector& result) const {
+
+		if (count == 0) {
+			throw std::invalid_argument("No operands provided");
+		}
+
+		const size_t length = vectorLength(operands, count);
+		if (operands[0].isScalar) {
+			result.assign(length, operands[0].scalar);
+		}
+		else {
+			result.assign(operands[0].data, operands[0].data + length);
+		}
+
+		for (size_t index = 1; index < count; index++) {
+			switch (operation) {
+			case OperationType::Add:
+				apply<AddKernel>(result, operands[index]);
+				break;
+			case OperationType::Sub:
+				apply<SubtractKernel>(result, operands[index]);
+				break;
+			case OperationType::Mul:
+				apply<MultiplyKernel>(result, operands[index]);
+				break;
+			case OperationType::Div:
+				apply<DivideKernel>(result, operands[index]);
+				break;
+			case OperationType::Min:
+				apply<MinKernel>(result, operands[index]);
+				break;
+			case OperationType::Max:
+				apply<MaxKernel>(result, operands[index]);
+				break;
+			default:
+				throw std::invalid_argument("Unsupported operation type");
+			}
+		}
+	}
+
+	/**
+	 * Reduces one vector, or two of the same length for a dot product. Min and max of an empty vector are 0.
+	 *
+	 * @throws std::invalid_argument if the operands do not match the reduction.
+	 */
+	double reduce(const VectorOperand* operands, size_t count, VectorReduction reduction) const {
+
+		const size_t expected = reduction == VectorReduction::Dot ? 2 : 1;
+		if (count != expected || std::any_of(operands, operands + count, [](const VectorOperand& operand) { return operand.isScalar; })) {
+			throw std::invalid_argument(reduction == VectorReduction::Dot ? "A dot product needs two vectors" : "A reduction needs one vector");
+		}
+
+		const VectorOperand& values = operands[0];
+		switch (reduction) {
+		case VectorReduction::Sum:
+			return VectorKernels::sum(values.data, values.size);
+		case VectorReduction::Mean:
+			return values.size == 0 ? 0.0 : VectorKernels::sum(values.data, values.size) / double(values.size);
+		case VectorReduction::Min:
+			return values.size == 0 ? 0.0 : VectorKernels::extreme(values.data, values.size, false);
+		case VectorReduction::Max:
+			return values.size == 0 ? 0.0 : VectorKernels::extreme(values.data, values.size, true);
+		case VectorReduction::Dot:
+			if (operands[1].size != values.size) {
+				throw std::invalid_argument("Vectors of a dot product must have the same length");
+			}
+			return VectorKernels::dot(values.data, operands[1].data, values.size);
+		default:
+			throw std::invalid_argument("Unsupported reduction");
+		}
+	}
+
+private:
+	static size_t vectorLength(const VectorOperand* operands, size_t count) {
+		const VectorOperand* first = std::find_if(operands, operands + count, [](const VectorOperand& operand) { return !operand.isScalar; });
+		if (first == operands + count) {
+			throw std::invalid_argument("A vector operation needs at least one vector operand");
+		}
+		for (size_t index = 0; index < count; index++) {
+			if (!operands[index].isScalar && operands[index].size != first->size) {
+				throw std::invalid_argument("Vector operands must have the same length");
+			}
+		}
+		return first->size;
+	}
+
+	template <typename Kernel>
+	static void apply(NumberVector& result, const VectorOperand& operand) noexcept {
+		if (operand.isScalar) {
+			VectorKernels::applyScalar<Kernel>(result.data(), operand.scalar, result.size());
+		}
+		else {
+			VectorKernels::apply<Kernel>(result.data(), operand.data, result.size());
+		}
+	}
 };
 
 template <typename DataType>
@@ -174,6 +532,36 @@ public:
 		return std::make_unique<MinOperation<T>>();
 	}
 
+	/**
+	 * Returns a stateless operation shared by every caller, so hot paths do not allocate one per use.
+	 * @throws std::invalid_argument if the operation type is not supported.
+	 */
+	const Operation<DataType>& getSharedOperation(OperationType type) const {
+		static const AdditionOperation<DataType> addition;
+		static const SubstractionOperation<DataType> subtraction;
+		static const MultiplicationOperation<DataType> multiplication;
+		static const DivisionOperation<DataType> division;
+		static const MinOperation<DataType> min;
+		static const MaxOperation<DataType> max;
+
+		switch (type) {
+		case OperationType::Add:
+			return addition;
+		case OperationType::Sub:
+			return subtraction;
+		case OperationType::Mul:
+			return multiplication;
+		case OperationType::Div:
+			return division;
+		case OperationType::Min:
+			return min;
+		case OperationType::Max:
+			return max;
+		default:
+			throw std::invalid_argument("Unsupported operation type");
+		}
+	}
+
 	static OperationFactory& getInstance() {
 		static OperationFactory instance;
 		return instance;
@@ -0,0 +1,245 @@
+#pragma once
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <exception>
+#include <algorithm>
+#include <type_traits>
+#include <cstdint>
+
+/**
+ * Fixed size pool of worker threads shared by the data parallel parts of the engine.
+ */
+class ThreadPool {
+public:
+	explicit ThreadPool(size_t threadCount) {
+		for (size_t index = 0; index < threadCount; index++) {
+			m_workers.emplace_back([this]() { workerLoop(); });
+		}
+	}
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool() {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stopping = true;
+		}
+		m_condition.notify_all();
+		for (auto& worker : m_workers) {
+			worker.join();
+		}
+	}
+
+	size_t getThreadCount() const noexcept {
+		return m_workers.size();
+	}
+
+	void submit(std::function<void()>&& task) {
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.push(std::move(task));
+		}
+		m_condition.notify_one();
+	}
+
+	/**
+	 * Runs task(0) ... task(count - 1) and returns once all of them finished.
+	 *
+	 * The calling thread takes part in the work, so parallelFor can be nested inside a pool task
+	 * without deadlocking : when every worker is busy the caller simply runs all the indices.
+	 * The loop lives on the caller's stack and idle workers join it while indices are left, so a
+	 * parallelFor does not allocate. The first exception thrown by a task is rethrown on the calling thread.
+	 */
+	template <typename Task>
+	void parallelFor(size_t count, Task&& task) {
+		if (count == 0) return;
+		if (count == 1 || m_workers.empty()) {
+			for (size_t index = 0; index < count; index++) task(index);
+			return;
+		}
+
+		Loop loop;
+		loop.runIndex = [](void* task, size_t index) {
+			(*static_cast<std::remove_reference_t<Task>*>(task))(index);
+		};
+		loop.task = const_cast<void*>(static_cast<const void*>(std::addressof(task)));
+		loop.count = count;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			loop.nextLoop = m_loops;
+			m_loops = &loop;
+		}
+		m_condition.notify_all();
+		runLoop(loop);
+
+		// once unlinked no worker joins the loop, the ones in it finish their index and leave
+		std::unique_lock<std::mutex> lock(m_mutex);
+		for (Loop** link = &m_loops; *link != nullptr; link = &(*link)->nextLoop) {
+			if (*link == &loop) {
+				*link = loop.nextLoop;
+				break;
+			}
+		}
+		m_loopLeft.wait(lock, [&loop]() { return loop.helpers == 0; });
+		if (loop.error) {
+			std::rethrow_exception(loop.error);
+		}
+	}
+
+	// Process wide pool sized to the hardware
+	static ThreadPool& getInstance() {
+		static ThreadPool instance(std::max<size_t>(1, std::thread::hardware_concurrency()) - 1);
+		return instance;
+	}
+
+private:
+	// A parallelFor in progress, on the stack of its caller
+	struct Loop {
+		void (*runIndex)(void* task, size_t index) = nullptr;
+		void* task = nullptr;
+		size_t count = 0;
+		std::atomic<size_t> next{ 0 };
+		// workers inside the loop, guarded by m_mutex like error and nextLoop
+		size_t helpers = 0;
+		std::exception_ptr error;
+		Loop* nextLoop = nullptr;
+	};
+
+	std::vector<std::thread> m_workers;
+	std::queue<std::function<void()>> m_tasks;
+	Loop* m_loops = nullptr;
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::condition_variable m_loopLeft;
+	bool m_stopping = false;
+
+	void runLoop(Loop& loop) {
+		size_t index;
+		while ((index = loop.next.fetch_add(1)) < loop.count) {
+			try {
+				loop.runIndex(loop.task, index);
+			}
+			catch (...) {
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (!loop.error) loop.error = std::current_exception();
+			}
+		}
+	}
+
+	// A loop with indices left, called with m_mutex held
+	Loop* findLoop() const noexcept {
+		for (Loop* loop = m_loops; loop != nullptr; loop = loop->nextLoop) {
+			if (loop->next.load(std::memory_order_relaxed) < loop->count) return loop;
+		}
+		return nullptr;
+	}
+
+	void workerLoop() {
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true) {
+			m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty() || findLoop() != nullptr; });
+			if (Loop* loop = findLoop()) {
+				loop->helpers++;
+				lock.unlock();
+				runLoop(*loop);
+				lock.lock();
+				if (--loop->helpers == 0) {
+					m_loopLeft.notify_all();
+				}
+				continue;
+			}
+			if (m_stopping && m_tasks.empty()) return;
+			std::function<void()> task = std::move(m_tasks.front());
+			m_tasks.pop();
+			lock.unlock();
+			task();
+			lock.lock();
+		}
+	}
+};
+
+/**
+ * Bounded lock free queue for any number of producers and consumers, after Vyukov : every cell
+ * carries a sequence number telling whether it is free for the producer of a given position or
+ * filled for its consumer, so both sides only contend on their own index.
+ *
+ * tryPush fails when the queue is full and tryPop when it is empty; callers wait and retry,
+ * which is what gives a chain of queues its back pressure.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+	// The capacity is rounded up to a power of two
+	explicit BoundedQueue(size_t capacity) {
+		size_t rounded = 2;
+		while (rounded < capacity) rounded <<= 1;
+		m_cells.reset(new Cell[rounded]);
+		m_mask = rounded - 1;
+		for (size_t index = 0; index < rounded; index++) {
+			m_cells[index].sequence.store(index, std::memory_order_relaxed);
+		}
+	}
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	// Moves from value only when it succeeds
+	bool tryPush(T& value) {
+		size_t position = m_tail.load(std::memory_order_relaxed);
+		Cell* cell;
+		while (true) {
+			cell = &m_cells[position & m_mask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const intptr_t difference = intptr_t(sequence) - intptr_t(position);
+			if (difference == 0) {
+				if (m_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				position = m_tail.load(std::memory_order_relaxed);
+			}
+		}
+		cell->value = std::move(value);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool tryPop(T& value) {
+		size_t position = m_head.load(std::memory_order_relaxed);
+		Cell* cell;
+		while (true) {
+			cell = &m_cells[position & m_mask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const intptr_t difference = intptr_t(sequence) - intptr_t(position + 1);
+			if (difference == 0) {
+				if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+			}
+			else if (difference < 0) {
+				return false;
+			}
+			else {
+				position = m_head.load(std::memory_order_relaxed);
+			}
+		}
+		value = std::move(cell->value);
+		cell->sequence.store(position + m_mask + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	struct Cell {
+		std::atomic<size_t> sequence;
+		T value;
+	};
+	std::unique_ptr<Cell[]> m_cells;
+	size_t m_mask;
+	alignas(64) std::atomic<size_t> m_tail{ 0 };
+	alignas(64) std::atomic<size_t> m_head{ 0 };
+};
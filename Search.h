@@ -0,0 +1,266 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstring>
+
+#include "Csv.h"
+#include "Simd.h"
+
+enum class SearchOutput {
+	// one "pattern,count" row per pattern
+	Counts,
+	// one "offset,pattern" row per match, offsets in bytes from the start of the text
+	Offsets,
+	// every line with at least one match, once
+	Lines
+};
+
+inline std::string searchOutputToString(SearchOutput output) {
+	switch (output) {
+	case SearchOutput::Counts:
+		return "Counts";
+	case SearchOutput::Offsets:
+		return "Offsets";
+	case SearchOutput::Lines:
+		return "Lines";
+	default:
+		return "UnknownOutput";
+	}
+}
+
+// Progress of one search over text fed in blocks
+struct SearchScan {
+	uint32_t state = 0;
+	// bytes of the text before the current block
+	uint64_t offset = 0;
+	std::vector<uint64_t> counts;
+};
+
+/**
+ * Finds many literal patterns in one pass over the text with an Aho–Corasick automaton.
+ *
+ * The automaton is a dense table of 256 transitions per state, so every byte costs a single
+ * lookup. While the automaton is in its root state no match can be in progress, and the scan
+ * skips straight to the next byte that starts a pattern : 16 bytes at a time with SSE2 when the
+ * patterns start with at most four distinct bytes, through a byte table otherwise.
+ *
+ * Patterns may not contain line breaks, so the text can be fed in blocks of complete lines and
+ * a match never spans two lines. The searcher is immutable once built and can be shared; the
+ * progress of a search lives in a SearchScan.
+ */
+class TextSearcher {
+public:
+	/**
+	 * @throws InvalidInput if there are no patterns or a pattern is empty or contains a line break.
+	 */
+	TextSearcher(std::vector<std::string> patterns, SearchOutput output)
+		: m_patterns(std::move(patterns)), m_output(output) {
+		if (m_patterns.empty()) {
+			throw InvalidInput("A search needs at least one pattern");
+		}
+		for (const auto& pattern : m_patterns) {
+			if (pattern.empty() || pattern.find_first_of("\r\n") != std::string::npos) {
+				throw InvalidInput("Search patterns cannot be empty or contain line breaks");
+			}
+		}
+		buildAutomaton();
+	}
+
+	const std::vector<std::string>& getPatterns() const noexcept {
+		return m_patterns;
+	}
+	SearchOutput getOutput() const noexcept {
+		return m_output;
+	}
+
+	// Resets the scan and writes the header of the output
+	void begin(SearchScan& scan, std::string& result) const {
+		scan.state = 0;
+		scan.offset = 0;
+		scan.counts.assign(m_patterns.size(), 0);
+		if (m_output == SearchOutput::Offsets) {
+			result += "offset,pattern\n";
+		}
+	}
+
+	// Searches the next block of text; blocks must end on line boundaries for Lines output
+	void search(std::string_view text, SearchScan& scan, std::string& result) const {
+		const uint32_t* next = m_next.data();
+		const size_t size = text.size();
+		uint32_t state = scan.state;
+		size_t position = 0;
+		while (position < size) {
+			if (state == 0) {
+				position = skipToCandidate(text, position);
+				if (position == size) break;
+			}
+			state = next[state * 256 + static_cast<unsigned char>(text[position])];
+			if (m_reports[state]) {
+				if (m_output == SearchOutput::Lines) {
+					// the line is emitted once, scanning resumes after it
+					size_t start = text.rfind('\n', position);
+					start = start == std::string_view::npos ? 0 : start + 1;
+					size_t end = text.find('\n', position);
+					end = end == std::string_view::npos ? size : end;
+					result.append(text.data() + start, end - start);
+					result += '\n';
+					forEachMatch(state, [&scan](uint32_t pattern) { scan.counts[pattern]++; });
+					state = 0;
+					position = end;
+					continue;
+				}
+				forEachMatch(state, [&](uint32_t pattern) {
+					scan.counts[pattern]++;
+					if (m_output == SearchOutput::Offsets) {
+						Csv::appendNumber(result, double(scan.offset + position + 1 - m_patterns[pattern].size()));
+						result += ',';
+						Csv::appendField(result, m_patterns[pattern]);
+						result += '\n';
+					}
+				});
+			}
+			position++;
+		}
+		scan.state = state;
+		scan.offset += size;
+	}
+
+	// Writes the counts when they are the output
+	void finish(const SearchScan& scan, std::string& result) const {
+		if (m_output != SearchOutput::Counts) return;
+		result += "pattern,count\n";
+		for (size_t pattern = 0; pattern < m_patterns.size(); pattern++) {
+			Csv::appendField(result, m_patterns[pattern]);
+			result += ',';
+			Csv::appendNumber(result, double(scan.counts[pattern]));
+			result += '\n';
+		}
+	}
+
+	// Searches text held in memory from begin to finish
+	void searchAll(std::string_view text, SearchScan& scan, std::string& result) const {
+		begin(scan, result);
+		search(text, scan, result);
+		finish(scan, result);
+	}
+
+private:
+	static constexpr uint32_t NoPattern = UINT32_MAX;
+	// the SSE2 prefilter compares against at most this many start bytes
+	static constexpr size_t MaxVectorStartBytes = 4;
+
+	std::vector<std::string> m_patterns;
+	SearchOutput m_output;
+	// m_next[state * 256 + byte] is the state after reading byte, failures already resolved
+	std::vector<uint32_t> m_next;
+	// pattern ending at a state and the nearest state on its failure chain where another one ends
+	std::vector<uint32_t> m_pattern;
+	std::vector<uint32_t> m_dictionaryLink;
+	std::vector<uint8_t> m_reports;
+	// bytes that leave the root state
+	bool m_startBytes[256] = {};
+	std::vector<unsigned char> m_vectorStartBytes;
+
+	void buildAutomaton() {
+		// trie, 0 meaning "no child" since no transition leads back into the root
+		m_next.assign(256, 0);
+		m_pattern.assign(1, NoPattern);
+		for (uint32_t index = 0; index < m_patterns.size(); index++) {
+			uint32_t state = 0;
+			for (unsigned char ch : m_patterns[index]) {
+				uint32_t& child = m_next[state * 256 + ch];
+				if (child == 0) {
+					child = uint32_t(m_pattern.size());
+					m_pattern.push_back(NoPattern);
+					m_next.resize(m_next.size() + 256, 0);
+				}
+				state = m_next[state * 256 + ch];
+			}
+			// the first of duplicated patterns reports, the others keep a count of 0
+			if (m_pattern[state] == NoPattern) m_pattern[state] = index;
+		}
+
+		// breadth first : failure transitions of a state come from already completed shallower states
+		const size_t stateCount = m_pattern.size();
+		std::vector<uint32_t> failure(stateCount, 0), queue;
+		m_dictionaryLink.assign(stateCount, NoPattern);
+		queue.reserve(stateCount);
+		for (unsigned byte = 0; byte < 256; byte++) {
+			if (m_next[byte] != 0) {
+				queue.push_back(m_next[byte]);
+				m_startBytes[byte] = true;
+			}
+		}
+		for (size_t head = 0; head < queue.size(); head++) {
+			uint32_t state = queue[head];
+			uint32_t fallback = failure[state];
+			m_dictionaryLink[state] = m_pattern[fallback] != NoPattern ? fallback : m_dictionaryLink[fallback];
+			for (unsigned byte = 0; byte < 256; byte++) {
+				uint32_t& child = m_next[state * 256 + byte];
+				if (child != 0) {
+					failure[child] = m_next[fallback * 256 + byte];
+					queue.push_back(child);
+				}
+				else {
+					child = m_next[fallback * 256 + byte];
+				}
+			}
+		}
+
+		m_reports.assign(stateCount, 0);
+		for (size_t state = 0; state < stateCount; state++) {
+			m_reports[state] = m_pattern[state] != NoPattern || m_dictionaryLink[state] != NoPattern;
+		}
+		for (unsigned byte = 0; byte < 256; byte++) {
+			if (m_startBytes[byte]) m_vectorStartBytes.push_back(static_cast<unsigned char>(byte));
+		}
+		if (m_vectorStartBytes.size() > MaxVectorStartBytes) {
+			m_vectorStartBytes.clear();
+		}
+	}
+
+	template <typename Callback>
+	void forEachMatch(uint32_t state, Callback&& onPattern) const {
+		if (m_pattern[state] == NoPattern) state = m_dictionaryLink[state];
+		while (state != NoPattern) {
+			onPattern(m_pattern[state]);
+			state = m_dictionaryLink[state];
+		}
+	}
+
+	// Position of the next byte that starts a pattern, or the end of the text
+	size_t skipToCandidate(std::string_view text, size_t position) const noexcept {
+		const size_t size = text.size();
+		const char* data = text.data();
+		if (m_vectorStartBytes.size() == 1) {
+			auto found = static_cast<const char*>(std::memchr(data + position, m_vectorStartBytes[0], size - position));
+			return found == nullptr ? size : size_t(found - data);
+		}
+#ifdef FLOWBUILDER_SSE2
+		if (!m_vectorStartBytes.empty()) {
+			__m128i needles[MaxVectorStartBytes];
+			const size_t needleCount = m_vectorStartBytes.size();
+			for (size_t index = 0; index < needleCount; index++) {
+				needles[index] = _mm_set1_epi8(static_cast<char>(m_vectorStartBytes[index]));
+			}
+			for (; position + 16 <= size; position += 16) {
+				__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + position));
+				__m128i hits = _mm_cmpeq_epi8(block, needles[0]);
+				for (size_t index = 1; index < needleCount; index++) {
+					hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, needles[index]));
+				}
+				unsigned mask = unsigned(_mm_movemask_epi8(hits));
+				if (mask != 0) {
+					return position + countTrailingZeros(mask);
+				}
+			}
+		}
+#endif
+		while (position < size && !m_startBytes[static_cast<unsigned char>(data[position])]) {
+			position++;
+		}
+		return position;
+	}
+};
@@ -0,0 +1,366 @@
+#pragma once
+#ifdef __linux__
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <csignal>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "ExecutionPlan.h"
+#include "SharedRing.h"
+
+// Outcome of one worker process of a ShardedRunner
+struct ShardReport {
+	// byte range of the input file the shard covered
+	uint64_t begin;
+	uint64_t end;
+	bool succeeded;
+	std::string error;
+};
+
+/**
+ * Coordinator running the same ExecutionPlan in N forked worker processes, each over its own
+ * shard of a large input file.
+ *
+ * The file is mapped once and cut into byte ranges moved to line boundaries; every worker binds
+ * its range, preceded by the header line when the input has one, to the sharded input node and
+ * runs the whole plan. Results are written, framed like SharedRing records, into a shared memory
+ * region per worker, and once every worker exited the coordinator merges them, node by node :
+ * - A Display or Output reading the sharded input gets the contents of every shard in shard order,
+ *   the title, description and header lines only once, at the start. Outputs are streamed to the
+ *   sink through openOutput, a shard at a time; displays are handed to it whole.
+ * - A Display or Output that does not read the sharded input is the same in every shard, the one
+ *   of the first shard that succeeded is passed on.
+ * Concatenating is only right for nodes working row by row, so plans holding sorts, aggregates,
+ * joins or calculations over a whole input are refused, see isRowLocalNodeType, and so are displays
+ * and outputs mixing the sharded input with other operands.
+ *
+ * Workers are separate processes, so a record that crashes or exhausts the memory of one of them
+ * only fails its shard : the merged results then cover the shards that succeeded and the reports
+ * say which did not. Since the workers are forked, call run while no other thread of the process
+ * uses the shared ThreadPool.
+ */
+class ShardedRunner {
+public:
+	// Result bytes a worker may write, reserved lazily
+	static constexpr size_t DefaultResultCapacity = size_t(256) << 20;
+
+	/**
+	 * @param input The TextInput or FileInput node each worker binds its shard to.
+	 * @param hasHeader Whether the first line of the file is a header every shard needs.
+	 * @throws InvalidInput if a node of the plan is not row local, or a Display or Output reads the
+	 * input along with other operands.
+	 */
+	ShardedRunner(const ExecutionPlan& plan, NodeUid input, size_t workerCount, bool hasHeader = true, size_t resultCapacity = DefaultResultCapacity)
+		: m_plan(plan), m_input(input), m_workerCount(std::max<size_t>(1, workerCount)), m_hasHeader(hasHeader), m_resultCapacity(resultCapacity) {
+		const auto& graph = plan.getGraph();
+		for (ExecutionPlan::Index slot = 0; slot < plan.getSlotCount(); slot++) {
+			if (!isRowLocalNodeType(graph.getType(slot))) {
+				throw InvalidInput((nodeTypeToString(graph.getType(slot)) + " nodes need the whole input, the flow cannot run on shards").c_str());
+			}
+		}
+		const Index inputSlot = plan.getSlot(input);
+		m_sharded.assign(plan.getSlotCount(), false);
+		for (NodeType type : { NodeType::Display, NodeType::Output }) {
+			for (auto slot : graph.getNodesOfType(type)) {
+				if (!graph.dependsOn(slot, inputSlot)) continue;
+				// the operands of a shard would be interleaved with the ones of the next
+				auto operands = graph.getDependencies(slot);
+				if (operands.size() != 1 || !graph.followsRowByRow(operands[0], inputSlot)) {
+					throw InvalidInput((nodeTypeToString(type) + " node with uid = " + std::to_string(graph.getUid(slot))
+						+ " mixes the sharded input with other operands, the flow cannot run on shards").c_str());
+				}
+				m_sharded[slot] = true;
+			}
+		}
+	}
+
+	/**
+	 * Runs the shards of the file, merges what they produced into the sink and reports each shard.
+	 * @throws InvalidHandle if the file cannot be mapped or the workers cannot be started.
+	 */
+	std::vector<ShardReport> run(const std::string& path, ResultSink& sink) {
+		MappedFile file(path);
+		const std::string_view text = file.getText();
+		std::string_view header;
+		std::string_view body = text;
+		if (m_hasHeader) {
+			size_t end = text.find('\n');
+			end = end == std::string_view::npos ? text.size() : end + 1;
+			header = text.substr(0, end);
+			body = text.substr(end);
+		}
+
+		std::vector<ShardReport> reports(m_workerCount);
+		for (size_t shard = 0; shard < m_workerCount; shard++) {
+			reports[shard].begin = header.size() + lineStart(body, body.size() * shard / m_workerCount);
+			reports[shard].end = header.size() + lineStart(body, body.size() * (shard + 1) / m_workerCount);
+			reports[shard].succeeded = false;
+		}
+
+		const size_t regionSize = sizeof(RegionHeader) + m_resultCapacity;
+		SharedRegions regions(regionSize * m_workerCount);
+		std::vector<pid_t> workers;
+		for (size_t shard = 0; shard < m_workerCount; shard++) {
+			auto region = regions.at(shard * regionSize);
+			pid_t pid = fork();
+			if (pid == 0) {
+				runShard(header, text.substr(reports[shard].begin, reports[shard].end - reports[shard].begin), region);
+				_exit(0);
+			}
+			if (pid < 0) {
+				for (auto worker : workers) {
+					kill(worker, SIGKILL);
+					waitpid(worker, nullptr, 0);
+				}
+				throw InvalidHandle(("Failed to start a worker : " + std::string(std::strerror(errno))).c_str());
+			}
+			workers.push_back(pid);
+		}
+
+		for (size_t shard = 0; shard < m_workerCount; shard++) {
+			int status = 0;
+			while (waitpid(workers[shard], &status, 0) < 0 && errno == EINTR) {}
+			auto& report = reports[shard];
+			auto region = regions.at(shard * regionSize);
+			if (WIFSIGNALED(status)) {
+				report.error = "Worker killed by signal " + std::to_string(WTERMSIG(status));
+			}
+			else if (region.header->state == ShardState::Failed) {
+				report.error = region.header->error;
+			}
+			else if (region.header->state != ShardState::Done) {
+				report.error = "Worker exited before finishing";
+			}
+			else {
+				report.succeeded = true;
+			}
+		}
+
+		merge(regions, regionSize, reports, header, sink);
+		return reports;
+	}
+
+private:
+	typedef ExecutionPlan::Index Index;
+
+	enum class ShardState : uint32_t {
+		Running,
+		Done,
+		Failed
+	};
+
+	// Start of the region of a worker, its records follow
+	struct RegionHeader {
+		ShardState state;
+		uint64_t used;
+		char error[256];
+	};
+
+	struct Region {
+		RegionHeader* header;
+		char* records;
+	};
+
+	// Anonymous shared mapping created before the fork, so every worker inherits it
+	class SharedRegions {
+	public:
+		explicit SharedRegions(size_t size) : m_size(size) {
+			m_base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+			if (m_base == MAP_FAILED) {
+				throw InvalidHandle("Failed to map the shared result regions");
+			}
+		}
+		SharedRegions(const SharedRegions&) = delete;
+		SharedRegions& operator=(const SharedRegions&) = delete;
+		~SharedRegions() {
+			munmap(m_base, m_size);
+		}
+		Region at(size_t offset) const noexcept {
+			auto header = reinterpret_cast<RegionHeader*>(static_cast<char*>(m_base) + offset);
+			return Region{ header, reinterpret_cast<char*>(header + 1) };
+		}
+	private:
+		void* m_base;
+		size_t m_size;
+	};
+
+	class MappedFile {
+	public:
+		explicit MappedFile(const std::string& path) {
+			int fd = open(path.c_str(), O_RDONLY);
+			struct stat status;
+			if (fd < 0 || fstat(fd, &status) != 0) {
+				if (fd >= 0) close(fd);
+				throw InvalidHandle(("Failed to open " + path).c_str());
+			}
+			m_size = size_t(status.st_size);
+			if (m_size != 0) {
+				m_base = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			}
+			close(fd);
+			if (m_base == MAP_FAILED) {
+				throw InvalidHandle(("Failed to map " + path).c_str());
+			}
+		}
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile() {
+			if (m_base != nullptr && m_base != MAP_FAILED) munmap(m_base, m_size);
+		}
+		std::string_view getText() const noexcept {
+			return m_size == 0 ? std::string_view() : std::string_view(static_cast<const char*>(m_base), m_size);
+		}
+	private:
+		void* m_base = nullptr;
+		size_t m_size = 0;
+	};
+
+	// Appends the results of a worker to its region
+	class RegionSink : public ResultSink {
+	public:
+		RegionSink(Region region, size_t capacity) : m_region(region), m_capacity(capacity) {}
+
+		void onDisplay(const DisplayNode& node, std::string_view content) override {
+			append(RingRecordKind::Display, node.getUid(), content);
+		}
+		void onOutput(const OutputNode& node, std::string_view content) override {
+			append(RingRecordKind::Output, node.getUid(), content);
+		}
+	private:
+		Region m_region;
+		size_t m_capacity;
+		uint64_t m_sequence = 0;
+
+		void append(RingRecordKind kind, NodeUid uid, std::string_view content) {
+			const uint64_t used = m_region.header->used;
+			if (content.size() > UINT32_MAX || used + sizeof(RingRecordHeader) + content.size() > m_capacity) {
+				throw InvalidInput("The results of the shard do not fit in its shared memory region");
+			}
+			RingRecordHeader record{ uint32_t(content.size()), kind, uid, m_sequence++ };
+			std::memcpy(m_region.records + used, &record, sizeof(record));
+			std::memcpy(m_region.records + used + sizeof(record), content.data(), content.size());
+			m_region.header->used = used + sizeof(record) + content.size();
+		}
+	};
+
+	// A result a worker wrote, its content still in the shared region
+	struct ShardRecord {
+		NodeUid uid;
+		RingRecordKind kind;
+		std::string_view content;
+	};
+
+	const ExecutionPlan& m_plan;
+	NodeUid m_input;
+	size_t m_workerCount;
+	bool m_hasHeader;
+	size_t m_resultCapacity;
+	// by slot, the displays and outputs reading the sharded input
+	std::vector<bool> m_sharded;
+
+	// Start of the line holding offset, or offset itself when a line starts there
+	static size_t lineStart(std::string_view text, size_t offset) noexcept {
+		if (offset == 0 || offset >= text.size()) return std::min(offset, text.size());
+		if (text[offset - 1] == '\n') return offset;
+		size_t end = text.find('\n', offset);
+		return end == std::string_view::npos ? text.size() : end + 1;
+	}
+
+	// Body of a worker process
+	void runShard(std::string_view header, std::string_view shard, Region region) const noexcept {
+		region.header->state = ShardState::Running;
+		region.header->used = 0;
+		try {
+			ExecutionContext context(m_plan);
+			std::string input;
+			input.reserve(header.size() + shard.size());
+			input.append(header.data(), header.size());
+			input.append(shard.data(), shard.size());
+			context.bindText(m_input, input);
+			std::string().swap(input);
+			context.loadInputs();
+			RegionSink sink(region, m_resultCapacity);
+			context.run(sink);
+			region.header->state = ShardState::Done;
+		}
+		catch (const std::exception& exception) {
+			std::strncpy(region.header->error, exception.what(), sizeof(region.header->error) - 1);
+			region.header->error[sizeof(region.header->error) - 1] = '\0';
+			region.header->state = ShardState::Failed;
+		}
+	}
+
+	void merge(const SharedRegions& regions, size_t regionSize, const std::vector<ShardReport>& reports, std::string_view header, ResultSink& sink) const {
+		std::vector<std::vector<ShardRecord>> shards;
+		for (size_t shard = 0; shard < m_workerCount; shard++) {
+			if (!reports[shard].succeeded) continue;
+			auto region = regions.at(shard * regionSize);
+			auto& records = shards.emplace_back();
+			for (uint64_t offset = 0; offset < region.header->used;) {
+				RingRecordHeader record;
+				std::memcpy(&record, region.records + offset, sizeof(record));
+				records.push_back(ShardRecord{ NodeUid(record.uid), record.kind, std::string_view(region.records + offset + sizeof(record), record.size) });
+				offset += sizeof(record) + record.size;
+			}
+		}
+		if (shards.empty()) return;
+
+		// every shard ran the whole plan, so the first one holds a record of each node
+		const auto& graph = m_plan.getGraph();
+		std::string display;
+		for (const auto& first : shards.front()) {
+			const Index slot = m_plan.getSlot(first.uid);
+			const Node* node = graph.getNode(slot);
+			const size_t count = m_sharded[slot] ? shards.size() : 1;
+			if (first.kind == RingRecordKind::Display) {
+				display.clear();
+				for (size_t shard = 0; shard < count; shard++) {
+					if (!display.empty() && display.back() != '\n') {
+						display += '\n';
+					}
+					auto content = shardContent(shards[shard], shard, first, header);
+					display.append(content.data(), content.size());
+				}
+				sink.onDisplay(static_cast<const DisplayNode&>(*node), display);
+			}
+			else {
+				auto output = sink.openOutput(static_cast<const OutputNode&>(*node));
+				for (size_t shard = 0; shard < count; shard++) {
+					auto content = shardContent(shards[shard], shard, first, header);
+					// the blank line an output ends with goes after the rows of the last shard only
+					output->append(shard + 1 < count ? Csv::withoutBlankEnd(content) : content);
+				}
+				output->close();
+			}
+		}
+	}
+
+	// Content of the record of a shard for the node of first, without the lines the first shard already gave
+	std::string_view shardContent(const std::vector<ShardRecord>& records, size_t shard, const ShardRecord& first, std::string_view header) const {
+		if (shard == 0) return first.content;
+		auto record = std::find_if(records.begin(), records.end(), [&first](const ShardRecord& entry) {
+			return entry.uid == first.uid;
+		});
+		if (record == records.end()) return std::string_view();
+		std::string_view content = record->content;
+		if (record->kind == RingRecordKind::Output) {
+			// title and description
+			content = Csv::withoutFirstLine(Csv::withoutFirstLine(content));
+		}
+		if (m_hasHeader && Csv::firstLine(content) == Csv::firstLine(header)) {
+			content = Csv::withoutFirstLine(content);
+		}
+		return content;
+	}
+};
+#endif
@@ -0,0 +1,347 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "ExecutionPlan.h"
+
+enum class RingRecordKind : uint32_t {
+	// fills the end of the ring when the next record does not fit there
+	Padding,
+	Display,
+	Output
+};
+
+// Fixed part of every record; the payload follows, padded to 8 bytes
+struct RingRecordHeader {
+	uint32_t size;
+	RingRecordKind kind;
+	uint64_t uid;
+	uint64_t sequence;
+};
+
+// A record as seen by a consumer, the payload pointing into the shared memory
+struct RingRecord {
+	RingRecordKind kind;
+	uint64_t uid;
+	uint64_t sequence;
+	std::string_view payload;
+};
+
+/**
+ * Start of the shared memory : the ring of records follows it. Positions count every byte ever
+ * written, the offset in the ring being position & (capacity - 1).
+ */
+struct SharedRingHeader {
+	static constexpr uint64_t Magic = 0x31474e4952424c46ull;
+
+	std::atomic<uint64_t> magic;
+	uint64_t capacity;
+	// end of the record being written : older bytes than reserved - capacity may be overwritten
+	alignas(64) std::atomic<uint64_t> reserved;
+	// end of the last complete record
+	alignas(64) std::atomic<uint64_t> published;
+};
+
+/**
+ * Named shared memory holding a SharedRingHeader and its ring, mapped with shm_open / mmap or
+ * CreateFileMapping / MapViewOfFile. The creator owns the name and removes it when destroyed;
+ * consumers that mapped it keep reading until they close it.
+ */
+class SharedRing {
+public:
+	static constexpr size_t DefaultCapacity = size_t(16) << 20;
+
+	SharedRing(const SharedRing&) = delete;
+	SharedRing& operator=(const SharedRing&) = delete;
+
+	~SharedRing() {
+#ifdef _WIN32
+		if (m_base != nullptr) UnmapViewOfFile(m_base);
+		if (m_mapping != nullptr) CloseHandle(m_mapping);
+#else
+		if (m_base != nullptr) munmap(m_base, m_mappedSize);
+		if (m_owner) shm_unlink(m_name.c_str());
+#endif
+	}
+
+	/**
+	 * Creates the ring, its capacity rounded up to a power of two.
+	 * @throws InvalidHandle if the shared memory cannot be created, or already exists under that name.
+	 */
+	static std::unique_ptr<SharedRing> create(const std::string& name, size_t capacity = DefaultCapacity) {
+		size_t rounded = 4096;
+		while (rounded < capacity) rounded <<= 1;
+		std::unique_ptr<SharedRing> ring(new SharedRing(name));
+		ring->map(sizeof(SharedRingHeader) + rounded, true);
+		auto header = ring->getHeader();
+		header->capacity = rounded;
+		header->reserved.store(0, std::memory_order_relaxed);
+		header->published.store(0, std::memory_order_relaxed);
+		// consumers that find the magic find an initialized header
+		header->magic.store(SharedRingHeader::Magic, std::memory_order_release);
+		return ring;
+	}
+
+	/**
+	 * Maps an existing ring for reading.
+	 * @throws InvalidHandle if there is no ring with that name.
+	 */
+	static std::unique_ptr<SharedRing> open(const std::string& name) {
+		std::unique_ptr<SharedRing> ring(new SharedRing(name));
+		ring->map(0, false);
+		auto header = ring->getHeader();
+		if (header->magic.load(std::memory_order_acquire) != SharedRingHeader::Magic) {
+			throw InvalidHandle(("Shared memory " + name + " is not a result ring").c_str());
+		}
+		const uint64_t capacity = header->capacity;
+		if (capacity == 0 || (capacity & (capacity - 1)) != 0 || ring->m_mappedSize - sizeof(SharedRingHeader) < capacity) {
+			throw InvalidHandle(("Shared memory " + name + " is smaller than its ring").c_str());
+		}
+		return ring;
+	}
+
+	SharedRingHeader* getHeader() const noexcept {
+		return static_cast<SharedRingHeader*>(m_base);
+	}
+	char* getRing() const noexcept {
+		return static_cast<char*>(m_base) + sizeof(SharedRingHeader);
+	}
+	uint64_t getCapacity() const noexcept {
+		return getHeader()->capacity;
+	}
+
+private:
+	std::string m_name;
+	// set once this instance created the name, which it then removes
+	bool m_owner = false;
+	void* m_base = nullptr;
+	size_t m_mappedSize = 0;
+#ifdef _WIN32
+	HANDLE m_mapping = nullptr;
+#endif
+
+	explicit SharedRing(const std::string& name) : m_name(name) {}
+
+	void map(size_t size, bool create) {
+#ifdef _WIN32
+		if (create) {
+			m_mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(uint64_t(size) >> 32), DWORD(size), m_name.c_str());
+		}
+		else {
+			m_mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, m_name.c_str());
+		}
+		if (m_mapping == nullptr) {
+			throw InvalidHandle(("Failed to map shared memory " + m_name).c_str());
+		}
+		if (create && GetLastError() == ERROR_ALREADY_EXISTS) {
+			throw InvalidHandle(("Shared memory " + m_name + " already exists").c_str());
+		}
+		m_base = MapViewOfFile(m_mapping, create ? FILE_MAP_ALL_ACCESS : FILE_MAP_READ, 0, 0, size);
+		if (m_base == nullptr) {
+			throw InvalidHandle(("Failed to map shared memory " + m_name).c_str());
+		}
+		m_mappedSize = size;
+		if (!create) {
+			MEMORY_BASIC_INFORMATION region;
+			m_mappedSize = VirtualQuery(m_base, &region, sizeof(region)) != 0 ? size_t(region.RegionSize) : 0;
+			if (m_mappedSize < sizeof(SharedRingHeader)) {
+				throw InvalidHandle(("Failed to map shared memory " + m_name).c_str());
+			}
+		}
+#else
+		// a new name only, so a ring still used by another producer is never resized under it
+		int fd = shm_open(m_name.c_str(), create ? O_CREAT | O_EXCL | O_RDWR : O_RDONLY, 0600);
+		if (fd < 0) {
+			throw InvalidHandle(((create && errno == EEXIST ? "Shared memory already exists " : "Failed to open shared memory ") + m_name).c_str());
+		}
+		m_owner = create;
+		struct stat status;
+		if (create ? ftruncate(fd, off_t(size)) != 0 : fstat(fd, &status) != 0) {
+			close(fd);
+			throw InvalidHandle(("Failed to size shared memory " + m_name).c_str());
+		}
+		m_mappedSize = create ? size : size_t(status.st_size);
+		void* base = mmap(nullptr, m_mappedSize, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+		if (base == MAP_FAILED || m_mappedSize < sizeof(SharedRingHeader)) {
+			if (base != MAP_FAILED) munmap(base, m_mappedSize);
+			throw InvalidHandle(("Failed to map shared memory " + m_name).c_str());
+		}
+		m_base = base;
+#endif
+	}
+};
+
+/**
+ * The single producer of a SharedRing. Records are written in place and published with one
+ * atomic store, so publishing never blocks on consumers : a consumer that falls more than the
+ * capacity behind is lapped and resynchronizes, see SharedRingReader.
+ */
+class SharedRingWriter {
+public:
+	static constexpr size_t HeaderSize = sizeof(RingRecordHeader);
+
+	explicit SharedRingWriter(std::unique_ptr<SharedRing> ring)
+		: m_ring(std::move(ring)), m_position(m_ring->getHeader()->published.load(std::memory_order_relaxed)) {}
+
+	/**
+	 * @throws InvalidInput if the record is larger than the ring.
+	 */
+	void publish(RingRecordKind kind, uint64_t uid, std::string_view payload) {
+		const uint64_t capacity = m_ring->getCapacity();
+		const uint64_t recordSize = HeaderSize + ((payload.size() + 7) & ~uint64_t(7));
+		if (recordSize > capacity || payload.size() > UINT32_MAX) {
+			throw InvalidInput("The result does not fit in the shared memory ring");
+		}
+		auto header = m_ring->getHeader();
+		char* ring = m_ring->getRing();
+		uint64_t position = m_position;
+		uint64_t offset = position & (capacity - 1);
+		const uint64_t remaining = capacity - offset;
+		const bool wraps = recordSize > remaining;
+		const uint64_t end = (wraps ? position + remaining : position) + recordSize;
+
+		// announce the bytes about to be overwritten before touching them
+		header->reserved.store(end, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		if (wraps) {
+			// records are 8 byte aligned, so the rest of the ring is either empty or holds a header
+			if (remaining >= HeaderSize) {
+				RingRecordHeader padding{ uint32_t(remaining - HeaderSize), RingRecordKind::Padding, 0, m_sequence };
+				std::memcpy(ring + offset, &padding, HeaderSize);
+			}
+			position += remaining;
+			offset = 0;
+		}
+		RingRecordHeader record{ uint32_t(payload.size()), kind, uid, m_sequence++ };
+		std::memcpy(ring + offset, &record, HeaderSize);
+		std::memcpy(ring + offset + HeaderSize, payload.data(), payload.size());
+
+		header->published.store(end, std::memory_order_release);
+		m_position = end;
+	}
+
+private:
+	std::unique_ptr<SharedRing> m_ring;
+	uint64_t m_position;
+	uint64_t m_sequence = 0;
+};
+
+/**
+ * One consumer of a SharedRing. Each consumer keeps its own position, so any number of them read
+ * the same records without coordinating with each other or with the producer, and without a
+ * system call once the ring is mapped.
+ */
+class SharedRingReader {
+public:
+	// Starts with the records published from now on
+	explicit SharedRingReader(std::unique_ptr<SharedRing> ring)
+		: m_ring(std::move(ring)), m_position(m_ring->getHeader()->published.load(std::memory_order_acquire)) {}
+
+	uint64_t getOverrunCount() const noexcept {
+		return m_overruns;
+	}
+
+	/**
+	 * Calls onRecord with every record published since the last call and returns their number.
+	 *
+	 * Every record is copied out of the ring and checked against the producer's progress before
+	 * onRecord sees it, so records are never torn; the payload views point into a buffer of the
+	 * reader and are only valid during the call. When the producer laps the reader, the reader
+	 * skips to the newest records and getOverrunCount() grows.
+	 */
+	template <typename Callback>
+	size_t poll(Callback&& onRecord) {
+		auto header = m_ring->getHeader();
+		const char* ring = m_ring->getRing();
+		const uint64_t capacity = m_ring->getCapacity();
+		const uint64_t published = header->published.load(std::memory_order_acquire);
+		size_t count = 0;
+		if (published > m_position + capacity) {
+			resynchronize(published);
+			return 0;
+		}
+		while (m_position < published) {
+			const uint64_t offset = m_position & (capacity - 1);
+			const uint64_t remaining = capacity - offset;
+			if (remaining < SharedRingWriter::HeaderSize) {
+				m_position += remaining;
+				continue;
+			}
+			RingRecordHeader record;
+			std::memcpy(&record, ring + offset, SharedRingWriter::HeaderSize);
+			const bool intact = record.kind <= RingRecordKind::Output && SharedRingWriter::HeaderSize + record.size <= remaining;
+			if (intact && record.kind != RingRecordKind::Padding) {
+				m_payload.assign(ring + offset + SharedRingWriter::HeaderSize, record.size);
+			}
+			// the copies above are valid only if the producer has not reserved their bytes since
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (!intact || header->reserved.load(std::memory_order_relaxed) > m_position + capacity) {
+				resynchronize(header->published.load(std::memory_order_acquire));
+				return count;
+			}
+			if (record.kind == RingRecordKind::Padding) {
+				m_position += remaining;
+				continue;
+			}
+			m_position += SharedRingWriter::HeaderSize + ((uint64_t(record.size) + 7) & ~uint64_t(7));
+			count++;
+			onRecord(RingRecord{ record.kind, record.uid, record.sequence, m_payload });
+		}
+		return count;
+	}
+
+private:
+	std::unique_ptr<SharedRing> m_ring;
+	uint64_t m_position;
+	uint64_t m_overruns = 0;
+	// the record handed to onRecord, reused from one record to the next
+	std::string m_payload;
+
+	void resynchronize(uint64_t published) noexcept {
+		m_position = published;
+		m_overruns++;
+	}
+};
+
+/**
+ * Publishes the Display and Output results of a prepared run into a SharedRing, so local
+ * consumers read them straight from memory instead of polling output files.
+ */
+class SharedMemoryResultSink : public ResultSink {
+public:
+	/**
+	 * @param name Name of the shared memory, "/name" with POSIX shared memory, "Local\\name" on Windows.
+	 * @throws InvalidHandle if the shared memory cannot be created.
+	 */
+	explicit SharedMemoryResultSink(const std::string& name, size_t capacity = SharedRing::DefaultCapacity)
+		: m_writer(SharedRing::create(name, capacity)) {}
+
+	void onDisplay(const DisplayNode& node, std::string_view content) override {
+		m_writer.publish(RingRecordKind::Display, node.getUid(), content);
+	}
+	void onOutput(const OutputNode& node, std::string_view content) override {
+		m_writer.publish(RingRecordKind::Output, node.getUid(), content);
+	}
+
+private:
+	SharedRingWriter m_writer;
+};
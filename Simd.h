@@ -0,0 +1,42 @@
+#pragma once
+#include <cstdint>
+
+// SSE2 is part of every x64 target; 32 bit MSVC builds have it with /arch:SSE2
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FLOWBUILDER_SSE2 1
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Index of the lowest set bit, mask must not be 0
+inline unsigned countTrailingZeros(unsigned mask) noexcept {
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return unsigned(index);
+#else
+	return unsigned(__builtin_ctz(mask));
+#endif
+}
+
+// Number of zero bits above the highest set bit, 64 for 0
+inline unsigned countLeadingZeros64(uint64_t value) noexcept {
+	if (value == 0) return 64;
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_ARM64))
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return 63 - unsigned(index);
+#elif defined(_MSC_VER)
+	// 32 bit targets only scan 32 bits at a time
+	unsigned long index;
+	if (_BitScanReverse(&index, static_cast<unsigned long>(value >> 32))) {
+		return 31 - unsigned(index);
+	}
+	_BitScanReverse(&index, static_cast<unsigned long>(value));
+	return 63 - unsigned(index);
+#else
+	return unsigned(__builtin_clzll(value));
+#endif
+}
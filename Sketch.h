@@ -0,0 +1,359 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+#include "Csv.h"
+#include "Parallel.h"
+#include "Simd.h"
+#include "Tokenizer.h"
+
+// Spreads the bits of a FNV-1a key hash (murmur3 finalizer); sketches read the high and low bits separately
+inline uint64_t mixHash(uint64_t hash) noexcept {
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+/**
+ * Approximate number of distinct items in 2^precision one byte registers (16 KB by default),
+ * with a relative error of about 1.04 / sqrt(2^precision), 0.8 % by default.
+ */
+class HyperLogLog {
+public:
+	explicit HyperLogLog(unsigned precision = 14) : m_precision(precision), m_registers(size_t(1) << precision, 0) {}
+
+	void add(uint64_t hash) noexcept {
+		size_t index = size_t(hash >> (64 - m_precision));
+		// rank of the first set bit in the remaining bits, capped when they are all zero
+		uint8_t rank = uint8_t(std::min(countLeadingZeros64(hash << m_precision), 64 - m_precision) + 1);
+		if (rank > m_registers[index]) m_registers[index] = rank;
+	}
+
+	// Merging the sketches of two inputs gives the sketch of their union
+	void merge(const HyperLogLog& other) noexcept {
+		for (size_t index = 0; index < m_registers.size(); index++) {
+			m_registers[index] = std::max(m_registers[index], other.m_registers[index]);
+		}
+	}
+
+	double estimate() const noexcept {
+		const double registers = double(m_registers.size());
+		double sum = 0.0;
+		size_t zeros = 0;
+		for (auto rank : m_registers) {
+			sum += std::ldexp(1.0, -int(rank));
+			zeros += rank == 0;
+		}
+		double estimate = 0.7213 / (1.0 + 1.079 / registers) * registers * registers / sum;
+		// linear counting is more accurate while many registers are still empty
+		if (estimate <= 2.5 * registers && zeros != 0) {
+			estimate = registers * std::log(registers / double(zeros));
+		}
+		return estimate;
+	}
+
+	void clear() noexcept {
+		std::fill(m_registers.begin(), m_registers.end(), uint8_t(0));
+	}
+
+private:
+	unsigned m_precision;
+	std::vector<uint8_t> m_registers;
+};
+
+/**
+ * Count-Min sketch : depth rows of width counters. An item increments one counter per row and its
+ * estimate is the smallest of them, which never undercounts and overcounts by at most
+ * e / width of the total with probability 1 - e^-depth.
+ */
+class CountMinSketch {
+public:
+	CountMinSketch(size_t width = 2048, size_t depth = 4) : m_width(1), m_depth(depth) {
+		while (m_width < width) m_width <<= 1;
+		m_counters.assign(m_width * m_depth, 0);
+	}
+
+	// Adds count occurrences and returns the new estimate of the item
+	uint64_t add(uint64_t hash, uint64_t count = 1) noexcept {
+		uint64_t estimate = UINT64_MAX;
+		for (size_t row = 0; row < m_depth; row++) {
+			uint64_t& counter = m_counters[row * m_width + column(hash, row)];
+			counter += count;
+			estimate = std::min(estimate, counter);
+		}
+		return estimate;
+	}
+
+	uint64_t estimate(uint64_t hash) const noexcept {
+		uint64_t estimate = UINT64_MAX;
+		for (size_t row = 0; row < m_depth; row++) {
+			estimate = std::min(estimate, m_counters[row * m_width + column(hash, row)]);
+		}
+		return estimate;
+	}
+
+	// Both sketches must have the same dimensions
+	void merge(const CountMinSketch& other) noexcept {
+		for (size_t index = 0; index < m_counters.size(); index++) {
+			m_counters[index] += other.m_counters[index];
+		}
+	}
+
+	void clear() noexcept {
+		std::fill(m_counters.begin(), m_counters.end(), uint64_t(0));
+	}
+
+private:
+	size_t m_width;
+	size_t m_depth;
+	std::vector<uint64_t> m_counters;
+
+	// double hashing : row i uses h1 + i * h2
+	size_t column(uint64_t hash, size_t row) const noexcept {
+		uint64_t h1 = hash & 0xffffffffull;
+		uint64_t h2 = (hash >> 32) | 1;
+		return size_t((h1 + row * h2) & (m_width - 1));
+	}
+};
+
+/**
+ * The k most frequent items of a stream : a Count-Min sketch counts every item and a min heap
+ * keeps the k items with the largest estimates, so memory is fixed by k and the sketch size.
+ * Items that cannot enter the heap cost one sketch update and a comparison with its minimum.
+ */
+class HeavyHitters {
+public:
+	struct Candidate {
+		std::string item;
+		uint64_t hash;
+		uint64_t estimate;
+	};
+
+	HeavyHitters(size_t k = 10, size_t width = 2048, size_t depth = 4) : m_k(std::max<size_t>(k, 1)), m_sketch(width, depth) {
+		m_candidates.reserve(m_k);
+	}
+
+	void add(std::string_view item, uint64_t hash, uint64_t count = 1) {
+		offer(item, hash, m_sketch.add(hash, count));
+	}
+
+	// Combines the counts of both streams and keeps the top k of the union
+	void merge(const HeavyHitters& other) {
+		m_sketch.merge(other.m_sketch);
+		for (auto& candidate : m_candidates) {
+			candidate.estimate = m_sketch.estimate(candidate.hash);
+		}
+		std::make_heap(m_candidates.begin(), m_candidates.end(), lessFrequent);
+		for (const auto& candidate : other.m_candidates) {
+			offer(candidate.item, candidate.hash, m_sketch.estimate(candidate.hash));
+		}
+	}
+
+	// The candidates, most frequent first
+	void getTop(std::vector<Candidate>& top) const {
+		top.assign(m_candidates.begin(), m_candidates.end());
+		std::sort(top.begin(), top.end(), [](const Candidate& left, const Candidate& right) {
+			return left.estimate != right.estimate ? left.estimate > right.estimate : left.item < right.item;
+		});
+	}
+
+	void clear() noexcept {
+		m_sketch.clear();
+		m_candidates.clear();
+	}
+
+private:
+	size_t m_k;
+	CountMinSketch m_sketch;
+	// min heap on the estimate
+	std::vector<Candidate> m_candidates;
+
+	static bool lessFrequent(const Candidate& left, const Candidate& right) noexcept {
+		return left.estimate > right.estimate;
+	}
+
+	void offer(std::string_view item, uint64_t hash, uint64_t estimate) {
+		if (m_candidates.size() == m_k && estimate <= m_candidates.front().estimate) {
+			return;
+		}
+		for (auto& candidate : m_candidates) {
+			if (candidate.hash == hash && candidate.item == item) {
+				candidate.estimate = std::max(candidate.estimate, estimate);
+				std::make_heap(m_candidates.begin(), m_candidates.end(), lessFrequent);
+				return;
+			}
+		}
+		if (m_candidates.size() < m_k) {
+			m_candidates.push_back(Candidate{ std::string(item), hash, estimate });
+			std::push_heap(m_candidates.begin(), m_candidates.end(), lessFrequent);
+			return;
+		}
+		// replaces the least frequent candidate, reusing its string
+		std::pop_heap(m_candidates.begin(), m_candidates.end(), lessFrequent);
+		auto& replaced = m_candidates.back();
+		replaced.item.assign(item.data(), item.size());
+		replaced.hash = hash;
+		replaced.estimate = estimate;
+		std::push_heap(m_candidates.begin(), m_candidates.end(), lessFrequent);
+	}
+};
+
+enum class SketchKind {
+	DistinctCount,
+	HeavyHitters
+};
+
+inline std::string sketchKindToString(SketchKind kind) {
+	switch (kind) {
+	case SketchKind::DistinctCount:
+		return "DistinctCount";
+	case SketchKind::HeavyHitters:
+		return "HeavyHitters";
+	default:
+		return "UnknownSketch";
+	}
+}
+
+// Sketches of one pass over the input, plus one partial per chunk for parallel blocks
+struct SketchState {
+	HyperLogLog distinct;
+	HeavyHitters hitters;
+	std::vector<HyperLogLog> partialDistinct;
+	std::vector<HeavyHitters> partialHitters;
+	bool headerPending = true;
+	size_t column = 0;
+
+	explicit SketchState(size_t k = 10) : hitters(k) {}
+};
+
+/**
+ * Feeds the items of a text input to a sketch : the fields of one column of CSV input (header
+ * line first) or, without a column, the whitespace separated tokens of any text.
+ *
+ * Input comes in blocks of complete lines. Large blocks are split into line aligned chunks, each
+ * chunk is sketched on the ThreadPool into a partial that is merged back in chunk order, so the
+ * state stays a few sketches whatever the size of the input.
+ */
+class SketchCounter {
+public:
+	static constexpr size_t ParallelThreshold = 1 << 20;
+
+	SketchCounter(SketchKind kind, std::string column, size_t k)
+		: m_kind(kind), m_column(std::move(column)), m_k(std::max<size_t>(k, 1)) {}
+
+	SketchKind getKind() const noexcept {
+		return m_kind;
+	}
+	const std::string& getColumn() const noexcept {
+		return m_column;
+	}
+	size_t getK() const noexcept {
+		return m_k;
+	}
+
+	SketchState createState() const {
+		return SketchState(m_k);
+	}
+
+	void begin(SketchState& state) const {
+		state.distinct.clear();
+		state.hitters.clear();
+		state.headerPending = !m_column.empty();
+	}
+
+	// Goes on with the sketch of the earlier texts for a text that starts with the header line again
+	void resume(SketchState& state) const {
+		state.headerPending = !m_column.empty();
+	}
+
+	/**
+	 * Sketches a block of complete lines.
+	 * @throws InvalidInput if the column is not in the header.
+	 */
+	void add(std::string_view lines, SketchState& state) const {
+		if (state.headerPending) {
+			std::vector<std::string_view> header;
+			std::string_view body;
+			Csv::splitFields(Csv::splitHeader(lines, body), header);
+			state.column = Csv::findColumn(header, m_column);
+			state.headerPending = false;
+			lines = body;
+		}
+		auto& pool = ThreadPool::getInstance();
+		if (lines.size() < ParallelThreshold) {
+			addItems(lines, state.column, state.distinct, state.hitters);
+			return;
+		}
+		auto chunks = Csv::splitIntoChunks(lines, pool.getThreadCount() + 1);
+		while (state.partialDistinct.size() < chunks.size()) {
+			state.partialDistinct.emplace_back();
+			state.partialHitters.emplace_back(m_k);
+		}
+		pool.parallelFor(chunks.size(), [&](size_t chunk) {
+			state.partialDistinct[chunk].clear();
+			state.partialHitters[chunk].clear();
+			addItems(chunks[chunk], state.column, state.partialDistinct[chunk], state.partialHitters[chunk]);
+		});
+		for (size_t chunk = 0; chunk < chunks.size(); chunk++) {
+			state.distinct.merge(state.partialDistinct[chunk]);
+			state.hitters.merge(state.partialHitters[chunk]);
+		}
+	}
+
+	// Writes the distinct count, or "item,estimate" rows of the heavy hitters
+	void finish(const SketchState& state, std::string& result) const {
+		if (m_kind == SketchKind::DistinctCount) {
+			Csv::appendNumber(result, std::round(state.distinct.estimate()));
+			return;
+		}
+		std::vector<HeavyHitters::Candidate> top;
+		state.hitters.getTop(top);
+		result += "item,estimate\n";
+		for (const auto& candidate : top) {
+			Csv::appendField(result, candidate.item);
+			result += ',';
+			Csv::appendNumber(result, double(candidate.estimate));
+			result += '\n';
+		}
+	}
+
+	void sketchAll(std::string_view text, SketchState& state, std::string& result) const {
+		begin(state);
+		add(text, state);
+		finish(state, result);
+	}
+
+private:
+	SketchKind m_kind;
+	std::string m_column;
+	size_t m_k;
+
+	void addItems(std::string_view lines, size_t column, HyperLogLog& distinct, HeavyHitters& hitters) const {
+		auto addItem = [&](std::string_view item) {
+			uint64_t hash = mixHash(hashKey(item));
+			if (m_kind == SketchKind::DistinctCount) {
+				distinct.add(hash);
+			}
+			else {
+				hitters.add(item, hash);
+			}
+		};
+		if (m_column.empty()) {
+			static const DelimiterSet whitespace;
+			forEachToken(lines, whitespace, addItem);
+			return;
+		}
+		std::vector<std::string_view> fields;
+		Csv::forEachLine(lines, [&](std::string_view line) {
+			Csv::splitFields(line, fields);
+			addItem(Csv::fieldAt(fields, column));
+		});
+	}
+};
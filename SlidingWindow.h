@@ -0,0 +1,230 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <cstdint>
+
+enum class WindowStatistic {
+	Sum,
+	Mean,
+	Min,
+	Max,
+	Count
+};
+
+inline std::string windowStatisticToString(WindowStatistic statistic) {
+	switch (statistic) {
+	case WindowStatistic::Sum:
+		return "Sum";
+	case WindowStatistic::Mean:
+		return "Mean";
+	case WindowStatistic::Min:
+		return "Min";
+	case WindowStatistic::Max:
+		return "Max";
+	case WindowStatistic::Count:
+		return "Count";
+	default:
+		return "UnknownStatistic";
+	}
+}
+
+// FIFO over a power of two ring that only grows, so a window that reached its size no longer allocates
+template <typename T>
+class RingBuffer {
+public:
+	explicit RingBuffer(size_t capacity = 16) {
+		size_t size = 1;
+		while (size < capacity) size <<= 1;
+		m_items.resize(size);
+	}
+	bool empty() const noexcept {
+		return m_size == 0;
+	}
+	size_t size() const noexcept {
+		return m_size;
+	}
+	T& front() noexcept {
+		return m_items[m_head];
+	}
+	const T& front() const noexcept {
+		return m_items[m_head];
+	}
+	T& back() noexcept {
+		return m_items[(m_head + m_size - 1) & (m_items.size() - 1)];
+	}
+	void push_back(const T& item) {
+		if (m_size == m_items.size()) grow();
+		m_items[(m_head + m_size) & (m_items.size() - 1)] = item;
+		m_size++;
+	}
+	void pop_front() noexcept {
+		m_head = (m_head + 1) & (m_items.size() - 1);
+		m_size--;
+	}
+	void pop_back() noexcept {
+		m_size--;
+	}
+	void clear() noexcept {
+		m_head = 0;
+		m_size = 0;
+	}
+private:
+	std::vector<T> m_items;
+	size_t m_head = 0;
+	size_t m_size = 0;
+
+	void grow() {
+		std::vector<T> items(m_items.size() * 2);
+		for (size_t index = 0; index < m_size; index++) {
+			items[index] = m_items[(m_head + index) & (m_items.size() - 1)];
+		}
+		m_items.swap(items);
+		m_head = 0;
+	}
+};
+
+/**
+ * Sum, mean, min and max over the last N samples and / or the last T seconds of a stream.
+ *
+ * The running sum is updated on every push and eviction. Min and max use monotonic deques : a
+ * sample is dropped from the max deque as soon as a larger one arrives after it, so the front is
+ * always the maximum of the window. Every sample enters and leaves each deque once, which makes a
+ * push amortized O(1) whatever the window size.
+ */
+class SlidingWindow {
+public:
+	/**
+	 * @param maxSamples Keep at most this many samples, 0 for no count limit.
+	 * @param maxSeconds Keep only samples newer than this many seconds, 0 for no time limit.
+	 */
+	SlidingWindow(size_t maxSamples = 0, double maxSeconds = 0.0)
+		: m_maxSamples(maxSamples), m_maxSeconds(maxSeconds) {}
+
+	void push(double value, double timestamp) {
+		Sample sample{ value, timestamp, m_nextSequence++ };
+		m_samples.push_back(sample);
+		m_sum += value;
+
+		while (!m_maxima.empty() && m_maxima.back().value <= value) m_maxima.pop_back();
+		m_maxima.push_back(sample);
+		while (!m_minima.empty() && m_minima.back().value >= value) m_minima.pop_back();
+		m_minima.push_back(sample);
+
+		evict(timestamp);
+	}
+
+	// Pushes every number of a text stream; "timestamp,value" lines carry their own time, lines with more columns are skipped
+	void pushText(std::string_view text, double now) {
+		size_t position = 0;
+		while (position < text.size()) {
+			size_t end = text.find('\n', position);
+			if (end == std::string_view::npos) end = text.size();
+			std::string_view line = text.substr(position, end - position);
+			position = end + 1;
+
+			double timestamp = now;
+			size_t comma = line.find(',');
+			if (comma != std::string_view::npos) {
+				if (line.find(',', comma + 1) != std::string_view::npos || !parse(line.substr(0, comma), timestamp)) continue;
+				line = line.substr(comma + 1);
+			}
+			while (!line.empty()) {
+				size_t start = line.find_first_not_of(" \t\r");
+				if (start == std::string_view::npos) break;
+				size_t stop = line.find_first_of(" \t\r", start);
+				if (stop == std::string_view::npos) stop = line.size();
+				double value;
+				if (parse(line.substr(start, stop - start), value)) {
+					push(value, timestamp);
+				}
+				line = line.substr(stop);
+			}
+		}
+	}
+
+	// Drops the samples that fell out of the time window without pushing a new one
+	void advanceTo(double timestamp) {
+		evict(timestamp);
+	}
+
+	size_t count() const noexcept {
+		return m_samples.size();
+	}
+	double sum() const noexcept {
+		return m_sum;
+	}
+	double mean() const noexcept {
+		return m_samples.empty() ? 0.0 : m_sum / double(m_samples.size());
+	}
+	double min() const noexcept {
+		return m_minima.empty() ? 0.0 : m_minima.front().value;
+	}
+	double max() const noexcept {
+		return m_maxima.empty() ? 0.0 : m_maxima.front().value;
+	}
+	double get(WindowStatistic statistic) const noexcept {
+		switch (statistic) {
+		case WindowStatistic::Sum:
+			return sum();
+		case WindowStatistic::Mean:
+			return mean();
+		case WindowStatistic::Min:
+			return min();
+		case WindowStatistic::Max:
+			return max();
+		case WindowStatistic::Count:
+			return double(count());
+		default:
+			return 0.0;
+		}
+	}
+
+	void clear() noexcept {
+		m_samples.clear();
+		m_maxima.clear();
+		m_minima.clear();
+		m_sum = 0.0;
+	}
+
+private:
+	struct Sample {
+		double value;
+		double timestamp;
+		uint64_t sequence;
+	};
+
+	size_t m_maxSamples;
+	double m_maxSeconds;
+	RingBuffer<Sample> m_samples;
+	RingBuffer<Sample> m_maxima;
+	RingBuffer<Sample> m_minima;
+	double m_sum = 0.0;
+	uint64_t m_nextSequence = 0;
+
+	void evict(double now) {
+		while (!m_samples.empty() &&
+			((m_maxSamples != 0 && m_samples.size() > m_maxSamples) ||
+			 (m_maxSeconds > 0.0 && m_samples.front().timestamp <= now - m_maxSeconds))) {
+			const Sample& oldest = m_samples.front();
+			m_sum -= oldest.value;
+			if (!m_maxima.empty() && m_maxima.front().sequence == oldest.sequence) m_maxima.pop_front();
+			if (!m_minima.empty() && m_minima.front().sequence == oldest.sequence) m_minima.pop_front();
+			m_samples.pop_front();
+		}
+		if (m_samples.empty()) {
+			// resets the rounding error the running sum accumulated
+			m_sum = 0.0;
+		}
+	}
+
+	// The whole token must be the number, "2,3" is not 2
+	static bool parse(std::string_view token, double& value) noexcept {
+		while (!token.empty() && (token.front() == ' ' || token.front() == '\t')) token.remove_prefix(1);
+		while (!token.empty() && (token.back() == ' ' || token.back() == '\t' || token.back() == '\r')) token.remove_suffix(1);
+		if (!token.empty() && token.front() == '+') token.remove_prefix(1);
+		auto result = std::from_chars(token.data(), token.data() + token.size(), value);
+		return result.ec == std::errc() && result.ptr == token.data() + token.size();
+	}
+};
@@ -0,0 +1,344 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <algorithm>
+
+#include "Csv.h"
+#include "filesystem.h"
+
+struct SortKey {
+	std::string column;
+	bool descending = false;
+};
+
+// Reads "city, -amount" as city ascending then amount descending
+inline std::vector<SortKey> parseSortKeys(std::string_view list) {
+	std::vector<SortKey> keys;
+	size_t position = 0;
+	while (position <= list.size()) {
+		size_t end = list.find(',', position);
+		if (end == std::string_view::npos) end = list.size();
+		auto part = list.substr(position, end - position);
+		position = end + 1;
+
+		size_t first = part.find_first_not_of(" \t");
+		if (first == std::string_view::npos) continue;
+		part = part.substr(first, part.find_last_not_of(" \t") - first + 1);
+		SortKey key;
+		if (part.front() == '-' || part.front() == '+') {
+			key.descending = part.front() == '-';
+			part.remove_prefix(1);
+		}
+		key.column.assign(part.data(), part.size());
+		keys.push_back(std::move(key));
+	}
+	return keys;
+}
+
+/**
+ * Sorts the rows of CSV text (header line first) by one or more key columns.
+ *
+ * A key compares numerically when both fields are numbers and as text otherwise; numbers order
+ * before text. The sort is stable, so equal rows keep their input order.
+ *
+ * Rows are gathered into a run until the run reaches the memory budget. When the whole input fits
+ * it is sorted in memory; otherwise every full run is sorted and spilled to a TemporaryFile and
+ * finish() k way merges the runs through a heap, reading each one through a buffer that shares
+ * the same budget.
+ *
+ * Usage : begin(header, result), add(lines) for every block of complete lines, finish(result).
+ * To write a large result out without holding it, call complete() instead of finish and take the
+ * rows block by block with next(); the runs are then merged as the blocks are taken.
+ */
+class ExternalSorter {
+public:
+	static constexpr size_t DefaultMemoryBudget = size_t(256) << 20;
+	// Smallest read buffer of a run while merging
+	static constexpr size_t MinimumMergeBuffer = size_t(64) << 10;
+
+	ExternalSorter(std::vector<SortKey> keys, size_t memoryBudget = DefaultMemoryBudget)
+		: m_keys(std::move(keys)), m_memoryBudget(std::max(memoryBudget, MinimumMergeBuffer)) {}
+
+	size_t getRunCount() const noexcept {
+		return m_runs.size();
+	}
+
+	/**
+	 * Resolves the key columns, copies the header to the result and drops the runs of a previous sort.
+	 * @throws InvalidInput if a key column is not in the header.
+	 */
+	void begin(std::string_view headerLine, std::string& result) {
+		headerLine = Csv::trimLineEnd(headerLine);
+		Csv::splitFields(headerLine, m_fields);
+		m_columns.clear();
+		for (const auto& key : m_keys) {
+			m_columns.push_back(Csv::findColumn(m_fields, key.column));
+		}
+		result.append(headerLine.data(), headerLine.size());
+		result += '\n';
+		m_runs.clear();
+		m_runText.clear();
+		m_readers.clear();
+		m_heap.clear();
+		m_pending = false;
+	}
+
+	// Adds a run of complete lines, spilling the current run once it is over the budget
+	void add(std::string_view lines) {
+		Csv::forEachLine(lines, [&](std::string_view line) {
+			m_runText.append(line.data(), line.size());
+			m_runText += '\n';
+			m_runRows++;
+			if (runMemory() >= m_memoryBudget) {
+				spill();
+			}
+		});
+	}
+
+	// Appends the sorted rows to the result
+	void finish(std::string& result) {
+		complete();
+		while (next(result, size_t(-1))) {}
+	}
+
+	// Ends the input; the sorted rows are then taken with next
+	void complete() {
+		if (m_runs.empty()) {
+			sortRows(m_runText);
+			m_nextRow = 0;
+		}
+		else {
+			if (!m_runText.empty()) spill();
+			startMerge();
+		}
+		m_pending = true;
+	}
+
+	/**
+	 * Appends sorted rows to block until it holds at least blockSize bytes.
+	 * @return false once every row was appended.
+	 */
+	bool next(std::string& block, size_t blockSize) {
+		if (!m_pending) return false;
+		if (m_readers.empty()) {
+			for (; m_nextRow < m_order.size() && block.size() < blockSize; m_nextRow++) {
+				const auto row = m_rows[m_order[m_nextRow]];
+				block.append(row.data(), row.size());
+				block += '\n';
+			}
+			if (m_nextRow < m_order.size()) return true;
+		}
+		else {
+			auto after = [this](size_t left, size_t right) { return mergesAfter(left, right); };
+			while (!m_heap.empty() && block.size() < blockSize) {
+				std::pop_heap(m_heap.begin(), m_heap.end(), after);
+				auto& reader = m_readers[m_heap.back()];
+				block.append(reader.line.data(), reader.line.size());
+				block += '\n';
+				if (reader.next()) {
+					parseKeys(reader.line, reader.keys.data());
+					std::push_heap(m_heap.begin(), m_heap.end(), after);
+				}
+				else {
+					m_heap.pop_back();
+				}
+			}
+			if (!m_heap.empty()) return true;
+			m_readers.clear();
+		}
+		m_runText.clear();
+		m_runRows = 0;
+		m_pending = false;
+		return false;
+	}
+
+	// Whether complete() left rows that next has not appended yet
+	bool hasPendingRows() const noexcept {
+		return m_pending;
+	}
+
+	// Sorts CSV text held in memory; when it fits in the budget the rows are sorted where they are
+	void sort(std::string_view text, std::string& result) {
+		std::string_view body;
+		begin(Csv::splitHeader(text, body), result);
+		if (body.size() + estimateRows(body.size()) * rowOverhead() < m_memoryBudget) {
+			sortRows(body);
+			appendRows(result);
+			return;
+		}
+		add(body);
+		finish(result);
+	}
+
+private:
+	struct KeyField {
+		double number;
+		std::string_view text;
+		bool numeric;
+	};
+
+	// Reads the lines of a spilled run back one at a time
+	struct RunReader {
+		std::unique_ptr<TemporaryFile> file;
+		std::string buffer;
+		size_t position = 0;
+		size_t filled = 0;
+		std::string_view line;
+		std::vector<KeyField> keys;
+
+		bool next() {
+			while (true) {
+				auto pending = std::string_view(buffer.data() + position, filled - position);
+				size_t end = pending.find('\n');
+				if (end != std::string_view::npos) {
+					line = Csv::trimLineEnd(pending.substr(0, end));
+					position += end + 1;
+					return true;
+				}
+				// move the partial line to the front and read more, growing for lines longer than the buffer
+				std::memmove(&buffer[0], buffer.data() + position, pending.size());
+				filled = pending.size();
+				position = 0;
+				if (filled == buffer.size()) buffer.resize(buffer.size() * 2);
+				size_t read = file->read(&buffer[filled], buffer.size() - filled);
+				if (read == 0) {
+					if (filled == 0) return false;
+					line = std::string_view(buffer.data(), filled);
+					position = filled;
+					return true;
+				}
+				filled += read;
+			}
+		}
+	};
+
+	std::vector<SortKey> m_keys;
+	size_t m_memoryBudget;
+	std::vector<size_t> m_columns;
+	std::vector<std::string_view> m_fields;
+	// the run being gathered, one line per row
+	std::string m_runText;
+	size_t m_runRows = 0;
+	std::vector<std::unique_ptr<TemporaryFile>> m_runs;
+	// the rows being sorted, their key fields (m_keys.size() per row) and their sorted order
+	std::vector<std::string_view> m_rows;
+	std::vector<KeyField> m_keyFields;
+	std::vector<uint32_t> m_order;
+	// rows left once the input ended : the in memory run from m_nextRow, or the spilled runs being merged
+	bool m_pending = false;
+	size_t m_nextRow = 0;
+	std::vector<RunReader> m_readers;
+	std::vector<size_t> m_heap;
+
+	size_t rowOverhead() const noexcept {
+		return sizeof(std::string_view) + sizeof(uint32_t) + m_keys.size() * sizeof(KeyField);
+	}
+	size_t runMemory() const noexcept {
+		return m_runText.size() + m_runRows * rowOverhead();
+	}
+	static size_t estimateRows(size_t bytes) noexcept {
+		// assumes rows of at least 16 bytes
+		return bytes / 16 + 1;
+	}
+
+	void parseKeys(std::string_view line, KeyField* keys) {
+		Csv::splitFields(line, m_fields);
+		for (size_t key = 0; key < m_columns.size(); key++) {
+			auto field = Csv::fieldAt(m_fields, m_columns[key]);
+			keys[key].text = field;
+			keys[key].numeric = Csv::parseNumber(field, keys[key].number);
+		}
+	}
+
+	int compare(const KeyField* left, const KeyField* right) const noexcept {
+		for (size_t key = 0; key < m_keys.size(); key++) {
+			int order;
+			if (left[key].numeric && right[key].numeric) {
+				order = left[key].number < right[key].number ? -1 : (right[key].number < left[key].number ? 1 : 0);
+			}
+			else if (left[key].numeric != right[key].numeric) {
+				order = left[key].numeric ? -1 : 1;
+			}
+			else {
+				order = left[key].text.compare(right[key].text);
+				order = order < 0 ? -1 : (order > 0 ? 1 : 0);
+			}
+			if (order != 0) return m_keys[key].descending ? -order : order;
+		}
+		return 0;
+	}
+
+	// Sorts the lines of text into m_order; the rows are views into text
+	void sortRows(std::string_view text) {
+		m_rows.clear();
+		Csv::forEachLine(text, [&](std::string_view line) {
+			m_rows.push_back(line);
+		});
+		const size_t keyCount = m_keys.size();
+		m_keyFields.resize(m_rows.size() * keyCount);
+		m_order.resize(m_rows.size());
+		for (uint32_t row = 0; row < m_rows.size(); row++) {
+			parseKeys(m_rows[row], &m_keyFields[row * keyCount]);
+			m_order[row] = row;
+		}
+		std::stable_sort(m_order.begin(), m_order.end(), [this, keyCount](uint32_t left, uint32_t right) {
+			return compare(&m_keyFields[left * keyCount], &m_keyFields[right * keyCount]) < 0;
+		});
+	}
+
+	void appendRows(std::string& result) const {
+		for (auto row : m_order) {
+			result.append(m_rows[row].data(), m_rows[row].size());
+			result += '\n';
+		}
+	}
+
+	void spill() {
+		sortRows(m_runText);
+		auto run = FileSystem::getInstance()->createTemporaryFile("flowbuilder_sort");
+		std::string block;
+		block.reserve(MinimumMergeBuffer * 2);
+		for (auto row : m_order) {
+			block.append(m_rows[row].data(), m_rows[row].size());
+			block += '\n';
+			if (block.size() >= MinimumMergeBuffer) {
+				run->write(block);
+				block.clear();
+			}
+		}
+		run->write(block);
+		run->rewind();
+		m_runs.push_back(std::move(run));
+		m_runText.clear();
+		m_runRows = 0;
+	}
+
+	void startMerge() {
+		// the run text is no longer needed, its memory goes to the read buffers
+		std::string().swap(m_runText);
+		const size_t bufferSize = std::max(MinimumMergeBuffer, m_memoryBudget / m_runs.size());
+		m_readers.clear();
+		m_readers.resize(m_runs.size());
+		m_heap.clear();
+		for (size_t run = 0; run < m_runs.size(); run++) {
+			auto& reader = m_readers[run];
+			reader.file = std::move(m_runs[run]);
+			reader.buffer.resize(bufferSize);
+			reader.keys.resize(m_keys.size());
+			if (reader.next()) {
+				parseKeys(reader.line, reader.keys.data());
+				m_heap.push_back(run);
+			}
+		}
+		std::make_heap(m_heap.begin(), m_heap.end(), [this](size_t left, size_t right) { return mergesAfter(left, right); });
+		m_runs.clear();
+	}
+
+	// The top of the heap is the smallest row; equal rows come from the earlier run, which keeps the sort stable
+	bool mergesAfter(size_t left, size_t right) const noexcept {
+		int order = compare(m_readers[left].keys.data(), m_readers[right].keys.data());
+		return order > 0 || (order == 0 && left > right);
+	}
+};
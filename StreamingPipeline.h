@@ -0,0 +1,602 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <unordered_map>
+#include <deque>
+#include <fstream>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <cstring>
+
+#include "ExecutionPlan.h"
+#include "Parallel.h"
+
+enum class StreamEvent {
+	// first line of the text, with its line break
+	Header,
+	// complete lines following the header
+	Lines,
+	End
+};
+
+// Piece of text flowing between two stages, shared by every consumer of the producing stage
+struct StreamMessage {
+	StreamEvent event = StreamEvent::End;
+	// dependency of the consumer that produced it
+	uint32_t input = 0;
+	std::shared_ptr<const std::string> text;
+};
+
+/**
+ * Streaming execution of a plan over line oriented text : every node is a stage, and stages hand
+ * batches of complete lines to their consumers through bounded lock free queues. Reading, filtering
+ * and writing overlap instead of running one after the other, and a full queue stalls its producer,
+ * so the text in flight is bounded by the queue capacity times the batch size on every edge.
+ *
+ * Stages do not own threads : the workers of the ThreadPool, at most one per stage, take turns on
+ * the stages, each turn handling one batch. A stage whose input is empty or whose consumers are
+ * full is skipped until it can move on, so any number of stages runs on a few cores.
+ *
+ * Inputs, texts and titles are sources, filters stream, sorts, searches and sketches consume
+ * their whole input before emitting their result, displays show everything once their inputs
+ * ended and outputs write their first dependency as it arrives, through ResultSink::openOutput.
+ * Sorts emit their rows in batches while merging, the other inputs of an output are spilled to a
+ * temporary file past a batch, and a display shows at most MaxDisplaySize bytes of each input.
+ * Otherwise the results are the ones ExecutionContext::run produces for the same bindings.
+ */
+class StreamingPipeline {
+public:
+	typedef ExecutionPlan::Index Index;
+
+	static constexpr size_t DefaultQueueCapacity = 16;
+	static constexpr size_t DefaultBatchSize = size_t(1) << 16;
+	static constexpr size_t MaxDisplaySize = size_t(4) << 20;
+
+	/**
+	 * The files of the FileInput nodes are resolved here, on the calling thread.
+	 * @throws InvalidInput if the plan holds a node that cannot stream, see canStream.
+	 */
+	explicit StreamingPipeline(const ExecutionPlan& plan, size_t queueCapacity = DefaultQueueCapacity, size_t batchSize = DefaultBatchSize)
+		: m_plan(plan), m_graph(plan.getGraph()), m_queueCapacity(queueCapacity), m_batchSize(std::max<size_t>(1, batchSize)),
+		m_stageOf(plan.getSlotCount(), NoStage) {
+		auto fileSystem = FileSystem::getInstance();
+		for (Index slot = 0; slot < plan.getSlotCount(); slot++) {
+			auto type = m_graph.getType(slot);
+			if (type == NodeType::End) continue;
+			if (!canStream(type)) {
+				throw InvalidInput((nodeTypeToString(type) + " nodes cannot be streamed").c_str());
+			}
+			m_stageOf[slot] = m_stages.size();
+			m_stages.emplace_back();
+			auto& stage = m_stages.back();
+			stage.slot = slot;
+			stage.type = type;
+			stage.inputCount = m_graph.getDependencies(slot).size();
+			if (type == NodeType::FileInput) {
+				auto& node = static_cast<const FileInputNode&>(*m_graph.getNode(slot));
+				auto handle = fileSystem->getFileHandle(node.getFileName(), FileHandle::parseExtension(node.getExtension()));
+				if (handle != nullptr) {
+					stage.path = fileSystem->getInputFilePath(handle.get());
+				}
+			}
+		}
+		for (size_t index = 0; index < m_stages.size(); index++) {
+			auto dependencies = m_graph.getDependencies(m_stages[index].slot);
+			for (size_t input = 0; input < dependencies.size(); input++) {
+				if (m_stageOf[dependencies[input]] == NoStage) {
+					throw InvalidInput("End nodes cannot be the input of a streamed node");
+				}
+				m_stages[m_stageOf[dependencies[input]]].consumers.push_back({ index, uint32_t(input) });
+			}
+		}
+	}
+
+	static bool canStream(NodeType type) noexcept {
+		switch (type) {
+		case NodeType::TextInput:
+		case NodeType::FileInput:
+		case NodeType::Text:
+		case NodeType::Title:
+		case NodeType::Filter:
+		case NodeType::Sort:
+		case NodeType::Search:
+		case NodeType::Sketch:
+		case NodeType::Display:
+		case NodeType::Output:
+		case NodeType::End:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// Binds the content of a TextInput or FileInput node; unbound file inputs stream from their file
+	void bindText(NodeUid uid, std::string_view text) {
+		auto slot = m_plan.getSlot(uid);
+		auto type = m_graph.getType(slot);
+		if (type != NodeType::TextInput && type != NodeType::FileInput) {
+			throw InvalidInput(("Node " + std::to_string(uid) + " of type " + nodeTypeToString(type) + " cannot hold a text").c_str());
+		}
+		m_texts[slot].assign(text.data(), text.size());
+	}
+
+	/**
+	 * Runs every stage to completion. Displays reach the sink from the workers one at a time;
+	 * outputs are opened before and closed after the run, on the calling thread.
+	 * The first exception thrown by a stage stops the others and is rethrown here.
+	 * @throws InvalidHandle if the file of an unbound FileInput node cannot be opened.
+	 */
+	void run(ResultSink& sink) {
+		m_failed.store(false, std::memory_order_relaxed);
+		m_error = nullptr;
+		m_finished.store(0, std::memory_order_relaxed);
+		std::vector<std::unique_ptr<OutputStream>> outputs(m_stages.size());
+		for (size_t index = 0; index < m_stages.size(); index++) {
+			auto& stage = m_stages[index];
+			stage.queue = stage.inputCount == 0 ? nullptr : std::make_unique<BoundedQueue<StreamMessage>>(m_queueCapacity);
+			stage.state = std::make_unique<StageState>();
+			if (stage.type == NodeType::Output) {
+				outputs[index] = sink.openOutput(static_cast<const OutputNode&>(*m_graph.getNode(stage.slot)));
+				stage.state->output = outputs[index].get();
+			}
+			startStage(stage);
+		}
+
+		std::mutex displayMutex;
+		SerializedResultSink displays(sink, displayMutex);
+		auto& pool = ThreadPool::getInstance();
+		const size_t workers = std::min(m_stages.size(), pool.getThreadCount() + 1);
+		pool.parallelFor(workers, [this, workers, &displays](size_t worker) {
+			work(worker * m_stages.size() / workers, displays);
+		});
+		for (auto& stage : m_stages) {
+			stage.state.reset();
+			stage.queue.reset();
+		}
+		if (m_error) {
+			std::rethrow_exception(m_error);
+		}
+		for (auto& output : outputs) {
+			if (output != nullptr) output->close();
+		}
+	}
+
+private:
+	static constexpr size_t NoStage = size_t(-1);
+
+	// What a stage holds while a run is in progress, touched only by the worker holding the stage
+	struct StageState {
+		// set by the worker taking its turn on the stage, so no two workers run it at once
+		std::atomic<bool> busy{ false };
+		std::atomic<bool> done{ false };
+		// messages a full queue of their consumer did not take yet, the consumer stage first
+		std::deque<std::pair<size_t, StreamMessage>> outbox;
+		// inputs that did not end yet
+		size_t open = 0;
+		// whether every input ended and the last results were sent
+		bool ended = false;
+		// text left to send, in batches, from position; header until its first line was sent
+		std::string_view sending;
+		size_t position = 0;
+		bool header = true;
+		std::string text;
+		std::string batch;
+		std::ifstream file;
+		// Filter
+		std::vector<std::string_view> fields;
+		size_t column = 0;
+		// Sort, Search and Sketch
+		std::unique_ptr<ExternalSorter> sorter;
+		bool begun = false;
+		// whether the inputs ended and the result is being sent
+		bool sendingResult = false;
+		SearchScan scan;
+		SketchState sketch;
+		// Display and Output : the text of every input but the first output one, spilled past a batch
+		std::vector<std::string> pending;
+		std::vector<std::unique_ptr<TemporaryFile>> spilled;
+		std::vector<size_t> dropped;
+		OutputStream* output = nullptr;
+	};
+
+	struct Stage {
+		Index slot = 0;
+		NodeType type = NodeType::End;
+		size_t inputCount = 0;
+		// consumer stage and the dependency this stage is for it
+		std::vector<std::pair<size_t, uint32_t>> consumers;
+		// file a FileInput stage reads when nothing is bound
+		std::string path;
+		std::unique_ptr<BoundedQueue<StreamMessage>> queue;
+		std::unique_ptr<StageState> state;
+	};
+
+	const ExecutionPlan& m_plan;
+	const FlowGraph& m_graph;
+	size_t m_queueCapacity;
+	size_t m_batchSize;
+	std::vector<size_t> m_stageOf;
+	std::vector<Stage> m_stages;
+	std::unordered_map<Index, std::string> m_texts;
+	std::atomic<size_t> m_finished{ 0 };
+	std::atomic<bool> m_failed{ false };
+	std::mutex m_errorMutex;
+	std::exception_ptr m_error;
+
+	void fail(std::exception_ptr error) {
+		std::lock_guard<std::mutex> lock(m_errorMutex);
+		if (!m_error) {
+			m_error = error;
+		}
+		m_failed.store(true, std::memory_order_relaxed);
+	}
+
+	// Takes turns on the stages, starting from first, until every stage is done or one failed
+	void work(size_t first, ResultSink& displays) {
+		const size_t count = m_stages.size();
+		unsigned attempt = 0;
+		while (m_finished.load(std::memory_order_acquire) < count && !m_failed.load(std::memory_order_relaxed)) {
+			bool progressed = false;
+			for (size_t offset = 0; offset < count; offset++) {
+				auto& stage = m_stages[(first + offset) % count];
+				auto& state = *stage.state;
+				if (state.done.load(std::memory_order_acquire) || state.busy.exchange(true, std::memory_order_acquire)) continue;
+				try {
+					if (!state.done.load(std::memory_order_relaxed) && step(stage, displays)) {
+						progressed = true;
+						if (state.done.load(std::memory_order_relaxed)) {
+							m_finished.fetch_add(1, std::memory_order_release);
+						}
+					}
+				}
+				catch (...) {
+					fail(std::current_exception());
+				}
+				state.busy.store(false, std::memory_order_release);
+			}
+			// spins briefly, then yields, then sleeps, so idle workers leave the cores to the busy ones
+			if (progressed) {
+				attempt = 0;
+			}
+			else if (++attempt >= 128) {
+				std::this_thread::sleep_for(std::chrono::microseconds(50));
+			}
+			else if (attempt >= 64) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+	void startStage(Stage& stage) {
+		auto& state = *stage.state;
+		state.open = stage.inputCount;
+		state.pending.resize(stage.inputCount);
+		state.spilled.resize(stage.inputCount);
+		state.dropped.assign(stage.inputCount, 0);
+		const Node& node = *m_graph.getNode(stage.slot);
+		auto bound = m_texts.find(stage.slot);
+		switch (stage.type) {
+		case NodeType::TextInput:
+		case NodeType::FileInput:
+		case NodeType::Text:
+		case NodeType::Title:
+			if (bound != m_texts.end()) {
+				state.sending = bound->second;
+			}
+			else if (stage.type == NodeType::Text || stage.type == NodeType::Title) {
+				state.text = asDisplayable(&node)->getContent();
+				state.sending = state.text;
+			}
+			else if (stage.type == NodeType::FileInput) {
+				state.file.open(stage.path, std::ios::binary);
+				if (stage.path.empty() || !state.file.is_open()) {
+					throw InvalidHandle((std::string("Failed to read the input file ") + static_cast<const FileInputNode&>(node).getFileName()).c_str());
+				}
+			}
+			break;
+		case NodeType::Sort:
+			state.sorter = std::make_unique<ExternalSorter>(static_cast<const SortNode&>(node).createSorter());
+			break;
+		case NodeType::Search:
+			static_cast<const SearchNode&>(node).getSearcher().begin(state.scan, state.text);
+			break;
+		case NodeType::Sketch: {
+			const auto& counter = static_cast<const SketchNode&>(node).getCounter();
+			state.sketch = counter.createState();
+			counter.begin(state.sketch);
+			break;
+		}
+		case NodeType::Output: {
+			auto& output = static_cast<const OutputNode&>(node);
+			state.text.assign(output.getTitle());
+			state.text += '\n';
+			state.text += output.getDescription();
+			state.text += '\n';
+			state.output->append(state.text);
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	/**
+	 * One turn on a stage : the messages its consumers could not take first, then one batch.
+	 * @return false when the stage could not move on.
+	 */
+	bool step(Stage& stage, ResultSink& displays) {
+		auto& state = *stage.state;
+		bool progressed = false;
+		while (!state.outbox.empty()) {
+			auto& front = state.outbox.front();
+			if (!m_stages[front.first].queue->tryPush(front.second)) return progressed;
+			state.outbox.pop_front();
+			progressed = true;
+		}
+		if (state.ended) {
+			state.done.store(true, std::memory_order_relaxed);
+			return true;
+		}
+		if (stage.inputCount == 0) {
+			produce(stage);
+			return true;
+		}
+		StreamMessage message;
+		if (!stage.queue->tryPop(message)) {
+			if (state.open != 0) return progressed;
+			// every input ended, what is left is the result of the stage
+			finish(stage, displays);
+			return true;
+		}
+		if (message.event == StreamEvent::End) {
+			state.open--;
+		}
+		else {
+			consume(stage, message);
+		}
+		return true;
+	}
+
+	void send(Stage& stage, StreamEvent event, std::string_view text) {
+		auto shared = std::make_shared<const std::string>(text);
+		for (const auto& consumer : stage.consumers) {
+			stage.state->outbox.emplace_back(consumer.first, StreamMessage{ event, consumer.second, shared });
+		}
+	}
+
+	// Sends the lines of a batch, the first line of the stage's text as its header
+	void sendLines(Stage& stage, std::string_view lines) {
+		auto& state = *stage.state;
+		if (state.header && !lines.empty()) {
+			state.header = false;
+			size_t end = lines.find('\n');
+			end = end == std::string_view::npos ? lines.size() : end + 1;
+			send(stage, StreamEvent::Header, lines.substr(0, end));
+			lines.remove_prefix(end);
+		}
+		if (!lines.empty()) {
+			send(stage, StreamEvent::Lines, lines);
+		}
+	}
+
+	void end(Stage& stage) {
+		send(stage, StreamEvent::End, std::string_view());
+		stage.state->ended = true;
+	}
+
+	// Sends the next batch of state.sending; batches end on a line break, a longer line making a batch of its own
+	void sendNextBatch(Stage& stage) {
+		auto& state = *stage.state;
+		const auto text = state.sending;
+		if (state.position >= text.size()) {
+			end(stage);
+			return;
+		}
+		size_t end = std::min(text.size(), state.position + m_batchSize);
+		if (end < text.size()) {
+			size_t lastBreak = text.rfind('\n', end - 1);
+			if (lastBreak == std::string_view::npos || lastBreak < state.position) {
+				lastBreak = text.find('\n', end);
+			}
+			end = lastBreak == std::string_view::npos ? text.size() : lastBreak + 1;
+		}
+		sendLines(stage, text.substr(state.position, end - state.position));
+		state.position = end;
+	}
+
+	// Sources send one batch a turn, a file being read a block at a time
+	void produce(Stage& stage) {
+		auto& state = *stage.state;
+		if (stage.consumers.empty()) {
+			end(stage);
+			return;
+		}
+		if (!state.file.is_open()) {
+			sendNextBatch(stage);
+			return;
+		}
+		// the partial line at the end of a block waits in state.batch for the next one
+		while (true) {
+			const size_t carried = state.batch.size();
+			state.batch.resize(carried + m_batchSize);
+			state.file.read(&state.batch[carried], static_cast<std::streamsize>(m_batchSize));
+			const size_t filled = carried + static_cast<size_t>(state.file.gcount());
+			state.batch.resize(filled);
+			if (filled == carried) {
+				state.file.close();
+				sendLines(stage, state.batch);
+				end(stage);
+				return;
+			}
+			const size_t lastBreak = state.batch.rfind('\n');
+			if (lastBreak == std::string::npos) continue;
+			sendLines(stage, std::string_view(state.batch.data(), lastBreak + 1));
+			state.batch.erase(0, lastBreak + 1);
+			return;
+		}
+	}
+
+	static std::string_view withoutBreak(const std::string& line) noexcept {
+		std::string_view view(line);
+		if (!view.empty() && view.back() == '\n') view.remove_suffix(1);
+		return view;
+	}
+
+	void consume(Stage& stage, const StreamMessage& message) {
+		auto& state = *stage.state;
+		const Node& node = *m_graph.getNode(stage.slot);
+		switch (stage.type) {
+		case NodeType::Filter: {
+			const auto& filter = static_cast<const FilterNode&>(node).getFilter();
+			state.batch.clear();
+			if (message.event == StreamEvent::Header) {
+				state.column = filter.begin(withoutBreak(*message.text), state.fields, state.batch);
+				send(stage, StreamEvent::Header, state.batch);
+			}
+			else {
+				filter.appendMatches(*message.text, state.column, state.fields, state.batch);
+				if (!state.batch.empty()) {
+					send(stage, StreamEvent::Lines, state.batch);
+				}
+			}
+			break;
+		}
+		case NodeType::Sort:
+			if (message.event == StreamEvent::Header) {
+				state.sorter->begin(withoutBreak(*message.text), state.text);
+				state.begun = true;
+			}
+			else {
+				state.sorter->add(*message.text);
+			}
+			break;
+		case NodeType::Search:
+			static_cast<const SearchNode&>(node).getSearcher().search(*message.text, state.scan, state.text);
+			break;
+		case NodeType::Sketch:
+			static_cast<const SketchNode&>(node).getCounter().add(*message.text, state.sketch);
+			break;
+		case NodeType::Display:
+			keepDisplayed(state, message);
+			break;
+		case NodeType::Output:
+			if (message.input == 0) {
+				state.output->append(*message.text);
+			}
+			else {
+				keepPending(state, message);
+			}
+			break;
+		default:
+			break;
+		}
+	}
+
+	// Runs once every input ended, a turn at a time until the stage ends
+	void finish(Stage& stage, ResultSink& displays) {
+		auto& state = *stage.state;
+		const Node& node = *m_graph.getNode(stage.slot);
+		switch (stage.type) {
+		case NodeType::Sort:
+			// the header went to state.text in begin, the rows follow a batch a turn
+			if (!state.begun) break;
+			if (!state.sendingResult) {
+				state.sorter->complete();
+				state.sendingResult = true;
+			}
+			if (state.sorter->next(state.text, m_batchSize)) {
+				sendLines(stage, state.text);
+				state.text.clear();
+				return;
+			}
+			sendLines(stage, state.text);
+			break;
+		case NodeType::Search:
+		case NodeType::Sketch:
+			if (!state.sendingResult) {
+				state.sendingResult = true;
+				if (stage.type == NodeType::Search) {
+					static_cast<const SearchNode&>(node).getSearcher().finish(state.scan, state.text);
+				}
+				else {
+					static_cast<const SketchNode&>(node).getCounter().finish(state.sketch, state.text);
+				}
+				state.sending = state.text;
+			}
+			sendNextBatch(stage);
+			return;
+		case NodeType::Display:
+			showDisplay(stage, static_cast<const DisplayNode&>(node), displays);
+			break;
+		case NodeType::Output:
+			writePending(stage, static_cast<const OutputNode&>(node));
+			break;
+		default:
+			break;
+		}
+		end(stage);
+	}
+
+	// Keeps what a display can show of an input, counting the bytes past MaxDisplaySize
+	static void keepDisplayed(StageState& state, const StreamMessage& message) {
+		auto& text = state.pending[message.input];
+		const size_t room = MaxDisplaySize - std::min(MaxDisplaySize, text.size());
+		const size_t kept = std::min(room, message.text->size());
+		text.append(message.text->data(), kept);
+		state.dropped[message.input] += message.text->size() - kept;
+	}
+
+	// Same text as ExecutionContext : the inputs joined by spaces
+	void showDisplay(Stage& stage, const DisplayNode& node, ResultSink& displays) {
+		auto& state = *stage.state;
+		std::string content;
+		for (size_t index = 0; index < state.pending.size(); index++) {
+			content += state.pending[index];
+			if (state.dropped[index] != 0) {
+				content += "... (" + std::to_string(state.dropped[index]) + " more bytes)";
+			}
+			if (index + 1 < state.pending.size()) content += ' ';
+		}
+		displays.onDisplay(node, content);
+	}
+
+	// The inputs of an output after the first one wait for it to end, on disk once they outgrow a batch
+	void keepPending(StageState& state, const StreamMessage& message) {
+		auto& text = state.pending[message.input];
+		text += *message.text;
+		if (text.size() < m_batchSize) return;
+		auto& file = state.spilled[message.input];
+		if (file == nullptr) {
+			file = FileSystem::getInstance()->createTemporaryFile("flowbuilder_stream");
+		}
+		file->write(text);
+		text.clear();
+	}
+
+	// Same text as ExecutionContext, the first input written as it arrived and the others now
+	void writePending(Stage& stage, const OutputNode& node) {
+		auto& state = *stage.state;
+		auto& output = *state.output;
+		const char delim = std::strcmp(node.getExtension(), ".csv") == 0 ? ',' : ' ';
+		for (size_t index = 0; index < state.pending.size(); index++) {
+			if (auto& file = state.spilled[index]) {
+				file->rewind();
+				state.batch.resize(m_batchSize);
+				for (size_t read; (read = file->read(&state.batch[0], m_batchSize)) != 0;) {
+					output.append(std::string_view(state.batch.data(), read));
+				}
+				file.reset();
+			}
+			auto& text = state.pending[index];
+			if (index + 1 < state.pending.size()) text += delim;
+			text += '\n';
+			output.append(text);
+			std::string().swap(text);
+		}
+	}
+};
@@ -0,0 +1,207 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <algorithm>
+
+#include "GroupByTable.h"
+#include "Simd.h"
+
+/**
+ * Bytes that separate tokens : optionally the whitespace of std::isspace (space, \t, \n, \v, \f, \r)
+ * plus any extra delimiter bytes.
+ *
+ * classify() marks the delimiters of 16 bytes at once. With SSE2 whitespace costs a range and an
+ * equality compare and every extra delimiter one more equality compare, up to MaxVectorDelimiters;
+ * larger sets are classified through the byte table.
+ */
+class DelimiterSet {
+public:
+	static constexpr size_t MaxVectorDelimiters = 8;
+
+	explicit DelimiterSet(std::string_view delimiters = std::string_view(), bool whitespace = true) : m_whitespace(whitespace) {
+		if (whitespace) {
+			for (unsigned char ch : std::string_view(" \t\n\v\f\r")) m_table[ch] = true;
+		}
+		for (unsigned char ch : delimiters) {
+			if (m_table[ch]) continue;
+			m_table[ch] = true;
+			m_extra.push_back(ch);
+		}
+	}
+
+	bool contains(char ch) const noexcept {
+		return m_table[static_cast<unsigned char>(ch)];
+	}
+
+	// Bit i is set when data[i] is a delimiter
+	unsigned classify(const char* data) const noexcept {
+#ifdef FLOWBUILDER_SSE2
+		if (m_extra.size() <= MaxVectorDelimiters) {
+			__m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+			__m128i hits = _mm_setzero_si128();
+			if (m_whitespace) {
+				// \t ... \r are 9 ... 13 : one unsigned range test
+				__m128i shifted = _mm_sub_epi8(block, _mm_set1_epi8(9));
+				hits = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+				hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, _mm_set1_epi8(' ')));
+			}
+			for (unsigned char ch : m_extra) {
+				hits = _mm_or_si128(hits, _mm_cmpeq_epi8(block, _mm_set1_epi8(static_cast<char>(ch))));
+			}
+			return unsigned(_mm_movemask_epi8(hits));
+		}
+#endif
+		unsigned mask = 0;
+		for (unsigned index = 0; index < 16; index++) {
+			mask |= unsigned(contains(data[index])) << index;
+		}
+		return mask;
+	}
+
+private:
+	bool m_table[256] = {};
+	bool m_whitespace;
+	std::vector<unsigned char> m_extra;
+};
+
+/**
+ * Calls onToken with a view of every token of text, in order. Nothing is copied or allocated;
+ * the views point into text.
+ *
+ * Text is classified 16 bytes at a time; a block entirely inside a token or entirely made of
+ * delimiters is skipped with a single test, otherwise the token boundaries are found from the
+ * delimiter mask bit by bit.
+ */
+template <typename Callback>
+void forEachToken(std::string_view text, const DelimiterSet& delimiters, Callback&& onToken) {
+	const char* data = text.data();
+	const size_t size = text.size();
+	bool inToken = false;
+	size_t start = 0;
+	size_t position = 0;
+	for (; position + 16 <= size; position += 16) {
+		const unsigned mask = delimiters.classify(data + position);
+		if (mask == (inToken ? 0u : 0xFFFFu)) continue;
+		unsigned offset = 0;
+		while (offset < 16) {
+			// the next boundary is the next delimiter inside a token and the next other byte outside
+			unsigned pending = (inToken ? mask : ~mask & 0xFFFFu) >> offset;
+			if (pending == 0) break;
+			offset += countTrailingZeros(pending);
+			if (inToken) {
+				onToken(std::string_view(data + start, position + offset - start));
+			}
+			else {
+				start = position + offset;
+			}
+			inToken = !inToken;
+		}
+	}
+	for (; position < size; position++) {
+		bool delimiter = delimiters.contains(data[position]);
+		if (inToken && delimiter) {
+			onToken(std::string_view(data + start, position - start));
+			inToken = false;
+		}
+		else if (!inToken && !delimiter) {
+			start = position;
+			inToken = true;
+		}
+	}
+	if (inToken) {
+		onToken(std::string_view(data + start, size - start));
+	}
+}
+
+// Fills tokens with views into text, reusing the capacity of the vector
+inline void tokenize(std::string_view text, const DelimiterSet& delimiters, std::vector<std::string_view>& tokens) {
+	tokens.clear();
+	forEachToken(text, delimiters, [&tokens](std::string_view token) {
+		tokens.push_back(token);
+	});
+}
+
+enum class TokenOutput {
+	// the number of tokens
+	Count,
+	// one "token,count,frequency" row per distinct token, most frequent first
+	Frequencies,
+	// one token per line
+	Tokens
+};
+
+inline std::string tokenOutputToString(TokenOutput output) {
+	switch (output) {
+	case TokenOutput::Count:
+		return "Count";
+	case TokenOutput::Frequencies:
+		return "Frequencies";
+	case TokenOutput::Tokens:
+		return "Tokens";
+	default:
+		return "UnknownOutput";
+	}
+}
+
+/**
+ * Tokenizes text and writes the tokens, their number or their frequencies.
+ *
+ * Frequencies are counted in a GroupByTable keyed by views into the text, so a distinct token is
+ * stored once and a repeated one costs a hash probe. Tokens with the same count keep the order
+ * of their first appearance.
+ */
+class TokenCounter {
+public:
+	TokenCounter(std::string delimiters, TokenOutput output)
+		: m_delimiterText(std::move(delimiters)), m_delimiters(m_delimiterText), m_output(output) {}
+
+	const std::string& getDelimiters() const noexcept {
+		return m_delimiterText;
+	}
+	TokenOutput getOutput() const noexcept {
+		return m_output;
+	}
+
+	void count(std::string_view text, std::string& result) const {
+		if (m_output == TokenOutput::Count) {
+			size_t tokens = 0;
+			forEachToken(text, m_delimiters, [&tokens](std::string_view) { tokens++; });
+			Csv::appendNumber(result, double(tokens));
+			return;
+		}
+		if (m_output == TokenOutput::Tokens) {
+			forEachToken(text, m_delimiters, [&result](std::string_view token) {
+				result.append(token.data(), token.size());
+				result += '\n';
+			});
+			return;
+		}
+
+		GroupByTable table(0, 1024);
+		size_t tokens = 0;
+		forEachToken(text, m_delimiters, [&](std::string_view token) {
+			table.addRow(token);
+			tokens++;
+		});
+		std::vector<size_t> order(table.size());
+		for (size_t entry = 0; entry < order.size(); entry++) order[entry] = entry;
+		std::stable_sort(order.begin(), order.end(), [&table](size_t left, size_t right) {
+			return table.getRowCount(left) > table.getRowCount(right);
+		});
+		result += "token,count,frequency\n";
+		for (auto entry : order) {
+			Csv::appendField(result, table.getKey(entry));
+			result += ',';
+			Csv::appendNumber(result, double(table.getRowCount(entry)));
+			result += ',';
+			Csv::appendNumber(result, double(table.getRowCount(entry)) / double(tokens));
+			result += '\n';
+		}
+	}
+
+private:
+	std::string m_delimiterText;
+	DelimiterSet m_delimiters;
+	TokenOutput m_output;
+};
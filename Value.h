@@ -0,0 +1,215 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#include "Node.h"
+
+/**
+ * Tagged node value, typed by PrimitiveType.
+ *
+ * Numbers are kept in their own representation and only converted when a consumer asks for another
+ * type. The text form of a number is formatted on first use and cached until the value changes;
+ * its buffer keeps its capacity, so converting again does not allocate.
+ */
+class Value {
+public:
+	// "%f" of the largest double needs 317 characters, float and integers fit in 64
+	static constexpr size_t NumberTextCapacity = 64;
+
+	Value() noexcept : m_type(PrimitiveType::Unknown), m_integer(0) {}
+
+	PrimitiveType getType() const noexcept {
+		return m_type;
+	}
+	bool isSet() const noexcept {
+		return m_type != PrimitiveType::Unknown;
+	}
+	bool isNumeric() const noexcept {
+		return m_type == PrimitiveType::Integer || m_type == PrimitiveType::Float || m_type == PrimitiveType::Double;
+	}
+
+	void clear() noexcept {
+		m_type = PrimitiveType::Unknown;
+		m_integer = 0;
+		m_text.clear();
+		m_vector.clear();
+		m_textValid = true;
+	}
+	void setChar(char value) noexcept {
+		m_type = PrimitiveType::Char;
+		m_char = value;
+		m_textValid = false;
+	}
+	void setInteger(int64_t value) noexcept {
+		m_type = PrimitiveType::Integer;
+		m_integer = value;
+		m_textValid = false;
+	}
+	void setFloat(float value) noexcept {
+		m_type = PrimitiveType::Float;
+		m_float = value;
+		m_textValid = false;
+	}
+	void setDouble(double value) noexcept {
+		m_type = PrimitiveType::Double;
+		m_double = value;
+		m_textValid = false;
+	}
+	void setString(std::string_view value) {
+		m_text.assign(value.data(), value.size());
+		m_type = PrimitiveType::String;
+		m_textValid = true;
+	}
+	void setString(std::string&& value) noexcept {
+		m_text = std::move(value);
+		m_type = PrimitiveType::String;
+		m_textValid = true;
+	}
+	// Turns the value into a string and exposes its buffer, so results can be computed in place
+	std::string& editString() noexcept {
+		m_type = PrimitiveType::String;
+		m_textValid = true;
+		return m_text;
+	}
+	// Turns the value into a vector and exposes its buffer; the text form is formatted again on next use
+	NumberVector& editVector() noexcept {
+		m_type = PrimitiveType::Vector;
+		m_textValid = false;
+		return m_vector;
+	}
+	void reserveText(size_t capacity) {
+		m_text.reserve(capacity);
+	}
+
+	char asChar() const noexcept {
+		switch (m_type) {
+		case PrimitiveType::Char:
+			return m_char;
+		case PrimitiveType::String:
+			return m_text.empty() ? '\0' : m_text.front();
+		default:
+			return static_cast<char>(asInteger());
+		}
+	}
+	int64_t asInteger() const noexcept {
+		switch (m_type) {
+		case PrimitiveType::Char:
+			return m_char;
+		case PrimitiveType::Integer:
+			return m_integer;
+		case PrimitiveType::Float:
+			return static_cast<int64_t>(m_float);
+		case PrimitiveType::Double:
+			return static_cast<int64_t>(m_double);
+		case PrimitiveType::String:
+			return std::strtoll(m_text.c_str(), nullptr, 10);
+		default:
+			return 0;
+		}
+	}
+	float asFloat() const noexcept {
+		switch (m_type) {
+		case PrimitiveType::Float:
+			return m_float;
+		case PrimitiveType::String:
+			return std::strtof(m_text.c_str(), nullptr);
+		default:
+			return static_cast<float>(asDouble());
+		}
+	}
+	double asDouble() const noexcept {
+		switch (m_type) {
+		case PrimitiveType::Char:
+			return m_char;
+		case PrimitiveType::Integer:
+			return static_cast<double>(m_integer);
+		case PrimitiveType::Float:
+			return m_float;
+		case PrimitiveType::Double:
+			return m_double;
+		case PrimitiveType::String:
+			return std::strtod(m_text.c_str(), nullptr);
+		default:
+			return 0.0;
+		}
+	}
+	// Empty unless the value is a Vector
+	const NumberVector& asVector() const noexcept {
+		return m_vector;
+	}
+	// Same formatting as std::to_string, produced without a temporary string; vectors are numbers separated by spaces
+	const std::string& asText() const noexcept {
+		if (!m_textValid && m_type == PrimitiveType::Vector) {
+			m_text.clear();
+			appendNumbers(m_vector, m_text);
+			m_textValid = true;
+		}
+		if (!m_textValid) {
+			char buffer[NumberTextCapacity * 6];
+			int length = 0;
+			switch (m_type) {
+			case PrimitiveType::Char:
+				buffer[0] = m_char;
+				length = 1;
+				break;
+			case PrimitiveType::Integer:
+				length = std::snprintf(buffer, sizeof(buffer), "%lld", static_cast<long long>(m_integer));
+				break;
+			case PrimitiveType::Float:
+				length = std::snprintf(buffer, sizeof(buffer), "%f", m_float);
+				break;
+			case PrimitiveType::Double:
+				length = std::snprintf(buffer, sizeof(buffer), "%f", m_double);
+				break;
+			default:
+				break;
+			}
+			m_text.assign(buffer, length > 0 ? size_t(length) : 0);
+			m_textValid = true;
+		}
+		return m_text;
+	}
+
+private:
+	PrimitiveType m_type;
+	union {
+		char m_char;
+		int64_t m_integer;
+		float m_float;
+		double m_double;
+	};
+	// the value of a String, the cached conversion of anything else
+	mutable std::string m_text;
+	// the elements of a Vector, kept with their capacity when the value changes type
+	NumberVector m_vector;
+	mutable bool m_textValid = true;
+};
+
+// Contiguous values of one run, indexed like the FlowGraph of the flow
+class ValueTable {
+public:
+	ValueTable() = default;
+	explicit ValueTable(size_t size) : m_values(size) {}
+
+	Value& operator[](size_t index) noexcept {
+		return m_values[index];
+	}
+	const Value& operator[](size_t index) const noexcept {
+		return m_values[index];
+	}
+	size_t size() const noexcept {
+		return m_values.size();
+	}
+	void clear() noexcept {
+		for (auto& value : m_values) {
+			value.clear();
+		}
+	}
+
+private:
+	std::vector<Value> m_values;
+};
@@ -0,0 +1,247 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <string_view>
+#include <new>
+#include <cmath>
+#include <algorithm>
+
+#include "Csv.h"
+#include "Simd.h"
+#include "Tokenizer.h"
+
+// Allocator for buffers that SIMD kernels read a cache line at a time
+template <typename T, size_t Alignment = 64>
+struct AlignedAllocator {
+	typedef T value_type;
+	template <typename U>
+	struct rebind {
+		typedef AlignedAllocator<U, Alignment> other;
+	};
+
+	AlignedAllocator() noexcept = default;
+	template <typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+	T* allocate(size_t count) {
+		return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t(Alignment)));
+	}
+	void deallocate(T* pointer, size_t) noexcept {
+		::operator delete(pointer, std::align_val_t(Alignment));
+	}
+
+	template <typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const noexcept {
+		return true;
+	}
+	template <typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const noexcept {
+		return false;
+	}
+};
+
+typedef std::vector<float, AlignedAllocator<float>> NumberVector;
+
+enum class VectorReduction {
+	Sum,
+	Min,
+	Max,
+	Mean,
+	Dot
+};
+
+inline std::string vectorReductionToString(VectorReduction reduction) {
+	switch (reduction) {
+	case VectorReduction::Sum:
+		return "Sum";
+	case VectorReduction::Min:
+		return "Min";
+	case VectorReduction::Max:
+		return "Max";
+	case VectorReduction::Mean:
+		return "Mean";
+	case VectorReduction::Dot:
+		return "Dot";
+	default:
+		return "UnknownReduction";
+	}
+}
+
+/**
+ * Loads the numbers of a text into values, reusing its capacity : the numeric fields of one
+ * column of CSV input (header line first), or every number of the text when the column is empty,
+ * numbers being separated by whitespace, commas or semicolons. Other fields are skipped.
+ * @throws InvalidInput if the column is not in the header.
+ */
+inline void parseNumbers(std::string_view text, const std::string& column, NumberVector& values) {
+	values.clear();
+	double number;
+	if (column.empty()) {
+		static const DelimiterSet separators(",;");
+		forEachToken(text, separators, [&](std::string_view token) {
+			if (Csv::parseNumber(token, number)) values.push_back(float(number));
+		});
+		return;
+	}
+	std::string_view body;
+	std::vector<std::string_view> fields;
+	Csv::splitFields(Csv::splitHeader(text, body), fields);
+	size_t index = Csv::findColumn(fields, column);
+	Csv::forEachLine(body, [&](std::string_view line) {
+		Csv::splitFields(line, fields);
+		if (Csv::parseNumber(Csv::fieldAt(fields, index), number)) values.push_back(float(number));
+	});
+}
+
+// Numbers separated by spaces, in their shortest exact form
+inline void appendNumbers(const NumberVector& values, std::string& result) {
+	for (size_t index = 0; index < values.size(); index++) {
+		if (index != 0) result += ' ';
+		Csv::appendNumber(result, values[index]);
+	}
+}
+
+// Element wise operations of the kernels, one lane and four lanes at a time
+struct AddKernel {
+	static float scalar(float lhs, float rhs) noexcept { return lhs + rhs; }
+#ifdef FLOWBUILDER_SSE2
+	static __m128 lanes(__m128 lhs, __m128 rhs) noexcept { return _mm_add_ps(lhs, rhs); }
+#endif
+};
+struct SubtractKernel {
+	static float scalar(float lhs, float rhs) noexcept { return lhs - rhs; }
+#ifdef FLOWBUILDER_SSE2
+	static __m128 lanes(__m128 lhs, __m128 rhs) noexcept { return _mm_sub_ps(lhs, rhs); }
+#endif
+};
+struct MultiplyKernel {
+	static float scalar(float lhs, float rhs) noexcept { return lhs * rhs; }
+#ifdef FLOWBUILDER_SSE2
+	static __m128 lanes(__m128 lhs, __m128 rhs) noexcept { return _mm_mul_ps(lhs, rhs); }
+#endif
+};
+struct DivideKernel {
+	static float scalar(float lhs, float rhs) noexcept { return lhs / rhs; }
+#ifdef FLOWBUILDER_SSE2
+	static __m128 lanes(__m128 lhs, __m128 rhs) noexcept { return _mm_div_ps(lhs, rhs); }
+#endif
+};
+struct MinKernel {
+	static float scalar(float lhs, float rhs) noexcept { return lhs < rhs ? lhs : rhs; }
+#ifdef FLOWBUILDER_SSE2
+	static __m128 lanes(__m128 lhs, __m128 rhs) noexcept { return _mm_min_ps(lhs, rhs); }
+#endif
+};
+struct MaxKernel {
+	static float scalar(float lhs, float rhs) noexcept { return lhs > rhs ? lhs : rhs; }
+#ifdef FLOWBUILDER_SSE2
+	static __m128 lanes(__m128 lhs, __m128 rhs) noexcept { return _mm_max_ps(lhs, rhs); }
+#endif
+};
+
+/**
+ * Element wise and reduction kernels over float arrays, 4 lanes at a time with SSE and scalar
+ * for the tail or when SSE2 is not available.
+ *
+ * Element wise kernels update the destination in place. Sums and dot products accumulate in
+ * double lanes, so long vectors do not lose the precision a float accumulator would.
+ */
+struct VectorKernels {
+
+	template <typename Kernel>
+	static void apply(float* destination, const float* source, size_t count) noexcept {
+		size_t index = 0;
+#ifdef FLOWBUILDER_SSE2
+		for (; index + 4 <= count; index += 4) {
+			_mm_storeu_ps(destination + index, Kernel::lanes(_mm_loadu_ps(destination + index), _mm_loadu_ps(source + index)));
+		}
+#endif
+		for (; index < count; index++) {
+			destination[index] = Kernel::scalar(destination[index], source[index]);
+		}
+	}
+
+	// Same as apply with every element of the source equal to value
+	template <typename Kernel>
+	static void applyScalar(float* destination, float value, size_t count) noexcept {
+		size_t index = 0;
+#ifdef FLOWBUILDER_SSE2
+		const __m128 broadcast = _mm_set1_ps(value);
+		for (; index + 4 <= count; index += 4) {
+			_mm_storeu_ps(destination + index, Kernel::lanes(_mm_loadu_ps(destination + index), broadcast));
+		}
+#endif
+		for (; index < count; index++) {
+			destination[index] = Kernel::scalar(destination[index], value);
+		}
+	}
+
+	static double sum(const float* values, size_t count) noexcept {
+		size_t index = 0;
+		double total = 0.0;
+#ifdef FLOWBUILDER_SSE2
+		__m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+		for (; index + 4 <= count; index += 4) {
+			__m128 block = _mm_loadu_ps(values + index);
+			low = _mm_add_pd(low, _mm_cvtps_pd(block));
+			high = _mm_add_pd(high, _mm_cvtps_pd(_mm_movehl_ps(block, block)));
+		}
+		total = horizontalSum(_mm_add_pd(low, high));
+#endif
+		for (; index < count; index++) {
+			total += values[index];
+		}
+		return total;
+	}
+
+	static double dot(const float* left, const float* right, size_t count) noexcept {
+		size_t index = 0;
+		double total = 0.0;
+#ifdef FLOWBUILDER_SSE2
+		__m128d low = _mm_setzero_pd(), high = _mm_setzero_pd();
+		for (; index + 4 <= count; index += 4) {
+			__m128 a = _mm_loadu_ps(left + index);
+			__m128 b = _mm_loadu_ps(right + index);
+			low = _mm_add_pd(low, _mm_mul_pd(_mm_cvtps_pd(a), _mm_cvtps_pd(b)));
+			high = _mm_add_pd(high, _mm_mul_pd(_mm_cvtps_pd(_mm_movehl_ps(a, a)), _mm_cvtps_pd(_mm_movehl_ps(b, b))));
+		}
+		total = horizontalSum(_mm_add_pd(low, high));
+#endif
+		for (; index < count; index++) {
+			total += double(left[index]) * double(right[index]);
+		}
+		return total;
+	}
+
+	// Smallest (or largest) element, count must not be 0
+	static float extreme(const float* values, size_t count, bool largest) noexcept {
+		size_t index = 0;
+		float result = values[0];
+#ifdef FLOWBUILDER_SSE2
+		if (count >= 4) {
+			__m128 lanes = _mm_loadu_ps(values);
+			for (index = 4; index + 4 <= count; index += 4) {
+				__m128 block = _mm_loadu_ps(values + index);
+				lanes = largest ? _mm_max_ps(lanes, block) : _mm_min_ps(lanes, block);
+			}
+			alignas(16) float spread[4];
+			_mm_store_ps(spread, lanes);
+			result = spread[0];
+			for (int lane = 1; lane < 4; lane++) {
+				result = largest ? std::max(result, spread[lane]) : std::min(result, spread[lane]);
+			}
+		}
+#endif
+		for (; index < count; index++) {
+			result = largest ? std::max(result, values[index]) : std::min(result, values[index]);
+		}
+		return result;
+	}
+
+private:
+#ifdef FLOWBUILDER_SSE2
+	static double horizontalSum(__m128d lanes) noexcept {
+		return _mm_cvtsd_f64(_mm_add_sd(lanes, _mm_unpackhi_pd(lanes, lanes)));
+	}
+#endif
+};
@@ -7,6 +7,19 @@
 #include <algorithm>
 #include <stdexcept>
 #include <filesystem>
+#include <cstring>
+#include <string_view>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+#include "AsyncIO.h"
 
 class FileSystem;
 
@@ -69,6 +82,12 @@ public:
             return  ".flw";
         }
     }
+    static FileExtension parseExtension(const char* extension) {
+        if (strcmp(extension, ".csv") == 0) return CSV;
+        else if (strcmp(extension, ".txt") == 0) return TXT;
+        else if (strcmp(extension, ".flw") == 0) return FLOW;
+        throw InvalidHandle("The extension was not recognized");
+    }
 };
 
 class InMemoryFile : public FileHandle {
@@ -88,6 +107,7 @@ class InMemoryFile : public FileHandle {
         m_buffer.clear();
     }
     void clearFileContent() override {
+        m_buffer.str(std::string());
         m_buffer.clear();
     }
 
@@ -103,10 +123,261 @@ public:
     }
 };
 
+/**
+ * Scratch file for data that does not fit in memory, removed when the object is destroyed.
+ * It is written sequentially, rewound and then read back sequentially.
+ */
+class TemporaryFile {
+public:
+    explicit TemporaryFile(std::filesystem::path path)
+        : m_path(std::move(path)), m_stream(m_path, std::ios::in | std::ios::out | std::ios::trunc | std::ios::binary) {
+        if (!m_stream.is_open()) {
+            throw InvalidHandle("Failed to create a temporary file");
+        }
+    }
+    TemporaryFile(const TemporaryFile&) = delete;
+    TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+    ~TemporaryFile() {
+        m_stream.close();
+        std::error_code error;
+        std::filesystem::remove(m_path, error);
+    }
+
+    void write(std::string_view data) {
+        m_stream.write(data.data(), static_cast<std::streamsize>(data.size()));
+        if (!m_stream) {
+            throw InvalidHandle("Failed to write to a temporary file");
+        }
+    }
+
+    // Moves back to the start of the file to read what was written
+    void rewind() {
+        m_stream.flush();
+        m_stream.clear();
+        m_stream.seekg(0);
+    }
+
+    // Reads up to size bytes, returns how many were read; 0 at the end of the file
+    size_t read(char* destination, size_t size) {
+        m_stream.read(destination, static_cast<std::streamsize>(size));
+        return static_cast<size_t>(m_stream.gcount());
+    }
+
+    const std::filesystem::path& getPath() const noexcept {
+        return m_path;
+    }
+
+private:
+    std::filesystem::path m_path;
+    std::fstream m_stream;
+};
+
+/**
+ * Follows a file that is only appended to, like tail -F : every poll returns the complete lines
+ * written since the previous one, reading only those bytes. A line is returned once its line break
+ * was written.
+ *
+ * A file truncated below the consumed offset is read again from its start. A file replaced by a new
+ * one under the same path (a rotation) is read to its end first, then the new file is followed from
+ * its start. Rotations are recognized by the file identity where the system exposes it, and by the
+ * size otherwise.
+ */
+class FileFollower {
+public:
+    enum class Event {
+        None,
+        Appended,
+        Truncated,
+        Rotated
+    };
+
+    // Bytes a single poll reads at most, the rest waiting for the next polls; the end of a rotated file is read whole
+    static constexpr size_t DefaultMaxBatch = size_t(16) << 20;
+
+    /**
+     * @param fromEnd Whether to skip the lines already in the file when following starts.
+     * @param hasHeader Whether the first line of the file is a header, kept apart from the lines.
+     */
+    explicit FileFollower(std::filesystem::path path, bool fromEnd = false, bool hasHeader = false, size_t maxBatch = DefaultMaxBatch)
+        : m_path(std::move(path)), m_fromEnd(fromEnd), m_hasHeader(hasHeader), m_maxBatch(std::max<size_t>(1, maxBatch)) {}
+
+    /**
+     * Replaces lines with the complete lines appended since the previous poll. A file that does
+     * not exist yet gives no lines until it is created.
+     * @return Truncated or Rotated when the file started over during this poll, the lines then
+     *         coming from the new content; Appended when there are lines, None otherwise.
+     */
+    Event poll(std::string& lines) {
+        lines.clear();
+        Event event = Event::None;
+        std::error_code error;
+        if (!m_file.is_open()) {
+            if (!open()) return Event::None;
+        }
+        else if (!std::filesystem::exists(m_path, error)) {
+            // moved away and not recreated yet, the open stream still reads the old file
+            readLines(lines, false);
+            return lines.empty() ? Event::None : Event::Appended;
+        }
+        else if (isReplaced()) {
+            // what the old file still held was written before the rotation, all of it comes first
+            readLines(lines, true);
+            open();
+            event = Event::Rotated;
+        }
+        else if (getSize() < m_offset) {
+            open();
+            event = Event::Truncated;
+        }
+        if (m_hasHeader && m_header.empty() && !readHeader()) {
+            return event;
+        }
+        readLines(lines, false);
+        if (event == Event::None && !lines.empty()) {
+            event = Event::Appended;
+        }
+        return event;
+    }
+
+    // Header line of the followed file, with its line break; empty before it was written
+    const std::string& getHeader() const noexcept {
+        return m_header;
+    }
+    // Offset in the current file up to which the lines were returned
+    uint64_t getOffset() const noexcept {
+        return m_offset;
+    }
+
+private:
+    std::filesystem::path m_path;
+    std::ifstream m_file;
+    bool m_fromEnd;
+    bool m_hasHeader;
+    size_t m_maxBatch;
+    uint64_t m_offset = 0;
+    std::string m_header;
+#ifdef __linux__
+    dev_t m_device = 0;
+    ino_t m_inode = 0;
+#endif
+
+    uint64_t getSize() const {
+        std::error_code error;
+        auto size = std::filesystem::file_size(m_path, error);
+        return error ? 0 : uint64_t(size);
+    }
+
+    // A new file took the path while the old one stays readable through the open stream
+    bool isReplaced() const {
+#ifdef __linux__
+        struct stat status;
+        return ::stat(m_path.c_str(), &status) == 0 && (status.st_ino != m_inode || status.st_dev != m_device);
+#else
+        return false;
+#endif
+    }
+
+    bool open() {
+        m_file.close();
+        m_file.clear();
+        m_file.open(m_path, std::ios::binary);
+        if (!m_file.is_open()) {
+            return false;
+        }
+#ifdef __linux__
+        struct stat status;
+        if (::stat(m_path.c_str(), &status) == 0) {
+            m_device = status.st_dev;
+            m_inode = status.st_ino;
+        }
+#endif
+        m_header.clear();
+        m_offset = 0;
+        if (m_fromEnd) {
+            // only the first file skips what it held, the ones after a rotation are read whole
+            m_fromEnd = false;
+            if (m_hasHeader) {
+                readHeader();
+            }
+            m_offset = std::max(m_offset, lastLineEnd(getSize()));
+        }
+        return true;
+    }
+
+    bool readHeader() {
+        std::string line;
+        m_file.clear();
+        m_file.seekg(0);
+        if (!std::getline(m_file, line) || m_file.eof()) {
+            return false;
+        }
+        m_header = line + "\n";
+        m_offset = std::max<uint64_t>(m_offset, m_header.size());
+        return true;
+    }
+
+    // Offset just after the last line break before end
+    uint64_t lastLineEnd(uint64_t end) {
+        std::string block;
+        while (end > m_offset) {
+            const uint64_t begin = end - std::min<uint64_t>(end - m_offset, 1 << 16);
+            block.resize(size_t(end - begin));
+            m_file.clear();
+            m_file.seekg(std::streamoff(begin));
+            m_file.read(&block[0], std::streamsize(block.size()));
+            const size_t lastBreak = block.rfind('\n');
+            if (lastBreak != std::string::npos) {
+                return begin + lastBreak + 1;
+            }
+            end = begin;
+        }
+        return m_offset;
+    }
+
+    /**
+     * Appends the complete lines after m_offset, up to the batch size unless a single line is
+     * longer; with final set, every line up to the end of the file, the last one counting as
+     * complete even without a break.
+     */
+    void readLines(std::string& lines, bool final) {
+        const size_t start = lines.size();
+        m_file.clear();
+        m_file.seekg(std::streamoff(m_offset));
+        size_t lastBreak = std::string::npos;
+        while (true) {
+            const size_t filled = lines.size();
+            lines.resize(filled + std::min<size_t>(m_maxBatch, 1 << 20));
+            m_file.read(&lines[filled], std::streamsize(lines.size() - filled));
+            lines.resize(filled + size_t(m_file.gcount()));
+            const size_t found = std::string_view(lines).substr(filled).rfind('\n');
+            if (found != std::string_view::npos) {
+                lastBreak = filled + found;
+            }
+            if (lines.size() == filled || (!final && lastBreak != std::string::npos && lines.size() - start >= m_maxBatch)) {
+                break;
+            }
+        }
+        if (final && lines.size() > start && lines.back() != '\n') {
+            lines += '\n';
+            lastBreak = lines.size() - 1;
+        }
+        if (lastBreak == std::string::npos) {
+            lines.resize(start);
+            return;
+        }
+        lines.resize(lastBreak + 1);
+        m_offset += lines.size() - start;
+    }
+};
+
 class FileSystem {
 
-    static FileSystem* m_instance;
     std::vector<std::shared_ptr<FileHandle>> m_resources;
+    std::mutex m_resourcesMutex;
+    // created by the first batch of reads and kept, so its io_uring ring is set up once
+    std::unique_ptr<AsyncIO> m_inputReader;
+    std::mutex m_inputReaderMutex;
     std::string m_directory = std::string("C:\\tmp");
 
     std::shared_ptr<FileHandle> createNewFileHandle(const char* fileName, FileExtension extension) {
@@ -132,10 +403,12 @@ class FileSystem {
     }
 public:
 
+    // Safe to call from several threads, like fileAlreadyExistent
     std::shared_ptr<FileHandle> getFileHandle(const char* fileName, FileExtension extension) {
+        std::lock_guard<std::mutex> lock(m_resourcesMutex);
         try {
             auto where = std::find_if(m_resources.begin(), m_resources.end(), [fileName, extension](const auto& handle) {
-                return handle->getFileName() == fileName && handle->getExtensionType() == extension;
+                return std::strcmp(handle->getFileName(), fileName) == 0 && handle->getExtensionType() == extension;
                 });
 
             if (where == m_resources.end()) {
@@ -184,6 +457,20 @@ public:
     }
 
 
+    // Stream over the file saveFile writes, for content produced piece by piece; null if it cannot be opened
+    std::unique_ptr<std::ofstream> openOutputFile(const FileHandle* handle, bool append = false) {
+        if (handle == nullptr) {
+            std::cerr << "File Handle is null";
+            return nullptr;
+        }
+        auto file = std::make_unique<std::ofstream>(getOutputFilePath(handle), append ? std::ios::binary | std::ios::app : std::ios::binary);
+        if (!file->is_open()) {
+            std::cerr << "Failed to open file stream for file " << m_directory << "\\" << handle->getRelativePath();
+            return nullptr;
+        }
+        return file;
+    }
+
     bool writeToFile(FileHandle* handle, const std::string& buffer) {
 
         if (handle == nullptr) {
@@ -206,12 +493,9 @@ public:
     }
 
     static FileSystem* getInstance() {
-
-        if (m_instance == nullptr) {
-            m_instance = new FileSystem();
-        }
-
-        return m_instance;
+        // created once, even when the first calls come from several threads
+        static FileSystem* instance = new FileSystem();
+        return instance;
     }
 
     bool fileAlreadyExistent(const char* fileName, FileExtension extension) {
@@ -219,6 +503,7 @@ public:
             std::cerr << "FileName provided is null\n";
         }
 
+        std::lock_guard<std::mutex> lock(m_resourcesMutex);
         auto handle = std::find_if(m_resources.begin(), m_resources.end(), [fileName, extension](const std::shared_ptr<FileHandle>& handle) {
             return handle->getFileName() == std::string(fileName) && handle->getExtensionType() == extension;
             });
@@ -240,11 +525,10 @@ public:
             return std::string();
         }
 
-        // Construct the full path to the file
-        std::string path = m_directory + "\\" + sanitizeFileName(handle->getFileName()) +
-            (handle->getExtensionType() == TXT ? std::string(".txt") : std::string(".csv"));
+        std::string path = getInputFilePath(handle);
 
-        std::ifstream file(path);
+        // binary like the other reads, the line breaks being normalized the same way for all of them
+        std::ifstream file(path, std::ios::binary);
 
         if (!file.is_open()) {
             std::cerr << "Failed to open file: " << path << std::endl;
@@ -257,8 +541,184 @@ public:
         // Close the file stream
         file.close();
 
+        normalizeLineEnds(content);
         return content;
     }
-};
 
-inline FileSystem* FileSystem::m_instance = nullptr;
\ No newline at end of file
+    // Line breaks as a text mode read gives them on Windows : every \r\n becomes \n
+    static void normalizeLineEnds(std::string& content) {
+        size_t write = content.find("\r\n");
+        if (write == std::string::npos) {
+            return;
+        }
+        for (size_t read = write; read < content.size(); read++) {
+            if (content[read] == '\r' && read + 1 < content.size() && content[read + 1] == '\n') {
+                continue;
+            }
+            content[write++] = content[read];
+        }
+        content.resize(write);
+    }
+
+    /**
+     * Reads several input files in one batch of asynchronous reads, so they overlap instead of
+     * waiting on each other. A file that cannot be read gives an empty string, and line breaks are
+     * normalized, like readFromInputFile.
+     * Batches from several threads take turns on the reader of the FileSystem.
+     */
+    std::vector<std::string> readInputFiles(const std::vector<FileHandle*>& handles) {
+        std::vector<std::string> contents(handles.size());
+        if (handles.size() <= 1) {
+            if (!handles.empty()) contents[0] = readFromInputFile(handles[0]);
+            return contents;
+        }
+        std::lock_guard<std::mutex> lock(m_inputReaderMutex);
+        if (m_inputReader == nullptr) {
+            m_inputReader = AsyncIO::create();
+        }
+        auto& io = m_inputReader;
+        for (size_t index = 0; index < handles.size(); index++) {
+            if (handles[index] == nullptr) {
+                std::cerr << "Handle provided is null\n";
+                continue;
+            }
+            std::string path = getInputFilePath(handles[index]);
+            io->readFile(path, contents[index], [path, &contents, index](bool succeeded) {
+                if (!succeeded) {
+                    std::cerr << "Failed to read file: " << path << std::endl;
+                    contents[index].clear();
+                }
+            });
+        }
+        io->submit();
+        io->wait();
+        for (auto& content : contents) {
+            normalizeLineEnds(content);
+        }
+        return contents;
+    }
+
+    // Path saveFile and openOutputFile write the handle to
+    std::string getOutputFilePath(const FileHandle* handle) const {
+        return m_directory + "\\" + handle->getRelativePath();
+    }
+
+    /**
+     * Reads an input file block by block into content, giving up as soon as cancelled is set. Line
+     * breaks are normalized like readFromInputFile.
+     * @return false if the file could not be read or the read was cancelled.
+     */
+    bool readInputFile(const FileHandle* handle, std::string& content, const std::atomic<bool>& cancelled, size_t blockSize = 1 << 20) {
+        if (handle == nullptr) {
+            return false;
+        }
+        std::ifstream file(getInputFilePath(handle), std::ios::binary);
+        if (!file.is_open()) {
+            return false;
+        }
+        content.clear();
+        file.seekg(0, std::ios::end);
+        content.reserve(static_cast<size_t>(std::max<std::streamoff>(0, file.tellg())));
+        file.seekg(0);
+        while (!cancelled.load(std::memory_order_relaxed)) {
+            const size_t filled = content.size();
+            content.resize(filled + blockSize);
+            file.read(&content[filled], static_cast<std::streamsize>(blockSize));
+            content.resize(filled + static_cast<size_t>(file.gcount()));
+            if (!file) {
+                if (file.bad()) {
+                    return false;
+                }
+                normalizeLineEnds(content);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Asks the system to bring an input file into its cache ahead of a read, without holding it in memory
+    void adviseWillNeed(const FileHandle* handle) {
+#ifdef __linux__
+        if (handle == nullptr) {
+            return;
+        }
+        int fd = ::open(getInputFilePath(handle).c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd >= 0) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_WILLNEED);
+            ::close(fd);
+        }
+#endif
+    }
+
+    // Size in bytes of an input file, -1 when it cannot be opened
+    long long getInputFileSize(const FileHandle* handle) {
+        if (handle == nullptr) {
+            return -1;
+        }
+        std::ifstream file(getInputFilePath(handle), std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            return -1;
+        }
+        return static_cast<long long>(file.tellg());
+    }
+
+    /**
+     * Reads an input file block by block and hands every run of complete lines to onLines, so
+     * large inputs can be processed without holding the whole file in memory. The last line is
+     * passed even when the file does not end with a line break.
+     *
+     * @param buffer Scratch space for the blocks, its capacity is reused between scans.
+     * @return false if the file could not be opened.
+     */
+    template <typename Callback>
+    bool scanInputFile(FileHandle* handle, std::string& buffer, size_t blockSize, Callback&& onLines) {
+        if (handle == nullptr) {
+            std::cerr << "Handle provided is null\n";
+            return false;
+        }
+        std::ifstream file(getInputFilePath(handle), std::ios::binary);
+        if (!file.is_open()) {
+            std::cerr << "Failed to open file: " << getInputFilePath(handle) << std::endl;
+            return false;
+        }
+
+        size_t carried = 0;
+        while (true) {
+            // a line longer than the block grows the buffer instead of being cut
+            if (buffer.size() < carried + blockSize) {
+                buffer.resize(carried + blockSize);
+            }
+            file.read(&buffer[carried], static_cast<std::streamsize>(blockSize));
+            size_t filled = carried + static_cast<size_t>(file.gcount());
+            if (filled == carried) {
+                break;
+            }
+            size_t lastBreak = std::string_view(buffer.data(), filled).rfind('\n');
+            if (lastBreak == std::string_view::npos) {
+                carried = filled;
+                continue;
+            }
+            onLines(std::string_view(buffer.data(), lastBreak + 1));
+            carried = filled - lastBreak - 1;
+            std::memmove(&buffer[0], buffer.data() + lastBreak + 1, carried);
+        }
+        if (carried != 0) {
+            onLines(std::string_view(buffer.data(), carried));
+        }
+        return true;
+    }
+
+    // Creates an empty scratch file in the temporary directory of the system
+    std::unique_ptr<TemporaryFile> createTemporaryFile(const char* prefix) {
+        static std::atomic<unsigned long long> counter{ 0 };
+        std::stringstream name;
+        name << prefix << "_" << std::chrono::steady_clock::now().time_since_epoch().count() << "_" << counter++ << ".tmp";
+        return std::make_unique<TemporaryFile>(std::filesystem::temp_directory_path() / std::filesystem::path(name.str()));
+    }
+
+    // Path readFromInputFile reads the handle from
+    std::string getInputFilePath(const FileHandle* handle) {
+        return m_directory + "\\" + sanitizeFileName(handle->getFileName()) +
+            (handle->getExtensionType() == TXT ? std::string(".txt") : std::string(".csv"));
+    }
+};